@@ -0,0 +1,212 @@
+#include "Lanes.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void *lane_alloc(int n, int size) {
+	// aligned_alloc wants a multiple of the alignment
+	int bytes = ( ( n * size + 63 ) / 64 ) * 64;
+	if ( bytes == 0 ) bytes = 64;
+	void *p = aligned_alloc(64, bytes);
+	memset(p, 0, bytes);
+	return p;
+}
+
+void lane_free(void *p) {
+	free(p);
+}
+
+double lanes_clock() {
+	std::chrono::duration<double> d = std::chrono::steady_clock::now().time_since_epoch();
+	return d.count();
+}
+
+/*
+	LanePlatform
+	Works out the arguments of every lane from the lane options.
+*/
+LanePlatform::LanePlatform(int argc, char **argv) {
+	int copies = 1;
+	int sweep_from = 0;
+	int sweep_to = -1;
+	bool sweep = false;
+	std::string inputs_file("");
+	quiet = false;
+	lane_steps = 0;
+
+	int a = 1;
+	for ( ; a < argc; a++) {
+		std::string arg(argv[a]);
+		if ( arg == "--copies" && a + 1 < argc ) {
+			copies = atoi(argv[++a]);
+		} else if ( arg == "--inputs" && a + 1 < argc ) {
+			inputs_file = argv[++a];
+		} else if ( arg == "--sweep" && a + 2 < argc ) {
+			sweep = true;
+			sweep_from = atoi(argv[++a]);
+			sweep_to = atoi(argv[++a]);
+		} else if ( arg == "--quiet" ) {
+			quiet = true;
+		} else {
+			break;
+		}
+	}
+
+	if ( ! inputs_file.empty() ) {
+		std::ifstream in(inputs_file.c_str());
+		std::string line;
+		while ( std::getline(in, line) ) {
+			std::istringstream words(line);
+			std::vector<std::string> lane;
+			lane.push_back(argv[0]);
+
+			std::string word;
+			while ( words >> word ) lane.push_back(word);
+
+			if ( lane.size() > 1 ) args.push_back(lane);
+		}
+	} else if ( sweep ) {
+		for (int k = sweep_from; k <= sweep_to; k++) {
+			std::vector<std::string> lane;
+			lane.push_back(argv[0]);
+			std::ostringstream number;
+			number << k;
+			lane.push_back(number.str());
+			args.push_back(lane);
+		}
+	} else {
+		std::vector<std::string> lane;
+		lane.push_back(argv[0]);
+		for (int k = a; k < argc; k++) lane.push_back(argv[k]);
+		for (int k = 0; k < copies; k++) args.push_back(lane);
+	}
+
+	lanes = args.size();
+	out = std::vector<std::string>(lanes);
+	halted = lane_array<unsigned char>(lanes);
+}
+LanePlatform::~LanePlatform() {
+	lane_free(halted);
+}
+
+int LanePlatform::get_lanes() {return this->lanes;}
+long LanePlatform::get_lane_steps() {return this->lane_steps;}
+
+void LanePlatform::write(std::ostream &o) {
+	if ( quiet ) return;
+	for (int l = 0; l < lanes; l++) o << out[l];
+	o.flush();
+}
+
+void report_lanes(LanePlatform *platform, long steps, double seconds) {
+	platform->write(std::cout);
+	std::cerr << "lanes: " << platform->get_lanes()
+	          << "  steps: " << steps
+	          << "  lane steps: " << platform->get_lane_steps()
+	          << "  seconds: " << seconds
+	          << "  lane steps/sec: " << ( seconds > 0 ? platform->get_lane_steps() / seconds : 0 ) << std::endl;
+}
+
+/*
+	IntegerComputerLanes
+*/
+IntegerComputerLanes::IntegerComputerLanes(int argc, char **argv) : LanePlatform(argc, argv) {
+	input = lane_array<int>(lanes);
+	output = lane_array<int>(lanes);
+	for (int l = 0; l < lanes; l++) {
+		if ( args[l].size() > 1 ) sscanf( args[l][1].c_str(), "%d", &input[l] );
+	}
+}
+IntegerComputerLanes::~IntegerComputerLanes() {
+	lane_free(input);
+	lane_free(output);
+}
+
+void IntegerComputerLanes::enter_state(const int *state, int exit) {}
+
+void IntegerComputerLanes::next_state(const unsigned char *fired) {
+	char buffer[16];
+	for (int l = 0; l < lanes; l++) {
+		if ( ! fired[l] ) continue;
+		lane_steps++;
+		if ( quiet ) continue;
+		int n = snprintf(buffer, sizeof(buffer), "%d\n", output[l]);
+		out[l].append(buffer, n);
+	}
+}
+
+/*
+	IntegerStreamComputerLanes
+	The inputs of every lane are read up front. A lane halts after printing the output
+	for its last input, like IntegerStreamComputer::next_state.
+*/
+IntegerStreamComputerLanes::IntegerStreamComputerLanes(int argc, char **argv) : LanePlatform(argc, argv) {
+	input = lane_array<int>(lanes);
+	output = lane_array<int>(lanes);
+	values = std::vector< std::vector<int> >(lanes);
+	index = std::vector<int>(lanes, 0);
+
+	for (int l = 0; l < lanes; l++) {
+		int value = 0;
+		for (std::vector<std::string>::size_type k = 1; k < args[l].size(); k++) {
+			// like sscanf into the same int, a bad number keeps the previous value
+			sscanf( args[l][k].c_str(), "%d", &value );
+			values[l].push_back(value);
+		}
+		if ( values[l].empty() ) halted[l] = 1;
+	}
+}
+IntegerStreamComputerLanes::~IntegerStreamComputerLanes() {
+	lane_free(input);
+	lane_free(output);
+}
+
+void IntegerStreamComputerLanes::enter_state(const int *state, int exit) {
+	for (int l = 0; l < lanes; l++) {
+		if ( state[l] != exit ) input[l] = values[l][index[l]];
+	}
+}
+
+void IntegerStreamComputerLanes::next_state(const unsigned char *fired) {
+	char buffer[16];
+	for (int l = 0; l < lanes; l++) {
+		if ( ! fired[l] ) continue;
+		lane_steps++;
+		if ( ! quiet ) {
+			int n = snprintf(buffer, sizeof(buffer), "%d\n", output[l]);
+			out[l].append(buffer, n);
+		}
+		index[l]++;
+		if ( index[l] == (int) values[l].size() ) halted[l] = 1;
+	}
+}
+
+/*
+	PositionalRobotLanes
+	"%g" is what std::cout prints a float with by default.
+*/
+PositionalRobotLanes::PositionalRobotLanes(int argc, char **argv) : LanePlatform(argc, argv) {
+	xPos = lane_array<float>(lanes);
+	yPos = lane_array<float>(lanes);
+}
+PositionalRobotLanes::~PositionalRobotLanes() {
+	lane_free(xPos);
+	lane_free(yPos);
+}
+
+void PositionalRobotLanes::enter_state(const int *state, int exit) {}
+
+void PositionalRobotLanes::next_state(const unsigned char *fired) {
+	char buffer[64];
+	for (int l = 0; l < lanes; l++) {
+		if ( ! fired[l] ) continue;
+		lane_steps++;
+		if ( quiet ) continue;
+		int n = snprintf(buffer, sizeof(buffer), "  XPos: %g  YPos: %g\n", xPos[l], yPos[l]);
+		out[l].append(buffer, n);
+	}
+}
@@ -0,0 +1,132 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+/*
+	Lanes are the struct-of-arrays versions of the numeric platforms in Platform.h.
+	Machines generated with `cffc --lockstep` run N instances ("lanes") of the
+	same Machine side by side: every platform field and Machine variable is an
+	array with one element per lane, and each step evaluates the guards of a
+	State for all lanes at once as masks.
+
+	CFFC_LANES_TARGETS asks GCC to build the generated step() for AVX-512, AVX2
+	and the plain x86-64 baseline and pick one at load time. Elsewhere the step
+	is compiled once for whatever the compiler targets.
+
+	Lane options, given before the platform arguments:
+		--copies N       N lanes with the same arguments (default: 1)
+		--inputs F       one lane per line of file F, the line being its arguments
+		--sweep A B      one lane per integer A..B, given as the lane's only argument
+		--quiet          discard the Machine output
+	The output of every lane is written in lane order, so it is the same as
+	running the lanes one at a time.
+*/
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(CFFC_LANES_NO_CLONES)
+#define CFFC_LANES_TARGETS __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define CFFC_LANES_TARGETS
+#endif
+
+/*
+	lane_array returns zeroed, 64 byte aligned storage for n lanes, freed with lane_free.
+*/
+void *lane_alloc(int n, int size);
+void lane_free(void *p);
+
+template <class T>
+T *lane_array(int n) {
+	return (T *) lane_alloc(n, sizeof(T));
+}
+
+class LanePlatform {
+	public:
+		LanePlatform(int argc, char **argv);
+		virtual ~LanePlatform();
+
+		int get_lanes();
+		long get_lane_steps();
+
+		/*
+			halted[l] is set when lane l has nothing more to do, e.g. it ran out of input.
+		*/
+		unsigned char *halted;
+
+		void write(std::ostream &o);
+
+	protected:
+		std::vector< std::vector<std::string> > args;
+		std::vector<std::string> out;
+		int lanes;
+		long lane_steps;
+		bool quiet;
+};
+
+class IntegerComputerLanes : public LanePlatform {
+	public:
+		IntegerComputerLanes(int argc, char **argv);
+		~IntegerComputerLanes();
+
+		void enter_state(const int *state, int exit);
+		void next_state(const unsigned char *fired);
+
+		int *input;
+		int *output;
+};
+
+class IntegerStreamComputerLanes : public LanePlatform {
+	public:
+		IntegerStreamComputerLanes(int argc, char **argv);
+		~IntegerStreamComputerLanes();
+
+		void enter_state(const int *state, int exit);
+		void next_state(const unsigned char *fired);
+
+		int *input;
+		int *output;
+
+	private:
+		std::vector< std::vector<int> > values;
+		std::vector<int> index;
+};
+
+class PositionalRobotLanes : public LanePlatform {
+	public:
+		PositionalRobotLanes(int argc, char **argv);
+		~PositionalRobotLanes();
+
+		void enter_state(const int *state, int exit);
+		void next_state(const unsigned char *fired);
+
+		float *xPos;
+		float *yPos;
+};
+
+double lanes_clock();
+void report_lanes(LanePlatform *platform, long steps, double seconds);
+
+/*
+	run_lanes is the main() of a lockstep Machine.
+	The output of all lanes goes to stdout, the step rate to stderr.
+*/
+template <class P, class M>
+int run_lanes(int argc, char **argv) {
+	P *platform = new P(argc, argv);
+	M *machine = new M(platform);
+
+	long steps = 0;
+	double start = lanes_clock();
+	while ( machine->step() ) steps++;
+	double seconds = lanes_clock() - start;
+
+	report_lanes(platform, steps, seconds);
+
+	delete machine;
+	delete platform;
+	return 0;
+}
+
+#endif
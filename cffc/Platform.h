@@ -0,0 +1,137 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+/*
+	Platform.h is all a generated Machine needs of the RunTime: the platforms
+	it is given and what they can do. It pulls in no standard headers but
+	<iosfwd>, since most of the time it takes g++ to compile a small Machine
+	is spent reading headers. The platforms are implemented in RunTime.cpp,
+	prebuilt into libcffcrt.a (see Makefile_Robot); RunTime.h adds what the
+	hand-written runners need on top.
+*/
+
+#include <iosfwd>
+
+class RunTime {
+	public:
+		RunTime(int argc, char **argv);
+		virtual ~RunTime();
+
+		virtual void enter_state();
+		virtual void next_state();
+
+		/*
+			A platform halts when it has nothing more to do, e.g. it ran out of input.
+			By default halting ends the process, like the original exit(0).
+			Step based runners turn that off and ask is_halted after each step.
+		*/
+		void halt();
+		bool is_halted();
+		void set_exit_on_halt(bool b);
+
+		/*
+			Everything a platform prints goes to this stream, std::cout by default.
+		*/
+		void set_output_stream(std::ostream *o);
+
+	protected:
+		std::ostream *out;
+
+	private:
+		bool halted;
+		bool exit_on_halt;
+};
+
+class IntegerComputer : public RunTime {
+	public:
+		IntegerComputer(int argc, char **argv);
+		~IntegerComputer();
+
+		void enter_state();
+		void next_state();		
+
+		int get_output();
+		int get_input();
+
+		void set_output(int i);
+		void set_input(int i);
+
+	private:
+		int output;
+		int input;
+};
+
+class RegexRecognizer : public RunTime {
+	public:
+		RegexRecognizer(int argc, char **argv);
+		~RegexRecognizer();
+
+		void enter_state();
+		void next_state();
+
+		char get_nextChar();
+		void set_outputBuffer(const char *s);
+
+
+	private:
+		int index;
+		char nextChar;
+		const char *ibuffer;
+		const char *obuffer;
+
+};
+
+
+class IntegerStreamComputer : public RunTime {
+		public:
+		IntegerStreamComputer(int argc, char **argv);
+		~IntegerStreamComputer();
+
+		void enter_state();
+		void next_state();
+
+		void set_output(int n);
+		int get_input();
+
+	private:
+		int index;
+		int numInputs;
+		char **inputStrings;
+		int input;
+		int output;
+};
+
+class PositionalRobot : public RunTime {
+  public:
+    PositionalRobot(int argc, char **argv);
+    ~PositionalRobot();
+
+    void enter_state();
+    void next_state();
+
+    float get_yPos();
+    float get_xPos();
+    void set_yPos(float y);
+    void set_xPos(float x);
+
+  private:
+    float yPos;
+    float xPos;
+};
+
+/*
+	run_stream_batch runs a Machine that cffc emitted as a batch kernel: a
+	single State that maps each input of an IntegerStreamComputer to its
+	output on its own (see _cpp_batch in translator.h). Instead of an
+	enter_state and next_state per step, the inputs are parsed, handed to
+	the kernel and printed a block at a time. The output is the same.
+
+	n is always a multiple of BATCH_WIDTH, the kernel loops over groups of
+	BATCH_WIDTH elements so that g++ -O2 vectorizes it without an epilogue.
+	The elements past the last input are padding and are not printed.
+*/
+#define BATCH_WIDTH 8
+typedef void (*BatchKernel)(const int *input, int *output, int n);
+int run_stream_batch(int argc, char **argv, BatchKernel kernel);
+
+#endif
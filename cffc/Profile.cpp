@@ -0,0 +1,120 @@
+#include "Profile.h"
+#include <vector>
+#include <string>
+#include <mutex>
+#include <stdio.h>
+
+/*
+	ProfileReport
+	Keeps the totals of every Machine that has gone and the counters of every
+	Machine that is still around, and prints them at exit.
+*/
+class ProfileReport {
+	public:
+		ProfileReport();
+		~ProfileReport();
+
+		void add(ProfileCounters *c, const char **states, const char **transitions);
+		void remove(ProfileCounters *c);
+
+	private:
+		void merge(ProfileCounters *c);
+
+		std::mutex lock;
+		std::vector<ProfileCounters *> live;
+		std::vector<uint64_t> totals;
+		std::vector<std::string> state_names;
+		std::vector<std::string> transition_names;
+		int states;
+		int machines;
+};
+
+static ProfileReport report;
+
+ProfileReport::ProfileReport() {
+	states = 0;
+	machines = 0;
+}
+
+void ProfileReport::add(ProfileCounters *c, const char **s, const char **t) {
+	std::lock_guard<std::mutex> guard(lock);
+	if ( totals.empty() ) {
+		states = c->states;
+		for (int k = 0; k < c->states; k++) state_names.push_back(s[k]);
+		for (int k = 0; k < c->transitions; k++) transition_names.push_back(t[k]);
+		totals = std::vector<uint64_t>(2 * c->states + 2 * c->transitions, 0);
+	}
+	live.push_back(c);
+	machines++;
+}
+
+void ProfileReport::merge(ProfileCounters *c) {
+	for (std::vector<uint64_t>::size_type k = 0; k != totals.size(); k++) totals[k] += c->counters[k];
+}
+
+void ProfileReport::remove(ProfileCounters *c) {
+	std::lock_guard<std::mutex> guard(lock);
+	merge(c);
+	for (std::vector<ProfileCounters *>::size_type k = 0; k != live.size(); k++) {
+		if ( live[k] == c ) {
+			live[k] = live.back();
+			live.pop_back();
+			break;
+		}
+	}
+}
+
+ProfileReport::~ProfileReport() {
+	if ( machines == 0 ) return;
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (std::vector<ProfileCounters *>::size_type k = 0; k != live.size(); k++) merge(live[k]);
+
+	fprintf(stderr, "\nprofile of %d machine(s)\n\n", machines);
+	fprintf(stderr, "%-32s %14s %16s %12s\n", "state", "entries", "action ticks", "ticks/entry");
+	for (int k = 0; k < states; k++) {
+		uint64_t entries = totals[k * 2];
+		uint64_t ticks = totals[k * 2 + 1];
+		fprintf(stderr, "%-32s %14llu %16llu %12.1f\n", state_names[k].c_str(),
+		        (unsigned long long) entries, (unsigned long long) ticks,
+		        entries ? (double) ticks / entries : 0.0);
+	}
+
+	fprintf(stderr, "\n%-32s %14s %16s %12s\n", "transition", "evaluations", "hits", "hit %");
+	int guards = 2 * states;
+	for (std::vector<std::string>::size_type k = 0; k != transition_names.size(); k++) {
+		uint64_t evaluations = totals[guards + k * 2];
+		uint64_t hits = totals[guards + k * 2 + 1];
+		fprintf(stderr, "%-32s %14llu %16llu %12.1f\n", transition_names[k].c_str(),
+		        (unsigned long long) evaluations, (unsigned long long) hits,
+		        evaluations ? 100.0 * hits / evaluations : 0.0);
+	}
+}
+
+/*
+	ProfileCounters
+*/
+ProfileCounters::ProfileCounters() {
+	counters = NULL;
+	states = 0;
+	transitions = 0;
+	guards = 0;
+	registered = false;
+}
+
+ProfileCounters::~ProfileCounters() {
+	if ( registered ) report.remove(this);
+	delete [] counters;
+}
+
+void ProfileCounters::open(const char **s, int count, const char **t, int tcount) {
+	if ( registered ) return;
+
+	states = count;
+	transitions = tcount;
+	guards = 2 * count;
+	counters = new uint64_t[2 * count + 2 * tcount]();
+
+	report.add(this, s, t);
+	registered = true;
+}
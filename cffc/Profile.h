@@ -0,0 +1,80 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include "Trace.h"
+
+/*
+	Profiling counts where a Machine spends its time.
+
+	Machines generated with `cffc --profile` have probes in every State and guard:
+		CFFC_PROFILE_ENTER(state)          the State was entered
+		CFFC_PROFILE_GUARD(id, guard)      the guard of transition id was evaluated, and held or not
+		CFFC_PROFILE_BEGIN / END(state)    the actions of a transition of the State ran
+	States are numbered in the order they are written in, transitions across
+	the whole Machine in the same order.
+
+	The probes only do something when the Machine is compiled with
+	-DCFFC_PROFILING (make -f Makefile_Robot profile); otherwise a probed guard
+	is just the guard.
+
+	With profiling compiled in, every Machine owns one flat array of counters,
+	indexed by State or transition. A Machine that is destroyed adds its
+	counters to the process totals; at exit the totals of all Machines are
+	printed to stderr as a table. Times are in trace_clock ticks (Trace.h),
+	which are cycles of the time stamp counter on x86.
+*/
+
+#ifdef CFFC_PROFILING
+#define CFFC_PROFILE_ENTER(state) this->profile.enter(state)
+#define CFFC_PROFILE_GUARD(id, expr) this->profile.guard(id, (expr))
+#define CFFC_PROFILE_BEGIN uint64_t profile_start = trace_clock()
+#define CFFC_PROFILE_END(state) this->profile.actions(state, trace_clock() - profile_start)
+#define CFFC_PROFILE_OPEN(states, count, transitions, tcount) this->profile.open(states, count, transitions, tcount)
+#else
+#define CFFC_PROFILE_ENTER(state)
+#define CFFC_PROFILE_GUARD(id, expr) (expr)
+#define CFFC_PROFILE_BEGIN
+#define CFFC_PROFILE_END(state)
+#define CFFC_PROFILE_OPEN(states, count, transitions, tcount)
+#endif
+
+class ProfileCounters {
+	public:
+		ProfileCounters();
+		~ProfileCounters();
+
+		/*
+			open sizes the counters and registers them for the report.
+			states and transitions are the names the report uses.
+		*/
+		void open(const char **states, int count, const char **transitions, int tcount);
+
+		inline void enter(int state) {
+			counters[state * 2]++;
+		}
+		inline void actions(int state, uint64_t ticks) {
+			counters[state * 2 + 1] += ticks;
+		}
+		inline bool guard(int id, bool held) {
+			counters[guards + id * 2]++;
+			counters[guards + id * 2 + 1] += held;
+			return held;
+		}
+
+		/*
+			Layout of counters: entries and action ticks of every State,
+			then evaluations and hits of every guard.
+		*/
+		uint64_t *counters;
+		int states;
+		int transitions;
+
+	private:
+		ProfileCounters(const ProfileCounters &);
+
+		int guards;
+		bool registered;
+};
+
+#endif
@@ -3,14 +3,29 @@
 #include <iostream>
 #include <string>
 #include <stdlib.h>
+#include <vector>
+
+#ifdef __cpp_impl_coroutine
+#include <thread>
+#endif
 
 RunTime::RunTime(int argc, char **argv) {
-	// nothing
+	out = &std::cout;
+	halted = false;
+	exit_on_halt = true;
 }
 RunTime::~RunTime() {}
 void RunTime::enter_state() {}
 void RunTime::next_state() {}
 
+void RunTime::halt() {
+	this->halted = true;
+	if ( this->exit_on_halt ) exit(0);
+}
+bool RunTime::is_halted() {return this->halted;}
+void RunTime::set_exit_on_halt(bool b) {this->exit_on_halt = b;}
+void RunTime::set_output_stream(std::ostream *o) {this->out = o;}
+
 /*
 	IntegerComputer
 */
@@ -21,7 +36,7 @@ IntegerComputer::IntegerComputer(int argc, char **argv) : RunTime(argc, argv) {
 IntegerComputer::~IntegerComputer() {}
 
 void IntegerComputer::enter_state() {}
-void IntegerComputer::next_state() {std::cout << this->output << std::endl;}
+void IntegerComputer::next_state() {*this->out << this->output << std::endl;}
 
 int IntegerComputer::get_output() {return this->output;}
 void IntegerComputer::set_output(int n) {this->output = n;}
@@ -42,13 +57,13 @@ void RegexRecognizer::enter_state() {}
 
 void RegexRecognizer::next_state() {
 	this->index++;
-	if ( !this->obuffer.empty() ) {
-		std::cout << this->obuffer << std::endl;
+	if ( this->obuffer[0] ) {
+		*this->out << this->obuffer << std::endl;
 	}
 	this->obuffer = "";
 }
 
-void RegexRecognizer::set_outputBuffer(std::string s) {this->obuffer = s;}
+void RegexRecognizer::set_outputBuffer(const char *s) {this->obuffer = s;}
 char RegexRecognizer::get_nextChar() {return this->ibuffer[ index ];}
 
 /*
@@ -65,8 +80,11 @@ void IntegerStreamComputer::enter_state() {
 	sscanf( this->inputStrings[this->index], "%d", &this->input );
 }
 void IntegerStreamComputer::next_state() {
-	std::cout << this->output << std::endl;
-	if (this->index == this->numInputs) exit(0);
+	*this->out << this->output << std::endl;
+	if (this->index == this->numInputs) {
+		this->halt();
+		return;
+	}
 	this->index++;
 }
 
@@ -86,7 +104,7 @@ void PositionalRobot::enter_state() {
 	
 }
 void PositionalRobot::next_state() {
-	std::cout << "  XPos: " << this->xPos << "  YPos: " << this->yPos << std::endl ;
+	*this->out << "  XPos: " << this->xPos << "  YPos: " << this->yPos << std::endl ;
 }
 
 void PositionalRobot::set_xPos(float f) {this->xPos = f;}
@@ -95,3 +113,216 @@ void PositionalRobot::set_yPos(float f) {this->yPos = f;}
 float PositionalRobot::get_xPos() {return this->xPos;}
 float PositionalRobot::get_yPos() {return this->yPos;}
 
+/*
+	Batch kernels
+*/
+#define BATCH_BLOCK 4096
+
+static char *_format_int(char *at, int n) {
+	char digits[10];
+	unsigned int u = n < 0 ? 0u - (unsigned int) n : (unsigned int) n;
+	int k = 0;
+	do {
+		digits[k++] = '0' + u % 10;
+		u /= 10;
+	} while ( u );
+	if ( n < 0 ) *at++ = '-';
+	while ( k ) *at++ = digits[--k];
+	*at++ = '\n';
+	return at;
+}
+
+int run_stream_batch(int argc, char **argv, BatchKernel kernel) {
+	std::vector<int> input(BATCH_BLOCK);
+	std::vector<int> output(BATCH_BLOCK);
+	std::vector<char> text(BATCH_BLOCK * 12);
+	int last = 0;
+
+	for ( int first = 1; first < argc; first += BATCH_BLOCK ) {
+		int n = argc - first < BATCH_BLOCK ? argc - first : BATCH_BLOCK;
+
+		// like enter_state, an input that is not a number keeps the one before
+		for ( int k = 0; k < n; k++ ) {
+			sscanf( argv[first + k], "%d", &last );
+			input[k] = last;
+		}
+
+		int padded = n;
+		while ( padded % BATCH_WIDTH ) input[padded++] = last;
+
+		kernel(&input[0], &output[0], padded);
+
+		char *at = &text[0];
+		for ( int k = 0; k < n; k++ ) {
+			at = _format_int(at, output[k]);
+		}
+		fwrite(&text[0], 1, at - &text[0], stdout);
+	}
+	fflush(stdout);
+	return 0;
+}
+
+
+/*
+	Scheduler
+*/
+#ifdef __cpp_impl_coroutine
+
+Scheduler::Scheduler() {
+	resumes = 0;
+}
+
+void Scheduler::schedule(std::coroutine_handle<> h) {
+	this->runnable.push_back(h);
+}
+
+void Scheduler::schedule_at(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> h) {
+	this->timers.push(Timer(deadline, h));
+}
+
+Scheduler::Sleep Scheduler::sleep_for(std::chrono::steady_clock::duration d) {
+	return Sleep(this, std::chrono::steady_clock::now() + d);
+}
+
+void Scheduler::run() {
+	for (;;) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		while ( !timers.empty() && ( runnable.empty() || timers.top().first <= now ) ) {
+			Timer t = timers.top();
+			if ( t.first > now ) {
+				std::this_thread::sleep_until(t.first);
+				now = t.first;
+			}
+			timers.pop();
+			runnable.push_back(t.second);
+		}
+
+		if ( runnable.empty() ) return;
+
+		std::coroutine_handle<> h = runnable.front();
+		runnable.pop_front();
+		resumes++;
+		h.resume();
+	}
+}
+
+long Scheduler::get_resumes() {return this->resumes;}
+
+/*
+	AsyncRunTime
+*/
+AsyncRunTime::AsyncRunTime(Scheduler *s) : RunTime(0, NULL) {
+	scheduler = s;
+	closed = false;
+	set_exit_on_halt(false);
+}
+AsyncRunTime::~AsyncRunTime() {}
+
+AsyncRunTime::EnterState AsyncRunTime::enter_state_async() {
+	return EnterState(this);
+}
+
+void AsyncRunTime::resume_enter_state() {
+	if ( ! this->has_sensor_data() ) {
+		// closed, and nothing left to read
+		this->halt();
+		return;
+	}
+	this->enter_state();
+}
+
+void AsyncRunTime::close() {
+	this->closed = true;
+	this->wake();
+}
+bool AsyncRunTime::is_closed() {return this->closed;}
+
+void AsyncRunTime::wake() {
+	if ( this->waiting && ( this->has_sensor_data() || this->closed ) ) {
+		this->scheduler->schedule(this->waiting);
+		this->waiting = std::coroutine_handle<>();
+	}
+}
+
+/*
+	AsyncIntegerStreamComputer
+	Like IntegerStreamComputer, but the inputs arrive through feed.
+	next_state consumes the input the State was entered with.
+*/
+AsyncIntegerStreamComputer::AsyncIntegerStreamComputer(Scheduler *s) : AsyncRunTime(s) {
+	input = 0;
+	output = 0;
+}
+AsyncIntegerStreamComputer::~AsyncIntegerStreamComputer() {}
+
+bool AsyncIntegerStreamComputer::has_sensor_data() {return !this->inputs.empty();}
+
+void AsyncIntegerStreamComputer::feed(std::string s) {
+	// like sscanf into the same int, a bad number keeps the previous value
+	int value = this->inputs.empty() ? this->input : this->inputs.back();
+	sscanf( s.c_str(), "%d", &value );
+	this->inputs.push_back(value);
+	this->wake();
+}
+
+void AsyncIntegerStreamComputer::enter_state() {
+	this->input = this->inputs.front();
+}
+void AsyncIntegerStreamComputer::next_state() {
+	*this->out << this->output << std::endl;
+	if ( ! this->inputs.empty() ) this->inputs.pop_front();
+}
+
+void AsyncIntegerStreamComputer::set_output(int n) {this->output = n;}
+int AsyncIntegerStreamComputer::get_input() {return this->input;}
+
+/*
+	AsyncRegexRecognizer
+	Like RegexRecognizer, but the characters arrive through feed.
+	Once closed and empty, nextChar is '\0'.
+*/
+AsyncRegexRecognizer::AsyncRegexRecognizer(Scheduler *s) : AsyncRunTime(s) {
+	nextChar = '\0';
+	obuffer = "";
+}
+AsyncRegexRecognizer::~AsyncRegexRecognizer() {}
+
+bool AsyncRegexRecognizer::has_sensor_data() {return !this->ibuffer.empty() || this->is_closed();}
+
+void AsyncRegexRecognizer::feed(std::string s) {
+	for (std::string::size_type i = 0; i != s.size(); i++) this->ibuffer.push_back(s[i]);
+	this->wake();
+}
+
+void AsyncRegexRecognizer::enter_state() {
+	this->nextChar = this->ibuffer.empty() ? '\0' : this->ibuffer.front();
+}
+void AsyncRegexRecognizer::next_state() {
+	if ( ! this->ibuffer.empty() ) this->ibuffer.pop_front();
+	if ( !this->obuffer.empty() ) {
+		*this->out << this->obuffer << std::endl;
+	}
+	this->obuffer = "";
+}
+
+void AsyncRegexRecognizer::set_outputBuffer(std::string s) {this->obuffer = s;}
+char AsyncRegexRecognizer::get_nextChar() {return this->nextChar;}
+
+int report_coroutines(std::vector<AsyncRunTime *> platforms, std::vector<std::ostringstream *> outputs, Scheduler *scheduler, double seconds) {
+	for (std::vector<std::ostringstream *>::size_type k = 0; k != outputs.size(); k++) {
+		std::cout << outputs[k]->str();
+		delete outputs[k];
+	}
+	std::cout.flush();
+
+	for (std::vector<AsyncRunTime *>::size_type k = 0; k != platforms.size(); k++) {
+		delete platforms[k];
+	}
+
+	std::cerr << "machines: " << platforms.size()
+	          << "  resumes: " << scheduler->get_resumes()
+	          << "  seconds: " << seconds << std::endl;
+	return 0;
+}
+
+#endif /* __cpp_impl_coroutine */
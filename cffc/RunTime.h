@@ -3,60 +3,156 @@
 
 #include <cstdio>
 #include <string>
-
-class RunTime {
+#include <iosfwd>
+
+/*
+	The platforms are declared in Platform.h, which is what generated Machines
+	include. RunTime.h adds the asynchronous RunTime for the runners.
+*/
+#include "Platform.h"
+
+/*
+	Below is the asynchronous RunTime, for Machines generated with `cffc --coroutine`.
+	It needs C++20 coroutines (g++ -std=c++20) and is left out otherwise.
+
+	A coroutine Machine awaits enter_state_async() at the start of every State.
+	When the platform has no sensor data yet, the Machine suspends and the Scheduler
+	runs other Machines; feeding the platform (or closing it) makes the Machine
+	runnable again. A single thread can multiplex any number of Machines this way.
+*/
+#ifdef __cpp_impl_coroutine
+
+#include <coroutine>
+#include <deque>
+#include <queue>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <stdlib.h>
+
+class Scheduler {
 	public:
-		RunTime(int argc, char **argv);
-		virtual ~RunTime();
+		Scheduler();
+
+		/*
+			schedule puts a suspended Machine on the run queue.
+			schedule_at does the same once the deadline has passed.
+		*/
+		void schedule(std::coroutine_handle<> h);
+		void schedule_at(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> h);
+
+		/*
+			run resumes Machines until none are runnable and no timer is pending.
+		*/
+		void run();
+
+		long get_resumes();
+
+		/*
+			co_await scheduler->sleep_for(d) suspends a Machine for a while.
+		*/
+		class Sleep {
+			public:
+				Sleep(Scheduler *s, std::chrono::steady_clock::time_point d) : scheduler(s), deadline(d) {}
+				bool await_ready() { return false; }
+				void await_suspend(std::coroutine_handle<> h) { scheduler->schedule_at(deadline, h); }
+				void await_resume() {}
+			private:
+				Scheduler *scheduler;
+				std::chrono::steady_clock::time_point deadline;
+		};
+		Sleep sleep_for(std::chrono::steady_clock::duration d);
 
-		virtual void enter_state();
-		virtual void next_state();
+	private:
+		typedef std::pair<std::chrono::steady_clock::time_point, std::coroutine_handle<> > Timer;
+		class Later {
+			public:
+				bool operator()(const Timer &a, const Timer &b) { return a.first > b.first; }
+		};
+
+		std::deque< std::coroutine_handle<> > runnable;
+		std::priority_queue< Timer, std::vector<Timer>, Later > timers;
+		long resumes;
 };
 
-class IntegerComputer : public RunTime {
+/*
+	MachineTask is what a coroutine Machine's run() returns.
+	It starts suspended; the Scheduler starts it. Once finished it stays
+	suspended until the MachineTask is destroyed.
+*/
+class MachineTask {
 	public:
-		IntegerComputer(int argc, char **argv);
-		~IntegerComputer();
-
-		void enter_state();
-		void next_state();		
-
-		int get_output();
-		int get_input();
-
-		void set_output(int i);
-		void set_input(int i);
+		class promise_type {
+			public:
+				MachineTask get_return_object() { return MachineTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+				std::suspend_always initial_suspend() { return std::suspend_always(); }
+				std::suspend_always final_suspend() noexcept { return std::suspend_always(); }
+				void return_void() {}
+				void unhandled_exception() { throw; }
+		};
+
+		MachineTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+		MachineTask(MachineTask &&t) : handle(t.handle) { t.handle = std::coroutine_handle<promise_type>(); }
+		~MachineTask() { if ( handle ) handle.destroy(); }
+
+		bool is_done() { return handle.done(); }
+		std::coroutine_handle<> get_handle() { return handle; }
 
 	private:
-		int output;
-		int input;
+		MachineTask(const MachineTask &);
+		std::coroutine_handle<promise_type> handle;
 };
 
-class RegexRecognizer : public RunTime {
+class AsyncRunTime : public RunTime {
 	public:
-		RegexRecognizer(int argc, char **argv);
-		~RegexRecognizer();
-
-		void enter_state();
-		void next_state();
-
-		char get_nextChar();
-		void set_outputBuffer(std::string s);
-
+		AsyncRunTime(Scheduler *s);
+		virtual ~AsyncRunTime();
+
+		/*
+			has_sensor_data is true when enter_state can run without waiting.
+			A closed platform never waits again; it halts instead.
+		*/
+		virtual bool has_sensor_data() = 0;
+
+		/*
+			feed hands the platform one more piece of input, close says there is no more.
+		*/
+		virtual void feed(std::string input) = 0;
+		void close();
+		bool is_closed();
+
+		class EnterState {
+			public:
+				EnterState(AsyncRunTime *p) : platform(p) {}
+				bool await_ready() { return platform->has_sensor_data() || platform->is_closed(); }
+				void await_suspend(std::coroutine_handle<> h) { platform->waiting = h; }
+				void await_resume() { platform->resume_enter_state(); }
+			private:
+				AsyncRunTime *platform;
+		};
+		EnterState enter_state_async();
+
+	protected:
+		/*
+			wake makes the waiting Machine runnable, if there is one and it can continue.
+		*/
+		void wake();
 
 	private:
-		int index;
-		char nextChar;
-		std::string ibuffer;
-		std::string obuffer;
+		void resume_enter_state();
 
+		Scheduler *scheduler;
+		std::coroutine_handle<> waiting;
+		bool closed;
 };
 
+class AsyncIntegerStreamComputer : public AsyncRunTime {
+	public:
+		AsyncIntegerStreamComputer(Scheduler *s);
+		~AsyncIntegerStreamComputer();
 
-class IntegerStreamComputer : public RunTime {
-		public:
-		IntegerStreamComputer(int argc, char **argv);
-		~IntegerStreamComputer();
+		bool has_sensor_data();
+		void feed(std::string input);
 
 		void enter_state();
 		void next_state();
@@ -65,30 +161,89 @@ class IntegerStreamComputer : public RunTime {
 		int get_input();
 
 	private:
-		int index;
-		int numInputs;
-		char **inputStrings;
+		std::deque<int> inputs;
 		int input;
 		int output;
 };
 
-class PositionalRobot : public RunTime {
-  public:
-    PositionalRobot(int argc, char **argv);
-    ~PositionalRobot();
+class AsyncRegexRecognizer : public AsyncRunTime {
+	public:
+		AsyncRegexRecognizer(Scheduler *s);
+		~AsyncRegexRecognizer();
+
+		bool has_sensor_data();
+		void feed(std::string input);
 
-    void enter_state();
-    void next_state();
+		void enter_state();
+		void next_state();
 
-    float get_yPos();
-    float get_xPos();
-    void set_yPos(float y);
-    void set_xPos(float x);
+		char get_nextChar();
+		void set_outputBuffer(std::string s);
 
-  private:
-    float yPos;
-    float xPos;
+	private:
+		std::deque<char> ibuffer;
+		char nextChar;
+		std::string obuffer;
 };
 
+int report_coroutines(std::vector<AsyncRunTime *> platforms, std::vector<std::ostringstream *> outputs, Scheduler *scheduler, double seconds);
+
+/*
+	run_coroutines is the main() of a coroutine Machine.
+	It starts `--machines N` Machines (default 1) on one Scheduler, feeds every
+	argument to every Machine one at a time, running whatever became runnable in
+	between, and finally closes the platforms.
+	With more than one Machine the output of each is buffered and written in order.
+*/
+template <class P, class M>
+int run_coroutines(int argc, char **argv) {
+	int machines = 1;
+	int a = 1;
+	if ( argc > 2 && std::string(argv[1]) == "--machines" ) {
+		machines = atoi(argv[2]);
+		a = 3;
+	}
+
+	Scheduler scheduler;
+	std::vector<AsyncRunTime *> platforms;
+	std::vector<std::ostringstream *> outputs;
+	std::vector<M *> instances;
+	std::vector<MachineTask *> tasks;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (int k = 0; k < machines; k++) {
+		P *platform = new P(&scheduler);
+		if ( machines > 1 ) {
+			outputs.push_back(new std::ostringstream());
+			platform->set_output_stream(outputs.back());
+		}
+		M *machine = new M(platform);
+		MachineTask *task = new MachineTask(machine->run());
+		scheduler.schedule(task->get_handle());
+
+		platforms.push_back(platform);
+		instances.push_back(machine);
+		tasks.push_back(task);
+	}
+	scheduler.run();
+
+	for ( ; a < argc; a++) {
+		for (int k = 0; k < machines; k++) platforms[k]->feed(argv[a]);
+		scheduler.run();
+	}
+	for (int k = 0; k < machines; k++) platforms[k]->close();
+	scheduler.run();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	for (int k = 0; k < machines; k++) {
+		delete tasks[k];
+		delete instances[k];
+	}
+	return report_coroutines(platforms, outputs, &scheduler, elapsed.count());
+}
+
+#endif /* __cpp_impl_coroutine */
 
 #endif
\ No newline at end of file
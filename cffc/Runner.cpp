@@ -0,0 +1,310 @@
+#include "Runner.h"
+#include <iostream>
+#include <fstream>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+	Instance
+*/
+Instance::Instance(std::vector<std::string> a) : sink(output.rdbuf()) {
+	this->args = a;
+	for (std::vector<std::string>::size_type i = 0; i != this->args.size(); i++) {
+		this->argv.push_back(&this->args[i][0]);
+	}
+	this->argv.push_back(NULL);
+}
+Instance::~Instance() {}
+
+int Instance::get_argc() {return this->args.size();}
+char **Instance::get_argv() {return &this->argv[0];}
+
+void Instance::discard_output() {this->sink.setstate(std::ios::badbit);}
+
+/*
+	Worker
+	Each worker thread has its own deque of Instances. The owner takes from
+	the back, thieves take from the front.
+*/
+class Worker {
+	public:
+		Worker() : steps(0) {}
+
+		std::deque<Instance *> queue;
+		std::mutex lock;
+		long steps;
+};
+
+/*
+	Pool
+	queued counts the Instances waiting in the deques and idle the workers
+	asleep on wake, which is signalled when an Instance is put back or the
+	last one finishes.
+
+	instances are in Instance order, finished marks the ones that are done
+	and next is the first that is not; all three are kept under written.
+*/
+class Pool {
+	public:
+		std::vector<Worker *> workers;
+		std::atomic<long> remaining;
+		std::atomic<long> queued;
+		std::atomic<int> idle;
+		std::mutex sleeping;
+		std::condition_variable wake;
+		int slice;
+		bool pin;
+		bool quiet;
+
+		std::vector<Instance *> instances;
+		std::vector<bool> finished;
+		std::vector<Instance *>::size_type next;
+		std::mutex written;
+};
+
+static void pin_to_core(int core) {
+#ifdef __linux__
+	int cores = std::thread::hardware_concurrency();
+	if ( cores < 1 ) return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % cores, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+/*
+	take
+	Finds the next Instance for worker `self`: first its own deque, then the others.
+*/
+static Instance *take(Pool *pool, int self) {
+	int n = pool->workers.size();
+
+	for (int k = 0; k < n; k++) {
+		Worker *w = pool->workers[(self + k) % n];
+		std::lock_guard<std::mutex> guard(w->lock);
+
+		if ( w->queue.empty() ) continue;
+
+		Instance *i;
+		if ( k == 0 ) {
+			i = w->queue.back();
+			w->queue.pop_back();
+		} else {
+			i = w->queue.front();
+			w->queue.pop_front();
+		}
+		pool->queued--;
+		return i;
+	}
+
+	return NULL;
+}
+
+/*
+	sleep_until_work
+	Sleeps until an Instance is put back on a deque or the last one finishes.
+*/
+static void sleep_until_work(Pool *pool) {
+	std::unique_lock<std::mutex> guard(pool->sleeping);
+	pool->idle++;
+	pool->wake.wait(guard, [pool] { return pool->queued > 0 || pool->remaining == 0; });
+	pool->idle--;
+}
+
+static void wake_idle(Pool *pool, bool all) {
+	if ( pool->idle == 0 ) return;
+	std::lock_guard<std::mutex> guard(pool->sleeping);
+	if ( all ) pool->wake.notify_all();
+	else pool->wake.notify_one();
+}
+
+/*
+	write_in_order
+	Called by the worker that ran Instance k for a slice, finished or not.
+	Writes out what can be written in Instance order: Instance k's buffer if
+	it is the first unfinished one, and every finished Instance from there on.
+	Only finished Instances, or the caller's own, are touched.
+*/
+static void write_in_order(Pool *pool, std::vector<Instance *>::size_type k, bool done) {
+	std::lock_guard<std::mutex> guard(pool->written);
+
+	if ( done ) pool->finished[k] = true;
+	if ( k != pool->next ) return;
+
+	while ( pool->next != pool->instances.size() ) {
+		Instance *i = pool->instances[pool->next];
+		// another worker may be running it
+		if ( ! pool->finished[pool->next] && pool->next != k ) break;
+		if ( ! pool->quiet ) {
+			std::cout << i->output.str();
+			i->output.str("");
+		}
+		if ( ! pool->finished[pool->next] ) break;
+		delete i;
+		pool->instances[pool->next] = NULL;
+		pool->next++;
+	}
+}
+
+static void work(Pool *pool, int self) {
+	Worker *me = pool->workers[self];
+	long steps = 0;
+
+	if ( pool->pin ) pin_to_core(self);
+
+	while ( pool->remaining > 0 ) {
+
+		Instance *i = take(pool, self);
+		if ( i == NULL ) {
+			sleep_until_work(pool);
+			continue;
+		}
+
+		bool running = true;
+		for (int k = 0; running && k < pool->slice; k++) {
+			running = i->step();
+			steps++;
+		}
+
+		std::vector<Instance *>::size_type index = i->index;
+		if ( running ) {
+			write_in_order(pool, index, false);
+			{
+				std::lock_guard<std::mutex> guard(me->lock);
+				me->queue.push_back(i);
+			}
+			pool->queued++;
+			wake_idle(pool, false);
+		} else {
+			write_in_order(pool, index, true);
+			if ( --pool->remaining == 0 ) wake_idle(pool, true);
+		}
+	}
+
+	me->steps = steps;
+}
+
+/*
+	read_inputs
+	Every non-empty line of the file becomes the arguments of one Instance.
+*/
+static bool read_inputs(std::string filename, std::string program, std::vector< std::vector<std::string> > *inputs) {
+	std::ifstream in(filename.c_str());
+	if ( ! in ) return false;
+
+	std::string line;
+	while ( std::getline(in, line) ) {
+		std::istringstream words(line);
+		std::vector<std::string> args;
+		args.push_back(program);
+
+		std::string word;
+		while ( words >> word ) args.push_back(word);
+
+		if ( args.size() > 1 ) inputs->push_back(args);
+	}
+	return true;
+}
+
+int run_instances(InstanceFactory *factory, int argc, char **argv) {
+
+	int threads = std::thread::hardware_concurrency();
+	int copies = 1;
+	int slice = 64;
+	bool pin = false;
+	bool quiet = false;
+	std::string inputs_file("");
+
+	int a = 1;
+	for ( ; a < argc; a++) {
+		std::string arg(argv[a]);
+		if ( arg == "--threads" && a + 1 < argc ) {
+			threads = atoi(argv[++a]);
+		} else if ( arg == "--copies" && a + 1 < argc ) {
+			copies = atoi(argv[++a]);
+		} else if ( arg == "--slice" && a + 1 < argc ) {
+			slice = atoi(argv[++a]);
+		} else if ( arg == "--inputs" && a + 1 < argc ) {
+			inputs_file = argv[++a];
+		} else if ( arg == "--pin" ) {
+			pin = true;
+		} else if ( arg == "--quiet" ) {
+			quiet = true;
+		} else {
+			break;
+		}
+	}
+
+	if ( threads < 1 ) threads = 1;
+	if ( slice < 1 ) slice = 1;
+
+	std::vector< std::vector<std::string> > inputs;
+	if ( ! inputs_file.empty() ) {
+		if ( ! read_inputs(inputs_file, argv[0], &inputs) ) {
+			std::cerr << "File \"" << inputs_file << "\" not found." << std::endl;
+			return 2;
+		}
+	} else {
+		std::vector<std::string> args;
+		args.push_back(argv[0]);
+		for (int k = a; k < argc; k++) args.push_back(argv[k]);
+		for (int k = 0; k < copies; k++) inputs.push_back(args);
+	}
+
+	Pool pool;
+	for (std::vector< std::vector<std::string> >::size_type k = 0; k != inputs.size(); k++) {
+		pool.instances.push_back(factory->create(inputs[k]));
+		pool.instances.back()->index = k;
+		if ( quiet ) pool.instances.back()->discard_output();
+	}
+	pool.finished.assign(pool.instances.size(), false);
+	pool.next = 0;
+	pool.remaining = pool.instances.size();
+	pool.queued = pool.instances.size();
+	pool.idle = 0;
+	pool.slice = slice;
+	pool.pin = pin;
+	pool.quiet = quiet;
+	for (int k = 0; k < threads; k++) pool.workers.push_back(new Worker());
+
+	// hand out the Instances round robin, the workers balance it from there
+	for (std::vector<Instance *>::size_type k = 0; k != pool.instances.size(); k++) {
+		pool.workers[k % threads]->queue.push_back(pool.instances[k]);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> running;
+	for (int k = 0; k < threads; k++) running.push_back(std::thread(work, &pool, k));
+	for (int k = 0; k < threads; k++) running[k].join();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	long steps = 0;
+	for (int k = 0; k < threads; k++) {
+		steps += pool.workers[k]->steps;
+		delete pool.workers[k];
+	}
+
+	std::cout.flush();
+
+	double seconds = elapsed.count();
+	std::cerr << "instances: " << pool.instances.size()
+	          << "  threads: " << threads
+	          << "  steps: " << steps
+	          << "  seconds: " << seconds
+	          << "  steps/sec: " << ( seconds > 0 ? steps / seconds : 0 ) << std::endl;
+
+	return 0;
+}
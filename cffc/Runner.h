@@ -0,0 +1,111 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+/*
+	The Runner runs many independent Machine/platform pairs in one process.
+
+	Every Instance owns its own platform arguments, platform, Machine and output
+	buffer. Instances are handed out to a pool of worker threads, each with its
+	own deque of Instances. A worker runs an Instance for a slice of steps and
+	puts it back on its own deque; a worker with an empty deque steals from the
+	others, and sleeps while every Instance left is running on another worker.
+	The output is written in Instance order, so it is the same as running them
+	one at a time: the first unfinished Instance writes out its buffer after
+	every slice, and an Instance that finishes behind it is written, and
+	deleted, as soon as every Instance before it has finished.
+
+	Generated Machines (cffc --runner) call run_machines from their main().
+	Runner options, given before the platform arguments:
+		--threads N   number of worker threads (default: number of cores)
+		--copies N    run N Instances with the same arguments (default: 1)
+		--inputs F    run one Instance per line of file F, the line being its arguments
+		--slice N     steps per scheduling slice (default: 64)
+		--pin         pin each worker thread to a core
+		--quiet       discard the Machine output
+	The aggregate step count and steps/sec are reported on stderr.
+*/
+
+class Instance {
+	public:
+		Instance(std::vector<std::string> args);
+		virtual ~Instance();
+
+		/*
+			step runs one State of the Machine and returns false when it is finished.
+		*/
+		virtual bool step() = 0;
+
+		int get_argc();
+		char **get_argv();
+
+		/*
+			The platform writes to sink, which fills output.
+			discard_output puts sink in a failed state so nothing is even formatted.
+		*/
+		void discard_output();
+
+		std::ostringstream output;
+		std::ostream sink;
+
+		/*
+			index is where the Instance is in the Runner's order.
+		*/
+		std::vector<Instance *>::size_type index;
+
+	private:
+		std::vector<std::string> args;
+		std::vector<char *> argv;
+};
+
+class InstanceFactory {
+	public:
+		virtual ~InstanceFactory() {}
+		virtual Instance *create(std::vector<std::string> args) = 0;
+};
+
+int run_instances(InstanceFactory *factory, int argc, char **argv);
+
+/*
+	MachineInstance glues a generated Machine M to its platform P.
+*/
+template <class P, class M>
+class MachineInstance : public Instance {
+	public:
+		MachineInstance(std::vector<std::string> args) : Instance(args) {
+			this->platform = new P(this->get_argc(), this->get_argv());
+			this->platform->set_exit_on_halt(false);
+			this->platform->set_output_stream(&this->sink);
+			this->machine = new M(this->platform);
+		}
+		~MachineInstance() {
+			delete this->machine;
+			delete this->platform;
+		}
+		bool step() {
+			return this->machine->step();
+		}
+
+	private:
+		P *platform;
+		M *machine;
+};
+
+template <class P, class M>
+class MachineFactory : public InstanceFactory {
+	public:
+		Instance *create(std::vector<std::string> args) {
+			return new MachineInstance<P, M>(args);
+		}
+};
+
+template <class P, class M>
+int run_machines(int argc, char **argv) {
+	MachineFactory<P, M> factory;
+	return run_instances(&factory, argc, argv);
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include "Simulation.h"
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+
+/*
+	EventQueue
+	Children of node i are 4i+1 .. 4i+4. push and pop move a hole instead of
+	swapping, so every level costs one copy.
+*/
+EventQueue::EventQueue() {
+	seq = 0;
+}
+
+bool EventQueue::earlier(const Event &a, const Event &b) {
+	if ( a.time != b.time ) return a.time < b.time;
+	return a.seq < b.seq;
+}
+
+void EventQueue::push(double time, unsigned int machine) {
+	Event e;
+	e.time = time;
+	e.machine = machine;
+	e.seq = seq++;
+
+	int hole = heap.size();
+	heap.push_back(e);
+
+	while ( hole > 0 ) {
+		int parent = ( hole - 1 ) / 4;
+		if ( ! earlier(e, heap[parent]) ) break;
+		heap[hole] = heap[parent];
+		hole = parent;
+	}
+	heap[hole] = e;
+}
+
+Event EventQueue::pop() {
+	Event first = heap[0];
+	Event last = heap.back();
+	heap.pop_back();
+
+	int n = heap.size();
+	if ( n == 0 ) return first;
+
+	int hole = 0;
+	for (;;) {
+		int child = 4 * hole + 1;
+		if ( child >= n ) break;
+
+		int end = child + 4;
+		if ( end > n ) end = n;
+
+		int least = child;
+		for (int c = child + 1; c < end; c++) {
+			if ( earlier(heap[c], heap[least]) ) least = c;
+		}
+
+		if ( ! earlier(heap[least], last) ) break;
+		heap[hole] = heap[least];
+		hole = least;
+	}
+	heap[hole] = last;
+
+	return first;
+}
+
+const Event &EventQueue::top() {return this->heap[0];}
+bool EventQueue::empty() {return this->heap.empty();}
+int EventQueue::size() {return this->heap.size();}
+
+/*
+	SimulatedPlatform
+*/
+SimulatedPlatform::SimulatedPlatform() {
+	now = 0.0;
+	wakeup = 0.0;
+}
+SimulatedPlatform::~SimulatedPlatform() {}
+
+double SimulatedPlatform::get_now() {return this->now;}
+double SimulatedPlatform::get_wakeup() {return this->wakeup;}
+
+void SimulatedPlatform::set_now(double t) {
+	this->now = t;
+	this->wakeup = t;
+}
+
+void SimulatedPlatform::wake_after(double delay) {this->wakeup = this->now + delay;}
+
+/*
+	SimulatedPositionalRobot
+*/
+SimulatedPositionalRobot::SimulatedPositionalRobot(int argc, char **argv) : PositionalRobot(argc, argv) {
+	set_xPos(0.0);
+	set_yPos(0.0);
+	speed = 1.0;
+	distance = 0.0;
+	lastX = 0.0;
+	lastY = 0.0;
+}
+SimulatedPositionalRobot::~SimulatedPositionalRobot() {}
+
+void SimulatedPositionalRobot::set_speed(double s) {this->speed = s;}
+
+void SimulatedPositionalRobot::next_state() {
+	double dx = get_xPos() - lastX;
+	double dy = get_yPos() - lastY;
+	double d = ( dx < 0 ? -dx : dx ) + ( dy < 0 ? -dy : dy );
+
+	lastX = get_xPos();
+	lastY = get_yPos();
+	distance += d;
+
+	// the robots drive along the grid, so the distance is Manhattan
+	if ( d > 0 ) wake_after(d / speed);
+}
+
+void SimulatedPositionalRobot::report(std::ostream &o) {
+	o << "  XPos: " << get_xPos() << "  YPos: " << get_yPos()
+	  << "  distance: " << distance << "  time: " << get_now() << std::endl;
+}
+
+/*
+	Simulation
+*/
+Simulation::Simulation() {
+	now = 0.0;
+	finished = 0;
+}
+Simulation::~Simulation() {
+	for (std::vector<SimulatedMachine *>::size_type k = 0; k != machines.size(); k++) {
+		delete machines[k];
+	}
+}
+
+int Simulation::add(SimulatedMachine *m, double start) {
+	int id = machines.size();
+	machines.push_back(m);
+	queue.push(start, id);
+	return id;
+}
+
+long Simulation::run(double until) {
+	long events = 0;
+
+	while ( ! queue.empty() ) {
+		if ( until >= 0 && queue.top().time > until ) break;
+
+		Event e = queue.pop();
+		SimulatedMachine *m = machines[e.machine];
+		SimulatedPlatform *p = m->get_platform();
+
+		now = e.time;
+		p->set_now(now);
+		events++;
+
+		if ( m->step() ) {
+			queue.push(p->get_wakeup(), e.machine);
+		} else {
+			finished++;
+		}
+	}
+
+	return events;
+}
+
+double Simulation::get_now() {return this->now;}
+int Simulation::get_finished() {return this->finished;}
+SimulatedMachine *Simulation::get_machine(int k) {return this->machines[k];}
+int Simulation::get_machines() {return this->machines.size();}
+
+/*
+	SimulationOptions
+*/
+SimulationOptions::SimulationOptions(int argc, char **argv) {
+	machines = 1;
+	speed_from = 1.0;
+	speed_to = 1.0;
+	until = -1.0;
+	quiet = false;
+
+	int a = 1;
+	for ( ; a < argc; a++) {
+		std::string arg(argv[a]);
+		if ( arg == "--machines" && a + 1 < argc ) {
+			machines = atoi(argv[++a]);
+		} else if ( arg == "--speeds" && a + 2 < argc ) {
+			speed_from = atof(argv[++a]);
+			speed_to = atof(argv[++a]);
+		} else if ( arg == "--until" && a + 1 < argc ) {
+			until = atof(argv[++a]);
+		} else if ( arg == "--quiet" ) {
+			quiet = true;
+		} else {
+			break;
+		}
+	}
+	first = a;
+
+	if ( machines < 1 ) machines = 1;
+	if ( speed_from <= 0 ) speed_from = 1.0;
+	if ( speed_to <= 0 ) speed_to = speed_from;
+}
+
+double simulation_speed(SimulationOptions *options, int k) {
+	if ( options->machines == 1 ) return options->speed_from;
+	return options->speed_from + ( options->speed_to - options->speed_from ) * k / ( options->machines - 1 );
+}
+
+double simulation_clock() {
+	std::chrono::duration<double> d = std::chrono::steady_clock::now().time_since_epoch();
+	return d.count();
+}
+
+int report_simulation(Simulation *simulation, SimulationOptions *options, long events, double seconds) {
+	if ( ! options->quiet ) {
+		for (int k = 0; k < simulation->get_machines(); k++) {
+			simulation->get_machine(k)->get_platform()->report(std::cout);
+		}
+		std::cout.flush();
+	}
+
+	std::cerr << "machines: " << simulation->get_machines()
+	          << "  finished: " << simulation->get_finished()
+	          << "  events: " << events
+	          << "  virtual time: " << simulation->get_now()
+	          << "  seconds: " << seconds
+	          << "  events/sec: " << ( seconds > 0 ? events / seconds : 0 ) << std::endl;
+	return 0;
+}
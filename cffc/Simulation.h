@@ -0,0 +1,226 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include "RunTime.h"
+
+/*
+	The Simulation runs a fleet of Machines on one virtual clock.
+
+	Every Machine is an event source. The Simulation keeps one pending event per
+	Machine in an EventQueue, ordered by virtual time. Running an event sets the
+	clock to its time and steps that Machine once; the platform then says when
+	the Machine wants to run again (its next wakeup), and the Machine goes back
+	on the queue at that time. Nothing sleeps: virtual time jumps from event to
+	event, so a fleet that spends hours driving around is simulated in seconds.
+
+	Generated Machines (cffc --simulation) call run_simulation from their main().
+	Simulation options, given before the platform arguments:
+		--machines N   number of Machines in the fleet (default: 1)
+		--speeds A B   spread the speeds of the robots evenly over A..B (default: 1 1)
+		--until T      stop the clock at virtual time T (default: run until all are done)
+		--quiet        do not print where every robot ended up
+	The number of events and events/sec are reported on stderr.
+*/
+
+/*
+	Event is the next wakeup of one Machine.
+	seq breaks ties between equal times, so equal times run in the order they were scheduled.
+*/
+class Event {
+	public:
+		double time;
+		unsigned int machine;
+		unsigned int seq;
+};
+
+/*
+	EventQueue is a 4-ary min-heap of Events in one flat array.
+	A 4-ary heap is half as deep as a binary one and the four children of a
+	node sit next to each other in memory, which suits a queue that is popped
+	and pushed once for every event.
+*/
+class EventQueue {
+	public:
+		EventQueue();
+
+		void push(double time, unsigned int machine);
+		Event pop();
+		const Event &top();
+
+		bool empty();
+		int size();
+
+	private:
+		bool earlier(const Event &a, const Event &b);
+
+		std::vector<Event> heap;
+		unsigned int seq;
+};
+
+/*
+	SimulatedPlatform is the virtual time side of a platform.
+	The Simulation sets now before every step; the platform calls wake_after to
+	say how long the step took. A platform that never calls it runs again at the
+	same time, after every other Machine already waiting for that time.
+*/
+class SimulatedPlatform {
+	public:
+		SimulatedPlatform();
+		virtual ~SimulatedPlatform();
+
+		double get_now();
+		double get_wakeup();
+		void set_now(double t);
+
+		void wake_after(double delay);
+
+		/*
+			report writes where the Machine ended up, one line.
+		*/
+		virtual void report(std::ostream &o) = 0;
+
+	private:
+		double now;
+		double wakeup;
+};
+
+/*
+	SimulatedPositionalRobot drives instead of printing.
+	Every State takes as long as the robot needs to drive to its new position
+	at its speed, so a State that does not move takes no time at all.
+*/
+class SimulatedPositionalRobot : public PositionalRobot, public SimulatedPlatform {
+	public:
+		SimulatedPositionalRobot(int argc, char **argv);
+		~SimulatedPositionalRobot();
+
+		void next_state();
+		void set_speed(double s);
+
+		void report(std::ostream &o);
+
+	private:
+		double speed;
+		double distance;
+		float lastX;
+		float lastY;
+};
+
+class SimulatedMachine {
+	public:
+		virtual ~SimulatedMachine() {}
+
+		/*
+			step runs one State of the Machine and returns false when it is finished.
+		*/
+		virtual bool step() = 0;
+		virtual SimulatedPlatform *get_platform() = 0;
+};
+
+class Simulation {
+	public:
+		Simulation();
+		~Simulation();
+
+		/*
+			add takes ownership of the Machine, which first runs at virtual time start.
+		*/
+		int add(SimulatedMachine *m, double start);
+
+		/*
+			run processes events in time order until the queue is empty or the
+			next event is later than until (a negative until never stops early).
+			Returns the number of events processed.
+		*/
+		long run(double until);
+
+		double get_now();
+		int get_finished();
+		SimulatedMachine *get_machine(int k);
+		int get_machines();
+
+	private:
+		std::vector<SimulatedMachine *> machines;
+		EventQueue queue;
+		double now;
+		int finished;
+};
+
+/*
+	SimulationInstance glues a generated Machine M to its simulated platform P.
+*/
+template <class P, class M>
+class SimulationInstance : public SimulatedMachine {
+	public:
+		SimulationInstance(int argc, char **argv) {
+			this->platform = new P(argc, argv);
+			this->platform->set_exit_on_halt(false);
+			this->machine = new M(this->platform);
+		}
+		~SimulationInstance() {
+			delete this->machine;
+			delete this->platform;
+		}
+		bool step() {
+			return this->machine->step();
+		}
+		SimulatedPlatform *get_platform() {
+			return this->platform;
+		}
+		P *get_simulated() {
+			return this->platform;
+		}
+
+	private:
+		P *platform;
+		M *machine;
+};
+
+class SimulationOptions {
+	public:
+		SimulationOptions(int argc, char **argv);
+
+		int machines;
+		double speed_from;
+		double speed_to;
+		double until;
+		bool quiet;
+
+		/*
+			first is the index of the first platform argument.
+		*/
+		int first;
+};
+
+double simulation_speed(SimulationOptions *options, int k);
+int report_simulation(Simulation *simulation, SimulationOptions *options, long events, double seconds);
+double simulation_clock();
+
+template <class P, class M>
+int run_simulation(int argc, char **argv) {
+	SimulationOptions options(argc, argv);
+
+	// the platform sees the program name followed by its own arguments
+	std::vector<char *> args;
+	args.push_back(argv[0]);
+	for (int k = options.first; k < argc; k++) args.push_back(argv[k]);
+	args.push_back(NULL);
+
+	Simulation simulation;
+	for (int k = 0; k < options.machines; k++) {
+		SimulationInstance<P, M> *instance = new SimulationInstance<P, M>(args.size() - 1, &args[0]);
+		instance->get_simulated()->set_speed( simulation_speed(&options, k) );
+		simulation.add(instance, 0.0);
+	}
+
+	double start = simulation_clock();
+	long events = simulation.run(options.until);
+	double seconds = simulation_clock() - start;
+
+	return report_simulation(&simulation, &options, events, seconds);
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <chrono>
+
+/*
+	stopwatch times a Machine for the runtime benchmarks (make -f Makefile_Bench).
+
+		stopwatch [--repeat N] LABEL COMMAND [ARGS...]
+		stopwatch --header
+
+	COMMAND is run N times (default: 1). Its stdout goes into a pipe that is
+	only read to count lines, its stderr to /dev/null. Every sample prints one
+	line per transition, so the lines are the transitions taken; the wall time
+	of the runs includes starting the processes.
+
+	Prints one row: label, transitions, seconds, transitions/sec and ns/transition.
+*/
+
+static double now() {
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/*
+	run starts argv, counts the lines it writes and returns them, or -1 if it failed.
+*/
+static long run(char **argv) {
+	int fds[2];
+	if ( pipe(fds) != 0 ) return -1;
+
+	pid_t pid = fork();
+	if ( pid < 0 ) return -1;
+	if ( pid == 0 ) {
+		dup2(fds[1], 1);
+		int null = open("/dev/null", O_WRONLY);
+		if ( null >= 0 ) dup2(null, 2);
+		close(fds[0]);
+		close(fds[1]);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	long lines = 0;
+	char buffer[1 << 16];
+	ssize_t n;
+	while ( ( n = read(fds[0], buffer, sizeof(buffer)) ) > 0 ) {
+		for (const char *c = buffer; ( c = (const char *) memchr(c, '\n', buffer + n - c) ) != NULL; c++) lines++;
+	}
+	close(fds[0]);
+
+	int status;
+	if ( waitpid(pid, &status, 0) < 0 ) return -1;
+	if ( !WIFEXITED(status) || WEXITSTATUS(status) != 0 ) return -1;
+	return lines;
+}
+
+int main(int argc, char **argv) {
+	if ( argc == 2 && strcmp(argv[1], "--header") == 0 ) {
+		printf("%-32s %12s %10s %16s %14s\n", "machine", "transitions", "seconds", "transitions/sec", "ns/transition");
+		return 0;
+	}
+
+	int first = 1;
+	long repeat = 1;
+	if ( argc > 2 && strcmp(argv[1], "--repeat") == 0 ) {
+		repeat = atol(argv[2]);
+		first = 3;
+	}
+	if ( argc - first < 2 || repeat < 1 ) {
+		fprintf(stderr, "usage: stopwatch [--repeat N] LABEL COMMAND [ARGS...]\n       stopwatch --header\n");
+		return 1;
+	}
+	const char *label = argv[first];
+
+	long transitions = 0;
+	double start = now();
+	for (long k = 0; k < repeat; k++) {
+		long lines = run(argv + first + 1);
+		if ( lines < 0 ) {
+			fprintf(stderr, "stopwatch: %s failed\n", label);
+			return 1;
+		}
+		transitions += lines;
+	}
+	double seconds = now() - start;
+
+	printf("%-32s %12ld %10.3f %16.0f %14.1f\n", label, transitions, seconds,
+	       transitions / seconds, seconds * 1e9 / ( transitions > 0 ? transitions : 1 ));
+	return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+/*
+	Swap.h is the C ABI of a Machine generated with `cffc --swap`. Such a
+	Machine is built as a shared object (machine.so, see Makefile_Robot)
+	instead of a program, and swap_host (SwapHost.cpp) dlopens it. The host
+	owns the platform; the Machine only holds its variables and its State.
+
+	Because the host only finds these functions by name, it can load a new
+	version of the Machine while it runs: it creates the new Machine on the
+	same platform, puts it in the State of the same name, gives every
+	variable the value of the old variable of the same name and type, and
+	goes on stepping the new one. A Machine only has to be compiled against
+	the same CFF_SWAP_ABI as the host.
+
+	Every Machine is a void * to the host. Values cross as doubles, which
+	hold every int, float, char and bool exactly.
+*/
+
+#define CFF_SWAP_ABI 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cff_variable {
+	const char *name;
+	const char *type;
+} cff_variable;
+
+/* CFF_SWAP_ABI of the Machine */
+int cff_abi(void);
+
+/* the name of the platform class the Machine runs on, e.g. "IntegerComputer" */
+const char *cff_platform(void);
+
+/* a new Machine in its initial State on platform, and its end */
+void *cff_create(void *platform);
+void cff_destroy(void *machine);
+
+/* runs the current State once, returns 0 when the Machine is finished */
+int cff_step(void *machine);
+
+/* the Machine variables in the order they are declared, and their number */
+int cff_variables(const cff_variable **variables);
+double cff_get(void *machine, int variable);
+void cff_set(void *machine, int variable, double value);
+
+/* the name of the current State, NULL once the Machine exited */
+const char *cff_state(void *machine);
+/* moves the Machine to the named State, returns 0 when it has none of that name */
+int cff_set_state(void *machine, const char *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
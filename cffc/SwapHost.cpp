@@ -0,0 +1,246 @@
+#include "Swap.h"
+#include "Platform.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+/*
+	swap_host runs a Machine built with `cffc --swap` (see Swap.h) and swaps
+	in new versions of it while it runs, between two steps.
+
+	Usage: swap_host [--check N] [--upgrade STEP:LIB]... LIB [platform arguments]
+
+	It watches LIB and loads it again when the file changes, checking every
+	N steps (default 1024, 0 turns it off). --upgrade swaps in LIB after
+	STEP steps, for trying out an upgrade the same way every time.
+
+	A swap keeps the platform and everything it holds, and carries the Machine
+	over by name: the new one starts in the State of the same name and its
+	variables get the values of the old variables of the same name. Variables
+	that are new start at 0. When the new Machine has no State of that name,
+	a variable changed its type, or it runs on another platform, the swap is
+	refused and the old version keeps running. Swaps are reported on stderr.
+
+	dlopen hands out the library it already has for a path it has seen, and
+	rebuilding a library in place changes the pages a running host executes,
+	so every version is copied and loaded from a file of its own.
+*/
+
+class Version {
+	public:
+		Version() : handle(NULL) {}
+
+		void *handle;
+		int (*abi)(void);
+		const char *(*platform)(void);
+		void *(*create)(void *platform);
+		void (*destroy)(void *machine);
+		int (*step)(void *machine);
+		int (*variables)(const cff_variable **variables);
+		double (*get)(void *machine, int variable);
+		void (*set)(void *machine, int variable, double value);
+		const char *(*state)(void *machine);
+		int (*set_state)(void *machine, const char *state);
+};
+
+static void *symbol(Version *v, const char *name, std::string *error) {
+	void *f = dlsym(v->handle, name);
+	if ( ! f && error->empty() ) *error = std::string("no ") + name;
+	return f;
+}
+
+static bool load(std::string path, Version *v, std::string *error) {
+	static int loaded = 0;
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if ( ! in ) {
+		*error = "not found";
+		return false;
+	}
+	const char *tmp = getenv("TMPDIR");
+	std::ostringstream copy;
+	copy << ( tmp ? tmp : "/tmp" ) << "/swap_host-" << getpid() << "-" << loaded++ << ".so";
+	{
+		std::ofstream out(copy.str().c_str(), std::ios::binary);
+		out << in.rdbuf();
+		if ( ! out ) {
+			*error = "can not copy it to " + copy.str();
+			return false;
+		}
+	}
+	v->handle = dlopen(copy.str().c_str(), RTLD_NOW | RTLD_LOCAL);
+	unlink(copy.str().c_str());
+	if ( ! v->handle ) {
+		*error = dlerror();
+		return false;
+	}
+
+	*error = "";
+	v->abi = (int (*)(void)) symbol(v, "cff_abi", error);
+	v->platform = (const char *(*)(void)) symbol(v, "cff_platform", error);
+	v->create = (void *(*)(void *)) symbol(v, "cff_create", error);
+	v->destroy = (void (*)(void *)) symbol(v, "cff_destroy", error);
+	v->step = (int (*)(void *)) symbol(v, "cff_step", error);
+	v->variables = (int (*)(const cff_variable **)) symbol(v, "cff_variables", error);
+	v->get = (double (*)(void *, int)) symbol(v, "cff_get", error);
+	v->set = (void (*)(void *, int, double)) symbol(v, "cff_set", error);
+	v->state = (const char *(*)(void *)) symbol(v, "cff_state", error);
+	v->set_state = (int (*)(void *, const char *)) symbol(v, "cff_set_state", error);
+	if ( error->empty() && v->abi() != CFF_SWAP_ABI ) *error = "built for another swap ABI";
+	if ( ! error->empty() ) {
+		dlclose(v->handle);
+		return false;
+	}
+	return true;
+}
+
+static RunTime *create_platform(std::string name, int argc, char **argv) {
+	if ( name == "IntegerComputer" ) return new IntegerComputer(argc, argv);
+	if ( name == "IntegerStreamComputer" ) return new IntegerStreamComputer(argc, argv);
+	if ( name == "RegexRecognizer" ) return new RegexRecognizer(argc, argv);
+	if ( name == "PositionalRobot" ) return new PositionalRobot(argc, argv);
+	return NULL;
+}
+
+/*
+	carry_over moves the running Machine of current to the new version next.
+	Returns "" and sets notes when it did, otherwise why it did not.
+*/
+static std::string carry_over(Version *current, void **machine, Version *next, RunTime *platform, std::string *notes) {
+	if ( std::string(next->platform()) != current->platform() ) {
+		return std::string("it runs on the ") + next->platform();
+	}
+	std::string state(current->state(*machine));
+	void *m = next->create(platform);
+	if ( ! next->set_state(m, state.c_str()) ) {
+		next->destroy(m);
+		return "it has no State " + state;
+	}
+
+	const cff_variable *before, *after;
+	int n_before = current->variables(&before);
+	int n_after = next->variables(&after);
+	std::vector<bool> kept(n_before, false);
+	*notes = "";
+	for ( int k = 0; k < n_after; k++ ) {
+		int i = 0;
+		while ( i < n_before && std::string(before[i].name) != after[k].name ) i++;
+		if ( i == n_before ) {
+			next->set(m, k, 0);
+			*notes = *notes + ", " + after[k].name + " is new";
+		} else if ( std::string(before[i].type) != after[k].type ) {
+			next->destroy(m);
+			return std::string(after[k].name) + " is a " + after[k].type + " now";
+		} else {
+			next->set(m, k, current->get(*machine, i));
+			kept[i] = true;
+		}
+	}
+	for ( int i = 0; i < n_before; i++ ) {
+		if ( ! kept[i] ) *notes = *notes + ", " + before[i].name + " is gone";
+	}
+
+	current->destroy(*machine);
+	dlclose(current->handle);
+	*current = *next;
+	*machine = m;
+	return "";
+}
+
+static void swap(std::string path, long steps, Version *current, void **machine, RunTime *platform) {
+	Version next;
+	std::string error, notes;
+	if ( load(path, &next, &error) ) {
+		std::string state(current->state(*machine));
+		error = carry_over(current, machine, &next, platform, &notes);
+		if ( error.empty() ) {
+			std::cerr << "swap_host: step " << steps << ": swapped in " << path << " in State " << state << notes << std::endl;
+			return;
+		}
+		dlclose(next.handle);
+	}
+	std::cerr << "swap_host: step " << steps << ": not swapping in " << path << ": " << error << std::endl;
+}
+
+static std::string signature(std::string path) {
+	struct stat s;
+	if ( stat(path.c_str(), &s) != 0 ) return "";
+	std::ostringstream out;
+	out << s.st_ino << " " << s.st_size << " " << s.st_mtim.tv_sec << "." << s.st_mtim.tv_nsec;
+	return out.str();
+}
+
+int main(int argc, char **argv) {
+	long check = 1024;
+	std::vector<long> upgrade_steps;
+	std::vector<std::string> upgrade_paths;
+
+	int a = 1;
+	for ( ; a < argc; a++ ) {
+		std::string arg(argv[a]);
+		if ( arg == "--check" && a + 1 < argc ) {
+			check = atol(argv[++a]);
+		} else if ( arg == "--upgrade" && a + 1 < argc ) {
+			std::string upgrade(argv[++a]);
+			std::string::size_type colon = upgrade.find(':');
+			if ( colon == std::string::npos ) {
+				std::cerr << "--upgrade needs STEP:LIB." << std::endl;
+				return 1;
+			}
+			upgrade_steps.push_back(atol(upgrade.substr(0, colon).c_str()));
+			upgrade_paths.push_back(upgrade.substr(colon + 1));
+		} else {
+			break;
+		}
+	}
+	if ( a == argc ) {
+		std::cerr << "Usage: swap_host [--check N] [--upgrade STEP:LIB]... LIB [platform arguments]" << std::endl;
+		return 1;
+	}
+	std::string path(argv[a]);
+
+	Version current;
+	std::string error;
+	if ( ! load(path, &current, &error) ) {
+		std::cerr << path << ": " << error << std::endl;
+		return 1;
+	}
+	std::string watched = signature(path);
+
+	// the platform gets the library in place of the program name
+	RunTime *platform = create_platform(current.platform(), argc - a, argv + a);
+	if ( ! platform ) {
+		std::cerr << path << ": unknown platform " << current.platform() << std::endl;
+		return 1;
+	}
+	platform->set_exit_on_halt(false);
+	void *machine = current.create(platform);
+
+	long steps = 0;
+	unsigned int next_upgrade = 0;
+	while ( current.step(machine) ) {
+		steps++;
+		while ( next_upgrade < upgrade_steps.size() && upgrade_steps[next_upgrade] <= steps ) {
+			swap(upgrade_paths[next_upgrade], steps, &current, &machine, platform);
+			next_upgrade++;
+		}
+		if ( check > 0 && steps % check == 0 ) {
+			std::string now = signature(path);
+			if ( now != watched ) {
+				watched = now;
+				swap(path, steps, &current, &machine, platform);
+			}
+		}
+	}
+
+	current.destroy(machine);
+	delete platform;
+	dlclose(current.handle);
+	return 0;
+}
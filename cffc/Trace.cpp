@@ -0,0 +1,202 @@
+#include "Trace.h"
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(__x86_64__) && !defined(__i386__)
+uint64_t trace_clock() {
+	std::chrono::nanoseconds d = std::chrono::steady_clock::now().time_since_epoch();
+	return d.count();
+}
+#endif
+
+/*
+	TraceWriter
+	The one consumer of every TraceRing. It starts with the first ring that is
+	opened and is stopped by its destructor at exit, after a last drain.
+	See Trace.h for the rings it outlives, and those it does not.
+*/
+class TraceWriter {
+	public:
+		TraceWriter();
+		~TraceWriter();
+
+		uint32_t add(TraceRing *r, const char **states, int count);
+		void remove(TraceRing *r);
+
+	private:
+		void run();
+		int drain_all();
+
+		std::mutex lock;
+		std::vector<TraceRing *> rings;
+		std::thread thread;
+		std::atomic<bool> stopping;
+		bool started;
+		uint32_t machines;
+		uint64_t dropped;
+
+		uint64_t start_tick;
+		std::chrono::steady_clock::time_point start_time;
+};
+
+static FILE *trace_file = NULL;
+
+static void trace_write(uint32_t machine, const TraceRecord *records, int count) {
+	uint32_t block[4] = { 'R', machine, (uint32_t) count, 0 };
+	fwrite(block, sizeof(block), 1, trace_file);
+	fwrite(records, sizeof(TraceRecord), count, trace_file);
+}
+
+/*
+	The writer is made by the first ring that is opened, in the constructor
+	of its Machine, so it is destroyed after every Machine made from then on.
+	writer_closed is only set, never destroyed: a ring that is destroyed later
+	still can tell that the writer is gone.
+*/
+static bool writer_closed = false;
+
+static TraceWriter &trace_writer() {
+	static TraceWriter writer;
+	return writer;
+}
+
+TraceWriter::TraceWriter() {
+	stopping = false;
+	started = false;
+	machines = 0;
+	dropped = 0;
+	start_tick = 0;
+}
+
+TraceWriter::~TraceWriter() {
+	writer_closed = true;
+	if ( ! started ) return;
+
+	stopping = true;
+	thread.join();
+
+	std::lock_guard<std::mutex> guard(lock);
+	drain_all();
+	for (std::vector<TraceRing *>::size_type k = 0; k != rings.size(); k++) {
+		dropped += rings[k]->get_dropped();
+	}
+
+	// ticks per second, measured over the whole run
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+	uint64_t ticks = trace_clock() - start_tick;
+	double rate = elapsed.count() > 0 ? ticks / elapsed.count() : 1e9;
+
+	uint32_t block[2] = { 'C', 0 };
+	fwrite(block, sizeof(block), 1, trace_file);
+	fwrite(&dropped, sizeof(dropped), 1, trace_file);
+	fwrite(&start_tick, sizeof(start_tick), 1, trace_file);
+	fwrite(&rate, sizeof(rate), 1, trace_file);
+	fclose(trace_file);
+}
+
+uint32_t TraceWriter::add(TraceRing *r, const char **states, int count) {
+	std::lock_guard<std::mutex> guard(lock);
+
+	if ( ! started ) {
+		const char *name = getenv("CFFC_TRACE_FILE");
+		if ( name == NULL ) name = "machine.trace";
+		trace_file = fopen(name, "wb");
+		if ( trace_file == NULL ) {
+			fprintf(stderr, "Could not open trace file \"%s\".\n", name);
+			exit(2);
+		}
+
+		fwrite("CFFCTRC1", 8, 1, trace_file);
+		uint32_t block[2] = { 'N', (uint32_t) count };
+		fwrite(block, sizeof(block), 1, trace_file);
+		for (int k = 0; k < count; k++) fwrite(states[k], strlen(states[k]) + 1, 1, trace_file);
+
+		start_tick = trace_clock();
+		start_time = std::chrono::steady_clock::now();
+		started = true;
+		thread = std::thread(&TraceWriter::run, this);
+	}
+
+	rings.push_back(r);
+	return machines++;
+}
+
+void TraceWriter::remove(TraceRing *r) {
+	std::lock_guard<std::mutex> guard(lock);
+	r->drain(trace_write);
+	dropped += r->get_dropped();
+	for (std::vector<TraceRing *>::size_type k = 0; k != rings.size(); k++) {
+		if ( rings[k] == r ) {
+			rings[k] = rings.back();
+			rings.pop_back();
+			break;
+		}
+	}
+}
+
+int TraceWriter::drain_all() {
+	int n = 0;
+	for (std::vector<TraceRing *>::size_type k = 0; k != rings.size(); k++) {
+		n += rings[k]->drain(trace_write);
+	}
+	return n;
+}
+
+void TraceWriter::run() {
+	while ( ! stopping ) {
+		int n;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			n = drain_all();
+		}
+		// back off while the Machines are quiet
+		if ( n == 0 ) std::this_thread::sleep_for(std::chrono::microseconds(200));
+		else std::this_thread::yield();
+	}
+}
+
+/*
+	TraceRing
+*/
+TraceRing::TraceRing() {
+	head = 0;
+	tail = 0;
+	cached_tail = 0;
+	dropped = 0;
+	machine = 0;
+	registered = false;
+}
+
+TraceRing::~TraceRing() {
+	if ( registered && ! writer_closed ) trace_writer().remove(this);
+}
+
+void TraceRing::open(const char **states, int count) {
+	if ( registered || writer_closed ) return;
+	machine = trace_writer().add(this, states, count);
+	registered = true;
+}
+
+int TraceRing::drain(void (*write)(uint32_t machine, const TraceRecord *records, int count)) {
+	uint32_t t = tail.load(std::memory_order_relaxed);
+	uint32_t h = head.load(std::memory_order_acquire);
+	int n = h - t;
+	if ( n == 0 ) return 0;
+
+	// the pending records may wrap around the end of the ring
+	uint32_t from = t & ( CAPACITY - 1 );
+	int first = CAPACITY - from;
+	if ( first > n ) first = n;
+	write(machine, &records[from], first);
+	if ( n > first ) write(machine, &records[0], n - first);
+
+	tail.store(h, std::memory_order_release);
+	return n;
+}
+
+uint64_t TraceRing::get_dropped() {return this->dropped.load(std::memory_order_relaxed);}
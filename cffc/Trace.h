@@ -0,0 +1,138 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+	Tracing records every transition a Machine takes.
+
+	Machines generated with `cffc --trace` call CFFC_TRACE(from, to, transition)
+	right before platform->next_state(). from and to are State numbers in the
+	order the States are written in the CFF file, to is CFFC_TRACE_EXIT for an
+	exit, and transition counts the transitions of a State from 0.
+
+	The calls only do something when the Machine is compiled with
+	-DCFFC_TRACING (make -f Makefile_Robot trace); otherwise they expand to
+	nothing and the Machine is the same as without --trace.
+
+	With tracing compiled in, every Machine owns a TraceRing: a fixed size,
+	single producer / single consumer ring of TraceRecords. The Machine is the
+	producer and never waits; when its ring is full the record is dropped and
+	counted. One background thread is the consumer for all rings and appends
+	what it drains to the trace file, named by the CFFC_TRACE_FILE environment
+	variable (default: machine.trace). Read it with trace_decode.
+
+	The writer thread is started by the first ring that is opened, and the
+	file is finished when the writer is destroyed at exit, after every Machine
+	made after that first one. A Machine that is destroyed later still, such
+	as one with static storage made before the first ring was opened, is
+	drained one last time by the writer and loses only what it records after
+	that. Its ring never touches the writer once the writer is gone, and a
+	ring opened after that records nothing.
+
+	The trace file is a sequence of blocks, each starting with a uint32 kind:
+		'N'  uint32 count, then count NUL terminated State names
+		'R'  uint32 machine, uint32 count, uint32 0, then count TraceRecords
+		'C'  uint32 0, uint64 dropped, uint64 start, double ticks per second
+	written in host byte order, behind the 8 byte magic "CFFCTRC1".
+*/
+
+#define CFFC_TRACE_EXIT 0xffff
+
+/*
+	Records per TraceRing, a power of two.
+*/
+#ifndef CFFC_TRACE_CAPACITY
+#define CFFC_TRACE_CAPACITY 4096
+#endif
+
+#ifdef CFFC_TRACING
+#define CFFC_TRACE(from, to, transition) this->trace.record(from, to, transition)
+#define CFFC_TRACE_OPEN(states, count) this->trace.open(states, count)
+#else
+#define CFFC_TRACE(from, to, transition)
+#define CFFC_TRACE_OPEN(states, count)
+#endif
+
+/*
+	trace_clock is the cheapest clock there is: the time stamp counter on x86,
+	nanoseconds of the steady clock elsewhere. The 'C' block says how to convert it.
+*/
+#if defined(__x86_64__) || defined(__i386__)
+inline uint64_t trace_clock() { return __rdtsc(); }
+#else
+uint64_t trace_clock();
+#endif
+
+/*
+	TraceRecord is 16 bytes; which Machine it belongs to is in the 'R' block.
+*/
+class TraceRecord {
+	public:
+		uint64_t time;
+		uint16_t from;
+		uint16_t to;
+		uint16_t transition;
+		uint16_t unused;
+};
+
+class TraceRing {
+	public:
+		TraceRing();
+		~TraceRing();
+
+		/*
+			open registers the ring with the trace file's writer thread.
+			states names the States, once per process.
+		*/
+		void open(const char **states, int count);
+
+		inline void record(int from, int to, int transition) {
+			uint32_t h = head.load(std::memory_order_relaxed);
+			if ( h - cached_tail == CAPACITY ) {
+				cached_tail = tail.load(std::memory_order_acquire);
+				if ( h - cached_tail == CAPACITY ) {
+					dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					return;
+				}
+			}
+			TraceRecord &r = records[h & ( CAPACITY - 1 )];
+			r.time = trace_clock();
+			r.from = from;
+			r.to = to;
+			r.transition = transition;
+			r.unused = 0;
+			head.store(h + 1, std::memory_order_release);
+		}
+
+		/*
+			drain is the consumer side, called by the writer thread only.
+			It hands the pending records to write and returns how many there were.
+		*/
+		int drain(void (*write)(uint32_t machine, const TraceRecord *records, int count));
+
+		uint64_t get_dropped();
+
+	private:
+		enum { CAPACITY = CFFC_TRACE_CAPACITY };
+
+		TraceRing(const TraceRing &);
+
+		TraceRecord records[CAPACITY];
+
+		// head is written by the producer, tail by the consumer, each on its own cache line
+		alignas(64) std::atomic<uint32_t> head;
+		uint32_t cached_tail;
+		std::atomic<uint64_t> dropped;
+		alignas(64) std::atomic<uint32_t> tail;
+
+		uint32_t machine;
+		bool registered;
+};
+
+#endif
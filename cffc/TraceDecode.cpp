@@ -0,0 +1,141 @@
+#include "Trace.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+/*
+	trace_decode prints the trace file written by a Machine compiled with tracing,
+	see Trace.h.
+
+	Usage: trace_decode [--summary] [FILE]   (default: machine.trace)
+
+	Without --summary every transition is printed in time order, one per line:
+		time in ns since the trace started, Machine, from State -> to State, transition
+	With --summary it prints how often each transition was taken instead.
+*/
+
+class DecodedRecord {
+	public:
+		uint32_t machine;
+		TraceRecord record;
+};
+
+static bool earlier(const DecodedRecord &a, const DecodedRecord &b) {
+	return a.record.time < b.record.time;
+}
+
+static std::string state_name(std::vector<std::string> &states, int k) {
+	if ( k == CFFC_TRACE_EXIT ) return "exit";
+	if ( k < (int) states.size() ) return states[k];
+	return "?";
+}
+
+int main(int argc, char **argv) {
+	bool summary = false;
+	std::string filename("machine.trace");
+
+	for (int a = 1; a < argc; a++) {
+		std::string arg(argv[a]);
+		if ( arg == "--summary" ) summary = true;
+		else filename = arg;
+	}
+
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if ( ! in ) {
+		std::cerr << "File \"" << filename << "\" not found." << std::endl;
+		return 2;
+	}
+
+	char magic[8];
+	if ( ! in.read(magic, 8) || memcmp(magic, "CFFCTRC1", 8) != 0 ) {
+		std::cerr << "\"" << filename << "\" is not a trace file." << std::endl;
+		return 3;
+	}
+
+	std::vector<std::string> states;
+	std::vector<DecodedRecord> records;
+	std::map<uint32_t, bool> machines;
+	uint64_t dropped = 0;
+	uint64_t start = 0;
+	double rate = 0;
+	bool closed = false;
+
+	uint32_t kind;
+	while ( in.read((char *) &kind, sizeof(kind)) ) {
+		if ( kind == 'N' ) {
+			uint32_t count;
+			in.read((char *) &count, sizeof(count));
+			for (uint32_t k = 0; k < count; k++) {
+				std::string name;
+				std::getline(in, name, '\0');
+				states.push_back(name);
+			}
+		} else if ( kind == 'R' ) {
+			uint32_t header[3];
+			in.read((char *) header, sizeof(header));
+			machines[header[0]] = true;
+			for (uint32_t k = 0; k < header[1] && in; k++) {
+				DecodedRecord d;
+				d.machine = header[0];
+				in.read((char *) &d.record, sizeof(TraceRecord));
+				records.push_back(d);
+			}
+		} else if ( kind == 'C' ) {
+			uint32_t unused;
+			in.read((char *) &unused, sizeof(unused));
+			in.read((char *) &dropped, sizeof(dropped));
+			in.read((char *) &start, sizeof(start));
+			in.read((char *) &rate, sizeof(rate));
+			closed = true;
+		} else {
+			std::cerr << "Unknown block in \"" << filename << "\"." << std::endl;
+			return 3;
+		}
+	}
+
+	if ( ! closed ) {
+		// the Machine did not exit normally; show the ticks as they are
+		std::cerr << "The trace was not closed, times are in clock ticks." << std::endl;
+		rate = 1e9;
+		if ( ! records.empty() ) start = records[0].record.time;
+	}
+
+	std::stable_sort(records.begin(), records.end(), earlier);
+
+	if ( ! summary ) {
+		char line[64];
+		for (std::vector<DecodedRecord>::size_type k = 0; k != records.size(); k++) {
+			TraceRecord &r = records[k].record;
+			double ns = ( (double) ( r.time - start ) ) * 1e9 / rate;
+			snprintf(line, sizeof(line), "%14.0f  %6u  ", ns, records[k].machine);
+			std::cout << line << state_name(states, r.from) << " -> " << state_name(states, r.to)
+			          << "  (" << r.transition << ")" << std::endl;
+		}
+		return 0;
+	}
+
+	std::map< std::string, long > taken;
+	for (std::vector<DecodedRecord>::size_type k = 0; k != records.size(); k++) {
+		TraceRecord &r = records[k].record;
+		char index[16];
+		snprintf(index, sizeof(index), "  (%u)", r.transition);
+		taken[state_name(states, r.from) + " -> " + state_name(states, r.to) + index]++;
+	}
+
+	double seconds = 0;
+	if ( records.size() > 1 ) seconds = ( records.back().record.time - records.front().record.time ) / rate;
+
+	std::cout << "machines: " << machines.size()
+	          << "  transitions: " << records.size()
+	          << "  dropped: " << dropped
+	          << "  seconds: " << seconds << std::endl;
+	for (std::map< std::string, long >::iterator i = taken.begin(); i != taken.end(); i++) {
+		std::cout << "  " << i->first << ": " << i->second << std::endl;
+	}
+	return 0;
+}
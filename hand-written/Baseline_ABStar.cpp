@@ -0,0 +1,41 @@
+/*
+	ABStar written by hand as a switch in a loop, for the runtime benchmarks
+	(cffc/Makefile_Bench). Like the RegexRecognizer platform it reads one
+	character per transition and prints the output buffer.
+*/
+
+#include <iostream>
+
+enum State { Final, NeedB, Error, Exit };
+
+int main(int argc, char **argv) {
+	const char *ibuffer = argc > 1 ? argv[1] : "";
+	State state = Final;
+
+	for (int index = 0; state != Exit; index++) {
+		char nextChar = ibuffer[index];
+		const char *outputBuffer = "";
+
+		switch ( state ) {
+			case Final:
+				if ( nextChar == 'a' ) { outputBuffer = "In Final, found A"; state = NeedB; }
+				else if ( nextChar != '\0' ) { outputBuffer = "In Final, found something other than B"; state = Error; }
+				else { outputBuffer = "In Final, exiting."; state = Exit; }
+				break;
+			case NeedB:
+				if ( nextChar == 'b' ) { outputBuffer = "In NeedB, found B"; state = Final; }
+				else if ( nextChar != '\0' ) { outputBuffer = "In NeedB, found something other than B"; state = Error; }
+				else { outputBuffer = "In NeeDB, exiting."; state = Exit; }
+				break;
+			case Error:
+				if ( nextChar != '\0' ) { outputBuffer = "In Error"; }
+				else { outputBuffer = "In Error, exiting."; state = Exit; }
+				break;
+			case Exit:
+				break;
+		}
+
+		std::cout << outputBuffer << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,42 @@
+/*
+	Box written by hand as four loops, for the runtime benchmarks
+	(cffc/Makefile_Bench). Like the PositionalRobot platform it prints the
+	position after every transition.
+*/
+
+#include <iostream>
+
+static void report(float xPos, float yPos) {
+	std::cout << "  XPos: " << xPos << "  YPos: " << yPos << std::endl;
+}
+
+int main() {
+	// Init
+	int timesAround = 0;
+	float xPos = 0.0;
+	float yPos = 0.0;
+	report(xPos, yPos);
+
+	for (;;) {
+		// MoveNorth, the only State that can exit
+		if ( timesAround == 4 ) break;
+		while ( yPos < 100 ) { yPos = yPos + 1.0; report(xPos, yPos); }
+		report(xPos, yPos);
+
+		// MoveEast
+		while ( xPos < 100 ) { xPos = xPos + 1.0; report(xPos, yPos); }
+		report(xPos, yPos);
+
+		// MoveSouth
+		while ( yPos > 0.0 ) { yPos = yPos - 1.0; report(xPos, yPos); }
+		report(xPos, yPos);
+
+		// MoveWest
+		while ( xPos > 0.0 ) { xPos = xPos - 1.0; report(xPos, yPos); }
+		timesAround = timesAround + 1;
+		report(xPos, yPos);
+	}
+	report(xPos, yPos);
+
+	return 0;
+}
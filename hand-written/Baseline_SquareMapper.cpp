@@ -0,0 +1,18 @@
+/*
+	SquareMapper written by hand as a loop, for the runtime benchmarks
+	(cffc/Makefile_Bench). Like the IntegerStreamComputer platform it reads one
+	input from the arguments per transition and prints the output.
+*/
+
+#include <stdio.h>
+#include <iostream>
+
+int main(int argc, char **argv) {
+	for (int k = 1; k < argc; k++) {
+		int input = 0;
+		sscanf(argv[k], "%d", &input);
+		int output = input * input;
+		std::cout << output << std::endl;
+	}
+	return 0;
+}
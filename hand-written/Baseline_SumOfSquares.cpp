@@ -0,0 +1,30 @@
+/*
+	SumOfSquares written by hand as a loop, for the runtime benchmarks
+	(cffc/Makefile_Bench). It prints exactly what the generated Machine on the
+	IntegerComputer platform prints: the output after every transition.
+*/
+
+#include <stdio.h>
+#include <iostream>
+
+int main(int argc, char **argv) {
+	int input = 0;
+	if ( argc > 1 ) sscanf(argv[1], "%d", &input);
+	int output = 0;
+
+	// Start
+	int i = 0;
+	int s = 0;
+	std::cout << output << std::endl;
+
+	// Compute
+	while ( i <= input ) {
+		s = s + i * i;
+		i = i + 1;
+		std::cout << output << std::endl;
+	}
+	output = s;
+	std::cout << output << std::endl;
+
+	return 0;
+}
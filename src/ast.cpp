@@ -21,6 +21,12 @@
 	----
 */
 
+thread_local long Node::created = 0;
+
+Node::Node() {
+	Node::created++;
+}
+
 std::string Node::cppCode_h() {
 	// nothing
 	return "";
@@ -88,6 +94,12 @@ Expr* Comparison::get_left() {
 Expr* Comparison::get_right() {
 	return this->right;
 }
+void Comparison::set_left(Expr *l) {
+	this->left = l;
+}
+void Comparison::set_right(Expr *r) {
+	this->right = r;
+}
 std::string Comparison::cppCode_cpp() {
 	std::string output("");
 	output = output + " " + this->get_left()->cppCode_cpp() + " " + this->get_operator() + " " + this->get_right()->cppCode_cpp() + " "; 
@@ -147,10 +159,19 @@ Expr* Operator::get_left() {
 Expr* Operator::get_right() {
 	return this->right;
 }
+void Operator::set_left(Expr *l) {
+	this->left = l;
+}
+void Operator::set_right(Expr *r) {
+	this->right = r;
+}
+/*
+	Parentheses keep the shape of the tree: (a + b) * c must not come out as a + b * c.
+*/
 std::string Operator::cppCode_cpp() {
 	std::string output("");
 
-	output = output + " " + this->get_left()->cppCode_cpp() + " " + this->get_operator() + " " + this->get_right()->cppCode_cpp() + " "; 
+	output = output + " ( " + this->get_left()->cppCode_cpp() + " " + this->get_operator() + " " + this->get_right()->cppCode_cpp() + " ) "; 
 	return output;
 }
 
@@ -185,6 +206,9 @@ Subtract::Subtract(Expr *l, Expr *r): Operator(l, r) {
 
 Variable::Variable(std::string name) {
 	this->name = name;
+	this->on_platform = false;
+	this->local_type = "";
+	this->cached = false;
 };
 std::string Variable::get_name() {
 	return this->name;
@@ -195,9 +219,26 @@ void Variable::set_on_platform(bool b) {
 bool Variable::is_on_platform() {
 	return on_platform;
 }
+bool Variable::is_local() {
+	return !this->local_type.empty();
+}
+std::string Variable::get_local_type() {
+	return this->local_type;
+}
+void Variable::set_local(std::string type) {
+	this->local_type = type;
+}
+bool Variable::is_cached() {
+	return this->cached;
+}
+void Variable::set_cached(bool b) {
+	this->cached = b;
+}
 std::string Variable::cppCode_cpp() {
 	if ( this->is_on_platform() ) {
 		return "platform->get_" + this->get_name() + "()";
+	} else if ( this->is_local() || this->is_cached() ) {
+		return this->get_name();
 	} else {
 		return "this->" + this->get_name();
 	}
@@ -220,6 +261,7 @@ std::string Variable::cppCode_cpp() {
 Stmt::Stmt(Variable *var, Expr *expr) {
 	this->var = var;
 	this->expr = expr;
+	this->next = NULL;
 	this->empty = false;
 }
 Stmt::Stmt() {
@@ -234,6 +276,9 @@ Variable* Stmt::get_variable() {
 Expr* Stmt::get_expr() {
 	return this->expr;
 }
+void Stmt::set_expr(Expr *e) {
+	this->expr = e;
+}
 /*
 	----
 	set_next
@@ -285,6 +330,10 @@ Transition::Transition(Variable *v, Expr *e, Stmt *s) {
 	this->exitKwd = false;
 	this->next = NULL;
 	this->empty = false;
+	this->always = false;
+	this->never = false;
+	this->shared_guard = 0;
+	this->shared_action = 0;
 }
 Transition::Transition(Expr *e, Stmt *s) {
 	this->var = NULL;
@@ -293,23 +342,41 @@ Transition::Transition(Expr *e, Stmt *s) {
 	this->exitKwd = true;
 	this->next = NULL;
 	this->empty = false;
+	this->always = false;
+	this->never = false;
+	this->shared_guard = 0;
+	this->shared_action = 0;
 }
 Transition::Transition() {
 	this->var = NULL;
 	this->expr = NULL;
+	this->stmt = NULL;
 	this->exitKwd = false;
 	this->next = NULL;
 	this->empty = true;
+	this->always = false;
+	this->never = false;
+	this->shared_guard = 0;
+	this->shared_action = 0;
 }
 Variable* Transition::get_variable() {
 	return this->var;
 }
+void Transition::set_variable(Variable *v) {
+	this->var = v;
+}
 Expr* Transition::get_expr() {
 	return this->expr;
 }
+void Transition::set_expr(Expr *e) {
+	this->expr = e;
+}
 Stmt* Transition::get_stmt() {
 	return this->stmt;
 }
+void Transition::set_stmt(Stmt *s) {
+	this->stmt = s;
+}
 
 void Transition::set_next(Transition *n) {
 	this->next = n;
@@ -330,6 +397,37 @@ bool Transition::has_next() {
 	return ( this->next != NULL );
 }
 
+bool Transition::is_always() {
+	return this->always;
+}
+bool Transition::is_never() {
+	return this->never;
+}
+void Transition::set_always(bool b) {
+	this->always = b;
+}
+void Transition::set_never(bool b) {
+	this->never = b;
+}
+std::vector<Stmt*> Transition::get_fused() {
+	return this->fused;
+}
+void Transition::set_fused(std::vector<Stmt*> f) {
+	this->fused = f;
+}
+int Transition::get_shared_guard() {
+	return this->shared_guard;
+}
+int Transition::get_shared_action() {
+	return this->shared_action;
+}
+void Transition::set_shared_guard(int id) {
+	this->shared_guard = id;
+}
+void Transition::set_shared_action(int id) {
+	this->shared_action = id;
+}
+
 /*
 	----
 	State implementation.
@@ -366,6 +464,9 @@ Variable* State::get_variable() {
 Transition* State::get_transition() {
 	return this->transition;
 }
+void State::set_transition(Transition *t) {
+	this->transition = t;
+}
 State* State::get_next() {
 	return this->next;
 }
@@ -467,8 +568,16 @@ Type* Decl::get_type() {
 Variable* Decl::get_variable() {
 	return this->var;
 }
+std::string Decl::get_storage() {
+	return this->storage.empty() ? this->type->get_type() : this->storage;
+}
+void Decl::set_storage(std::string s) {
+	this->storage = s;
+}
 std::string Decl::cppCode_h() {
-	return "\t\t" + this->type->get_type() + " " + this->get_variable()->get_name() + ";\n";
+	// a local is declared where it is assigned
+	if ( this->get_variable()->is_local() ) return "";
+	return "\t\t" + this->get_storage() + " " + this->get_variable()->get_name() + ";\n";
 }
 
 /*
@@ -530,8 +639,15 @@ Program::~Program() {}
 Variable* Program::get_variable() {return this->var;}
 DeclList* Program::get_decls() {return this->decls;}
 State* Program::get_states() {return this->states;}
+void Program::set_states(State *s) {
+	this->states = s;
+	this->states_count = this->get_state_count();
+}
 Platform* Program::get_platform() {return this->platform;}
 
+Options* Program::get_options() {return &this->options;}
+void Program::set_options(Options o) {this->options = o;}
+
 std::string Program::getName() {
 	return this->var->get_name();
 }
@@ -539,14 +655,59 @@ std::string Program::getName() {
 std::string Program::cppCode_cpp() {
 	std::string output("");
 
-	output = output + _cpp_includes();
-	output = output + _cpp_constructor_deconstructor(this);
+	output = output + _cpp_includes(this);
+
+	if ( this->options.backend == "lockstep" ) {
+
+		output = output + _cpp_lanes_constructor_deconstructor(this);
+		output = output + _cpp_lanes_step(this);
+		output = output + _cpp_lanes_main(this);
+
+	} else if ( this->options.backend == "coroutine" ) {
+
+		output = output + _cpp_coroutine_constructor_deconstructor(this);
+		output = output + _cpp_coroutine_run(this);
+		output = output + _cpp_coroutine_main(this);
+
+	} else if ( this->options.backend == "table" ) {
+
+		output = output + _cpp_table(this);
+		output = output + _cpp_table_main(this);
+
+	} else if ( this->options.is_stepping() ) {
+
+		output = output + _cpp_step_constructor_deconstructor(this);
+
+		// states
+		output = output + _cpp_shared(this);
+		output = output + _cpp_step_states(this);
+		output = output + _cpp_step(this);
+
+		// main
+		if ( this->options.backend == "simulation" ) {
+			output = output + _cpp_simulation_main(this);
+		} else if ( this->options.backend == "swap" ) {
+			output = output + _cpp_swap_abi(this);
+		} else {
+			output = output + _cpp_runner_main(this);
+		}
+
+	} else if ( _batches(this) ) {
 
-	// states
-	output = output + _cpp_states(this);
+		output = output + _cpp_batch(this);
 
-	// main
-	output = output + _cpp_main(this);
+	} else {
+
+		output = output + _cpp_constructor_deconstructor(this);
+
+		// states
+		output = output + _cpp_shared(this);
+		output = output + _cpp_states(this);
+
+		// main
+		output = output + _cpp_main(this);
+
+	}
 
 	output = output + "\n\n\n";
 
@@ -567,16 +728,40 @@ std::string Program::cppCode_h() {
 	output = output + _header_machine_class_open(this);
 
 	output = output + _header_machine_public();
-	output = output + _header_machine_constructor_deconstructor(this);
 
-	// decls
-	output = output + _header_machine_decls(this);
+	if ( this->options.backend == "lockstep" ) {
+
+		output = output + _header_lanes_machine(this);
+
+	} else if ( this->options.backend == "coroutine" ) {
+
+		output = output + _header_coroutine_machine(this);
+
+	} else if ( this->options.backend == "table" ) {
+
+		output = output + _header_table_machine(this);
+
+	} else {
+
+		output = output + _header_machine_constructor_deconstructor(this);
+
+		// decls
+		output = output + _header_machine_decls(this);
+
+		// states
+		output = output + _header_machine_states(this);
+		if ( this->options.is_stepping() ) {
+			output = output + _header_machine_step(this);
+		}
+
+		// end stuff
+		output = output + _header_machine_private(this);
+
+	}
 
-	// states
-	output = output + _header_machine_states(this);
+	output = output + _header_trace(this);
+	output = output + _header_profile(this);
 
-	// end stuff
-	output = output + _header_machine_private(this);
 	output = output + _header_machine_class_close();
 
 	output = output + _header_machine_main();
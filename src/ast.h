@@ -6,6 +6,7 @@
 #include <vector>
 #include <map>
 
+#include "options.h"
 
 /*
 	----
@@ -15,7 +16,13 @@
 
 class Node {
 	public:
+		Node();
 		virtual ~Node() {};
+
+		/*
+			created counts every Node made so far by this thread, for cffc --stats.
+		*/
+		static thread_local long created;
 		virtual std::string cppCode_h();
 		virtual std::string cppCode_cpp();
 };
@@ -105,6 +112,8 @@ class Comparison: public Expr {
 		virtual ~Comparison();
 		virtual Expr* get_left();
 		virtual Expr* get_right();
+		virtual void set_left(Expr *l);
+		virtual void set_right(Expr *r);
 
 		virtual std::string get_operator() {
 			return this->op;
@@ -163,6 +172,8 @@ class Operator: public Expr {
 		virtual ~Operator();
 		virtual Expr* get_left();
 		virtual Expr* get_right();
+		virtual void set_left(Expr *l);
+		virtual void set_right(Expr *r);
 
 		virtual std::string get_operator() {
 			return this->op;
@@ -199,6 +210,11 @@ class Subtract: public Operator {
 	----
 	Variable is a unique Expression (Expr).
 	Variable only has a name and no internal value.
+
+	A Machine variable whose value never has to outlive a transition is made
+	local by the optimizer: it is then a C++ local of that type instead of a member.
+	A cached Variable reads and writes the copy of the member that a looping
+	State keeps in a local while it loops (see _cpp_loop_state).
 	----
 */
 
@@ -210,11 +226,20 @@ class Variable: public Expr {
 		virtual bool is_on_platform();
 		virtual void set_on_platform(bool b);
 
+		virtual bool is_local();
+		virtual std::string get_local_type();
+		virtual void set_local(std::string type);
+
+		virtual bool is_cached();
+		virtual void set_cached(bool b);
+
 		virtual std::string cppCode_cpp();
 
 	private:
 		std::string name;
 		bool on_platform;
+		std::string local_type;
+		bool cached;
 };
 
 /*
@@ -232,6 +257,7 @@ class Stmt: public Node {
 		Stmt();
 		virtual Variable* get_variable();
 		virtual Expr* get_expr();
+		virtual void set_expr(Expr *e);
 
 		virtual Stmt* get_next();
 		virtual bool has_next();
@@ -252,6 +278,13 @@ class Stmt: public Node {
 	Transition contains a series of Stmt objects and optionally an Variable and Expr.
 
 	If the Variable and Expr are not present, this Transition is marked as "exit".
+
+	The optimizer marks a Transition whose guard it folded to a constant as
+	always or never taken. When it fuses a chain of States that only go on
+	to the next one, the actions of those States are kept, in order, in the
+	fused Stmts of the Transition that led into the chain. A guard or actions
+	that many Transitions share get an id (0 when they are not shared), and
+	are translated once, as a member function of the Machine.
 	----
 */
 
@@ -261,8 +294,11 @@ class Transition: public Node {
 		Transition(Expr *expr, Stmt* stmt);
 		Transition();
 		virtual Variable* get_variable();
+		virtual void set_variable(Variable *v);
 		virtual Expr* get_expr();
+		virtual void set_expr(Expr *e);
 		virtual Stmt* get_stmt();
+		virtual void set_stmt(Stmt *s);
 
 		virtual Transition* get_next();
 		virtual bool has_next();
@@ -270,13 +306,31 @@ class Transition: public Node {
 
 		virtual bool is_exit();
 		virtual bool is_empty();
+
+		virtual bool is_always();
+		virtual bool is_never();
+		virtual void set_always(bool b);
+		virtual void set_never(bool b);
+
+		virtual std::vector<Stmt*> get_fused();
+		virtual void set_fused(std::vector<Stmt*> f);
+
+		virtual int get_shared_guard();
+		virtual int get_shared_action();
+		virtual void set_shared_guard(int id);
+		virtual void set_shared_action(int id);
 	private:
 		bool exitKwd;
+		bool always;
+		bool never;
 		Variable* var;
 		Expr* expr;
 		Stmt* stmt;
 		Transition* next;
 		bool empty;
+		std::vector<Stmt*> fused;
+		int shared_guard;
+		int shared_action;
 };
 
 /*
@@ -295,6 +349,7 @@ class State: public Node {
 		~State();
 		virtual Variable* get_variable();
 		virtual Transition* get_transition();
+		virtual void set_transition(Transition *t);
 
 		virtual State* get_next();
 		virtual bool has_next();
@@ -330,6 +385,9 @@ class Type: public Node {
 	----
 	Decl is a subclass of Node. Decl needs a Type and a Variable.
 	The "linked list" magic happens in DeclList, NoDecl and SeqDecl.
+
+	The storage of a Decl is the C++ type of its member. It is the Type,
+	unless the optimizer found that a smaller type holds every value.
 	----
 */
 
@@ -340,12 +398,15 @@ class Decl: public Node {
 		~Decl();
 		Variable* get_variable();
 		Type* get_type();
+		std::string get_storage();
+		void set_storage(std::string s);
 
 		virtual std::string cppCode_h();
 
 	protected:
 		Type* type;
 		Variable* var;
+		std::string storage;
 
 };
 
@@ -439,6 +500,7 @@ class Program: public Node {
 		Platform* get_platform();
 		DeclList* get_decls();
 		State* get_states();
+		void set_states(State *s);
 		
 		int getNumStates();
 		int getNumVarDecls();
@@ -449,6 +511,9 @@ class Program: public Node {
 		void set_variable_origins(Variable *v);
 		void set_decl_origins(Decl *d);
 
+		Options* get_options();
+		void set_options(Options o);
+
 		// --- Code Generation ---
 		virtual std::string cppCode_cpp();
 		virtual std::string cppCode_h();
@@ -456,6 +521,7 @@ class Program: public Node {
 
 	private:
 		std::map<std::string, bool> symbol_table;
+		Options options;
 		Variable* var;
 		Platform* platform;
 		DeclList* decls;
@@ -0,0 +1,201 @@
+/*
+	cffbench
+	Measures the throughput of every compiler phase on generated programs of
+	growing size, see generator.h:
+		scan      Scanner::scan
+		parse     extendTokenList and Parser::parseProgram
+		optimize  optimize(), the analysis and rewrites of a default compile,
+		          on a fresh parse every run that is not timed
+		emit      Program::cppCode_h and Program::cppCode_cpp
+		edit      Document::edit of one digit in the middle of the program, what
+		          `cffc --lsp` does for a keystroke, see document.h
+	Every phase is repeated until it has run for a while, and reported as time
+	per run and as source bytes, tokens and States per second.
+
+	Usage: cffbench [generator options]
+	The generator options (see cffgen) set the shape of the programs,
+	--states sets the largest one; the others have 1/100 and 1/10 of its States.
+*/
+
+#include "scanner.h"
+#include "parser.h"
+#include "extToken.h"
+#include "ast.h"
+#include "translator.h"
+#include "generator.h"
+#include "document.h"
+#include "optimizer.h"
+#include "stats.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+static double now() {
+    chrono::duration<double> d = chrono::steady_clock::now().time_since_epoch();
+    return d.count();
+}
+
+static void free_tokens(Token *t) {
+    while ( t ) {
+        Token *next = t->next;
+        delete t;
+        t = next;
+    }
+}
+
+// the list of ExtTokens ends with endOfFile
+static void free_ext_tokens(ExtToken *t) {
+    while ( t ) {
+        ExtToken *next = t->terminal == endOfFile ? NULL : t->next;
+        delete t;
+        t = next;
+    }
+}
+
+/*
+    Runs a phase until it has taken at least `enough` seconds, returns seconds per run.
+*/
+static const double enough = 0.25;
+
+class Row {
+public:
+    Row(string p, double s, double b, long t, int st) : phase(p), seconds(s), bytes(b), tokens(t), states(st) {}
+    string phase;
+    double seconds;
+    double bytes;
+    long tokens;
+    int states;
+};
+
+static void print(Row r) {
+    cout << "  " << left << setw(8) << r.phase
+         << right << fixed << setprecision(3) << setw(12) << r.seconds * 1000
+         << setprecision(1) << setw(12) << r.bytes / r.seconds / 1e6
+         << setprecision(0) << setw(16) << r.tokens / r.seconds
+         << setw(14) << r.states / r.seconds << endl;
+}
+
+static int bench(GeneratorOptions options) {
+    string source = generate_cff(options);
+    const char *text = source.c_str();
+    Scanner scanner;
+
+    // one run to get the sizes, and to check the program is fine
+    Token *scanned = scanner.scan(text);
+    long tokens = 0;
+    for ( Token *t = scanned; t; t = t->next ) tokens++;
+
+    Parser parser;
+    parser.tokens = extendTokenList(&parser, scanned);
+    parser.currToken = parser.tokens;
+    ParseResult pr;
+    try {
+        pr = parser.parseProgram();
+    } catch (string error) {
+        cout << "The generated program does not parse: " << error << endl;
+        return 3;
+    }
+    free_ext_tokens(parser.tokens);
+    Program *program = (Program *) pr.ast;
+    int states = program->getNumStates();
+
+    cout << options.states << " States: " << source.size() << " bytes, "
+         << tokens << " tokens" << endl;
+
+    int runs;
+    double start;
+
+    runs = 0;
+    start = now();
+    do {
+        free_tokens(scanner.scan(text));
+        runs++;
+    } while ( now() - start < enough );
+    print(Row("scan", ( now() - start ) / runs, source.size(), tokens, states));
+
+    runs = 0;
+    start = now();
+    do {
+        Parser p;
+        p.tokens = extendTokenList(&p, scanned);
+        p.currToken = p.tokens;
+        delete p.parseProgram().ast;
+        free_ext_tokens(p.tokens);
+        runs++;
+    } while ( now() - start < enough );
+    print(Row("parse", ( now() - start ) / runs, source.size(), tokens, states));
+
+    Options recursive;
+    double optimizing = 0;
+    runs = 0;
+    do {
+        Parser p;
+        p.tokens = extendTokenList(&p, scanned);
+        p.currToken = p.tokens;
+        Program *fresh = (Program *) p.parseProgram().ast;
+        free_ext_tokens(p.tokens);
+        fresh->set_options(recursive);
+
+        Stats unused;
+        start = now();
+        optimize(fresh, &unused);
+        optimizing += now() - start;
+        delete fresh;
+        runs++;
+    } while ( optimizing < enough );
+    print(Row("optimize", optimizing / runs, source.size(), tokens, states));
+
+    program->set_options(recursive);
+    runs = 0;
+    start = now();
+    do {
+        program->cppCode_h();
+        program->cppCode_cpp();
+        runs++;
+    } while ( now() - start < enough );
+    print(Row("emit", ( now() - start ) / runs, source.size(), tokens, states));
+
+    Document document(&scanner);
+    document.open(source);
+    int at = source.find_first_of("0123456789", source.size() / 2);
+    string digits[] = { source.substr(at, 1), "7" };
+    runs = 0;
+    start = now();
+    do {
+        document.edit(at, at + 1, digits[++runs % 2]);
+    } while ( now() - start < enough );
+    print(Row("edit", ( now() - start ) / runs, source.size(), tokens, states));
+
+    delete program;
+    free_tokens(scanned);
+    return 0;
+}
+
+int main ( int argc, char **argv ) {
+
+    GeneratorOptions options;
+    if ( ! options.parse(argc, argv) ) {
+        cout << options.errors << endl << generator_usage();
+        return 1;
+    }
+
+    cout << "  " << left << setw(8) << "phase"
+         << right << setw(12) << "ms/run"
+         << setw(12) << "MB/s"
+         << setw(16) << "tokens/s"
+         << setw(14) << "States/s" << endl;
+
+    int largest = options.states;
+    int sizes[] = { largest / 100, largest / 10, largest };
+    for ( int k = 0; k < 3; k++ ) {
+        if ( sizes[k] < 1 ) continue;
+        options.states = sizes[k];
+        int error = bench(options);
+        if ( error ) return error;
+    }
+    return 0;
+}
@@ -11,58 +11,113 @@
 
 */
 
-#include "parser.h"
 #include "readInput.h"
-#include "ast.h"
+#include "options.h"
+#include "stats.h"
+#include "compiler.h"
+#include "server.h"
+#include "lsp.h"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <vector>
+#include <stdio.h>
 
 using namespace std;
 
+/*
+    write_file writes text to path, unless the file already holds exactly that,
+    so make only rebuilds what a compile really changed.
+*/
+void write_file ( string path, string text ) {
+    ifstream in ( path.c_str(), ios::binary );
+    if ( in ) {
+        ostringstream old;
+        old << in.rdbuf();
+        if ( old.str() == text ) return;
+    }
+    ofstream out ( path.c_str(), ios::binary );
+    out << text;
+}
+
+/*
+    remove_stale_parts removes the Machine_k.cpp files that an earlier
+    cffc --split with more parts left behind, and Machine.mk when this
+    compile wrote no parts, so make split never links a part of another
+    Machine. The parts are always Machine_1.cpp up to Machine_N.cpp.
+*/
+void remove_stale_parts ( const vector< pair<string, string> > &files ) {
+    int parts = 0;
+    for ( unsigned int k = 0; k < files.size(); k++ ) {
+        if ( files[k].first.find ( "/Machine_" ) != string::npos ) parts++;
+    }
+    if ( parts == 0 ) remove ( "../cffc/Machine.mk" );
+    for ( int k = parts + 1; ; k++ ) {
+        ostringstream part;
+        part << "../cffc/Machine_" << k << ".cpp";
+        if ( remove ( part.str().c_str() ) != 0 ) break;
+    }
+}
+
 int main ( int argc, char **argv ) {
 
-    if ( argc < 2 ) {
-        cout << "Usage: cffc <filename>" << endl;
+    Options options;
+    if ( ! options.parse(argc, argv) ) {
+        cout << options.errors << endl << options_usage();
         return 1;
     }
 
-    char *filename = argv[1];
-    string filepath = "../samples/" + string(filename);
+    if ( ! options.serve.empty() ) {
+        return serve ( options.serve );
+    }
+
+    if ( options.lsp ) {
+        return lsp ( cin, cout );
+    }
+
+    Stats stats;
+    bool keep_stats = ! options.stats.empty();
+
+    string filepath = "../samples/" + options.filename;
+    stats.begin("read");
     char *text = readInputFromFile ( filepath.c_str() ) ;
+    stats.end();
     if ( ! text ) {
         cout << "File \"" << filepath << "\" not found." << endl;
         return 2;
     }
 
-    Parser *p = new Parser();
-    ParseResult pr = p->parse(text);
-    delete p;
-
-    if ( ! pr.ok ) {
-        cout << "Syntax errors in CFishFish program: " << endl
-             << pr.errors << endl;
-        return 3;
+    // --stats measures this process, so it always compiles here
+    Compilation c;
+    bool compiled = false;
+    if ( ! options.connect.empty() && ! keep_stats ) {
+        vector<string> args;
+        for ( int k = 1; k < argc; k++ ) {
+            if ( string(argv[k]).substr(0, 10) != "--connect=" ) args.push_back ( argv[k] );
+        }
+        compiled = compile_remote ( options.connect, args, text, &c );
+        if ( ! compiled ) cerr << "Warning: no compile server on \"" << options.connect << "\", compiling here." << endl;
+    }
+    if ( ! compiled ) {
+        c = compile ( options, text, &stats, NULL );
     }
 
+    cout << c.out;
+    cerr << c.err;
+    if ( c.status != 0 ) return c.status;
 
-    Program *program = dynamic_cast<Program *>(pr.ast);
-
-    if ( ! program ) {
-        cout << "Internal compiler error, failed to create AST." << endl;
-        return 4;
+    stats.begin("write");
+    for ( unsigned int k = 0; k < c.files.size(); k++ ) {
+        write_file ( c.files[k].first, c.files[k].second );
     }
+    remove_stale_parts ( c.files );
+    stats.end();
 
-    ofstream machine_h;
-    machine_h.open ( "../cffc/Machine.h" );
-    machine_h << program->cppCode_h();
-    machine_h.close();
-
-    ofstream machine_cpp;
-    machine_cpp.open ( "../cffc/Machine.cpp" );
-    machine_cpp << program->cppCode_cpp();
-    machine_cpp.close();
+    if ( keep_stats ) {
+        if ( options.stats == "json" ) cout << stats.json();
+        else cout << stats.text();
+    }
 
-    delete program;
     return 0;
 }
@@ -0,0 +1,22 @@
+/*
+	cffgen
+	Writes a synthetic CFF program to stdout, see generator.h.
+*/
+
+#include "generator.h"
+
+#include <iostream>
+
+using namespace std;
+
+int main ( int argc, char **argv ) {
+
+    GeneratorOptions options;
+    if ( ! options.parse(argc, argv) ) {
+        cout << options.errors << endl << generator_usage();
+        return 1;
+    }
+
+    cout << generate_cff(options);
+    return 0;
+}
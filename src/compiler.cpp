@@ -0,0 +1,133 @@
+#include "compiler.h"
+#include "parser.h"
+#include "ast.h"
+#include "translator.h"
+#include "optimizer.h"
+#include "evaluator.h"
+
+#include <sstream>
+
+using namespace std;
+
+Compilation::Compilation() {
+    this->status = 0;
+}
+
+Compilation compile ( Options options, const char *text, Stats *stats, Scanner *scanner ) {
+
+    Compilation c;
+    ostringstream out, err;
+
+    Stats unused;
+    if ( ! stats ) stats = &unused;
+    bool keep_stats = ! options.stats.empty();
+
+    Parser *p = new Parser();
+    if ( keep_stats ) p->stats = stats;
+    p->scanner = scanner;
+    ParseResult pr = p->parse(text);
+    delete p;
+
+    if ( ! pr.ok ) {
+        out << "Syntax errors in CFishFish program: " << endl
+            << pr.errors << endl;
+        c.out = out.str();
+        c.status = 3;
+        return c;
+    }
+
+
+    Program *program = dynamic_cast<Program *>(pr.ast);
+
+    if ( ! program ) {
+        out << "Internal compiler error, failed to create AST." << endl;
+        c.out = out.str();
+        c.status = 4;
+        return c;
+    }
+
+    stats->begin("check");
+    program->set_options(options);
+
+    string error("");
+    if ( options.backend == "lockstep" ) {
+        error = _lanes_check(program);
+    }
+    if ( options.backend == "simulation" ) {
+        error = _simulation_check(program);
+    }
+    if ( options.backend == "coroutine" ) {
+        error = _coroutine_check(program);
+    }
+    stats->end();
+
+    if ( ! error.empty() ) {
+        out << error << endl;
+        c.out = out.str();
+        c.status = 5;
+        delete program;
+        return c;
+    }
+
+    if ( options.optimize ) {
+        stats->begin("optimize");
+        err << optimize(program, stats);
+        stats->end();
+    }
+
+    stats->begin("header");
+    string code_h = program->cppCode_h();
+    stats->end();
+
+    // a Machine that takes no input prints the same on every run
+    string printed("");
+    bool evaluated = false;
+    if ( options.optimize && options.evaluate > 0 && options.backend == "recursive" && ! options.trace && ! options.profile ) {
+        stats->begin("evaluate");
+        string reason("");
+        evaluated = evaluate(program, options.evaluate, &printed, &reason);
+        if ( ! reason.empty() ) err << "Warning: " << reason << endl;
+        stats->end();
+    }
+
+    stats->begin("cpp");
+    string code_cpp("");
+    vector<string> parts;
+    if ( evaluated ) {
+        code_cpp = _cpp_evaluated(program, printed);
+    } else if ( options.split > 0 && ! _batches(program) ) {
+        code_cpp = _cpp_split_main(program);
+        parts = _cpp_split_parts(program, options.split);
+    } else {
+        code_cpp = program->cppCode_cpp();
+    }
+    stats->end();
+
+    c.files.push_back ( make_pair ( string("../cffc/Machine.h"), code_h ) );
+    c.files.push_back ( make_pair ( string("../cffc/Machine.cpp"), code_cpp ) );
+    for ( unsigned int k = 0; k < parts.size(); k++ ) {
+        c.files.push_back ( make_pair ( "../cffc/Machine_" + _int_to_string(k + 1) + ".cpp", parts[k] ) );
+    }
+    if ( ! parts.empty() ) {
+        c.files.push_back ( make_pair ( string("../cffc/Machine.mk"), _split_makefile(program, parts.size()) ) );
+    }
+
+    if ( keep_stats ) {
+        long transitions = 0;
+        for ( State *s = program->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+            for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) transitions++;
+        }
+        stats->count("nodes", Node::created);
+        stats->count("states", program->getNumStates());
+        stats->count("transitions", transitions);
+        long bytes = code_h.size() + code_cpp.size();
+        for ( unsigned int k = 0; k < parts.size(); k++ ) bytes += parts[k].size();
+        stats->count("output_bytes", bytes);
+    }
+
+    delete program;
+
+    c.out = out.str();
+    c.err = err.str();
+    return c;
+}
@@ -0,0 +1,50 @@
+/*
+	compiler.h
+	compile is one run of cffc on the text of a CFF program, from parsing to
+	the generated sources. It does not touch the file system: what cffc
+	prints and the files it writes are handed back, so that cffc and the
+	compile server (server.h) can both run it.
+*/
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "options.h"
+#include "scanner.h"
+#include "stats.h"
+
+class Compilation {
+	public:
+		Compilation();
+
+		/*
+			status is the exit status of cffc: 0 when the Machine was
+			generated, 3 for syntax errors, 4 for an internal error and
+			5 when the backend can not take the Machine.
+		*/
+		int status;
+
+		/*
+			out and err are what cffc prints on stdout and stderr.
+		*/
+		std::string out;
+		std::string err;
+
+		/*
+			files are the paths cffc writes, relative to src, and their text.
+		*/
+		std::vector< std::pair<std::string, std::string> > files;
+};
+
+/*
+	compile translates text as options say. stats, which may be NULL, times
+	the phases and counts what they did. scanner, which may be NULL, is the
+	Scanner to parse with, see Parser::scanner.
+*/
+Compilation compile(Options options, const char *text, Stats *stats, Scanner *scanner);
+
+#endif /* COMPILER_H */
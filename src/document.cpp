@@ -0,0 +1,317 @@
+#include "document.h"
+#include "parser.h"
+
+#include <string.h>
+#include <algorithm>
+
+Document::Document(Scanner *scanner) {
+	this->scanner = scanner;
+	this->scanned = 0;
+	this->parsed = 0;
+	this->open("");
+}
+
+Document::~Document() {
+	for ( unsigned int k = 0; k < blocks.size(); k++ ) delete blocks[k].ast;
+}
+
+void Document::open(std::string text) {
+	this->text = text;
+	int removed = tokens.size();
+	tokens.clear();
+	scan(0, 0, 0, this->text.size());
+	find_lines();
+	split(0, tokens.size(), removed);
+}
+
+void Document::edit(int start, int end, std::string text) {
+	int size = this->text.size();
+	if ( start < 0 ) start = 0;
+	if ( end > size ) end = size;
+	if ( start > end ) start = end;
+	int delta = text.size() - ( end - start );
+
+	// the first token that ends at or after the edit
+	unsigned int touched = 0, after = tokens.size();
+	while ( touched < after ) {
+		unsigned int middle = ( touched + after ) / 2;
+		if ( tokens[middle].start + tokens[middle].length < start ) touched = middle + 1;
+		else after = middle;
+	}
+
+	// the tokens right before it may run on into it, "12." and "5" make "12.5"
+	int first = touched > 0 ? touched - 1 : 0;
+	while ( first > 0 && tokens[first - 1].start + tokens[first - 1].length == tokens[first].start ) first--;
+
+	// and a quote, `*/` or newline it brings may close one opened before
+	const char *closers = "\"'*/\n\r";
+	if ( text.find_first_of(closers) != std::string::npos
+	  || ( start > 0 && strchr(closers, this->text[start - 1]) )
+	  || ( end < size && strchr(closers, this->text[end]) ) ) {
+		first = reopened(first);
+	}
+	int from = touched > 0 ? tokens[first].start : 0;
+
+	this->text.replace(start, end - start, text);
+	int removed = tokens.size();
+	scan(from, first, delta, start + text.size());
+	move_lines(start, end, text);
+	int added = scanned;
+	removed = removed - ( tokens.size() - added );
+	split(first, added, removed);
+}
+
+/*
+	left_open is true for a token that is only there because what would close
+	it is missing: a quote without a second one, which takes the rest of the
+	text for a string, or the slash of a comment that does not end.
+*/
+bool Document::left_open(int k) {
+	if ( tokens[k].terminal == lexicalError ) {
+		return text[tokens[k].start] == '"' || text[tokens[k].start] == '\'';
+	}
+	return tokens[k].terminal == forwardSlash && k + 1 < (int) tokens.size()
+		&& tokens[k + 1].start == tokens[k].start + 1
+		&& ( tokens[k + 1].terminal == star || tokens[k + 1].terminal == forwardSlash );
+}
+
+/*
+	token_at returns the index of the token that starts at offset, or -1.
+*/
+int Document::token_at(int offset) {
+	unsigned int low = 0, high = tokens.size();
+	while ( low < high ) {
+		unsigned int middle = ( low + high ) / 2;
+		if ( tokens[middle].start < offset ) low = middle + 1;
+		else high = middle;
+	}
+	return ( low < tokens.size() && tokens[low].start == offset ) ? (int) low : -1;
+}
+
+/*
+	reopened returns the first token before token first that is left open,
+	or first when there is none. A quote left open has no quote after it,
+	so it can only be the last quote before; a `//` left open has no newline
+	after it, so it can only be on the last line. Only the start of a block
+	comment is looked for in all the text before, and that with memmem.
+*/
+int Document::reopened(int first) {
+	const char *chars = text.c_str();
+	int before = first < (int) tokens.size() ? tokens[first].start : text.size();
+	int found = first;
+
+	const char *quotes = "\"'";
+	for ( int q = 0; q < 2; q++ ) {
+		const char *last = (const char *) memrchr(chars, quotes[q], before);
+		int k = last ? token_at(last - chars) : -1;
+		if ( k >= 0 && k < found && left_open(k) ) found = k;
+	}
+
+	const char *line = (const char *) memrchr(chars, '\n', before);
+	const char *openers[] = { "/*", "//" };
+	for ( int o = 0; o < 2; o++ ) {
+		const char *c = o == 0 || ! line ? chars : line;
+		while ( ( c = (const char *) memmem(c, before - ( c - chars ), openers[o], 2) ) != NULL ) {
+			int k = token_at(c - chars);
+			if ( k >= 0 && left_open(k) ) {
+				if ( k < found ) found = k;
+				break;
+			}
+			c++;
+		}
+	}
+	return found;
+}
+
+/*
+	scan lexes the text from offset from and puts what it finds in place of
+	the tokens from index first on. Once it is at or past boundary, the end
+	of what changed, a token that starts where an old one did, delta later,
+	is the start of the old tokens it keeps: from there on the text is the
+	same, so it would scan the same tokens again. Those are moved by delta.
+*/
+void Document::scan(int from, int first, int delta, int boundary) {
+	const char *chars = text.c_str();
+	int length = text.size();
+	std::vector<Lexeme> fresh;
+
+	unsigned int old = first;
+	int at = from;
+	while ( true ) {
+		at += scanner->_consume(chars + at, length - at);
+		if ( at >= boundary ) {
+			while ( old < tokens.size() && tokens[old].start + delta < at ) old++;
+			if ( old < tokens.size() && tokens[old].start + delta == at ) break;
+		}
+		if ( at >= length ) {
+			old = tokens.size();
+			break;
+		}
+		Lexeme l;
+		l.start = at;
+		l.length = scanner->match(chars + at, length - at, &l.terminal);
+		fresh.push_back(l);
+		at += l.length;
+	}
+
+	// plain pointers, this is the one loop over all the tokens after the edit
+	Lexeme *moving = tokens.data() + old, *last = tokens.data() + tokens.size();
+	for ( ; moving < last; moving++ ) moving->start += delta;
+	tokens.erase(tokens.begin() + first, tokens.begin() + old);
+	tokens.insert(tokens.begin() + first, fresh.begin(), fresh.end());
+	scanned = fresh.size();
+}
+
+/*
+	starts_state is true for the token a State starts with: `initial`, or
+	`state` when it does not follow `initial`.
+*/
+bool Document::starts_state(int k) {
+	tokenType t = tokens[k].terminal;
+	return t == initialKwd || ( t == stateKwd && ( k == 0 || tokens[k - 1].terminal != initialKwd ) );
+}
+
+/*
+	split cuts the tokens into blocks again after added tokens took the place
+	of removed ones at index changed. The blocks before, whose tokens and the
+	token after them, the one their errors can be about, are all old, and the
+	blocks after, which start with an old token, keep their parse; only the
+	blocks in between are cut again and parsed.
+*/
+void Document::split(int changed, int added, int removed) {
+	int moved = added - removed;
+
+	unsigned int before = 0, high = blocks.size();
+	while ( before < high ) {
+		unsigned int middle = ( before + high ) / 2;
+		if ( blocks[middle].first + blocks[middle].count < changed ) before = middle + 1;
+		else high = middle;
+	}
+	unsigned int after = before > 0 ? before : 1;
+	high = blocks.size();
+	while ( after < high ) {
+		unsigned int middle = ( after + high ) / 2;
+		if ( blocks[middle].first < changed + removed ) after = middle + 1;
+		else high = middle;
+	}
+	if ( after > blocks.size() ) after = blocks.size();
+	while ( after < blocks.size() && ! starts_state(blocks[after].first + moved) ) after++;
+
+	int from = before > 0 ? blocks[before].first : 0;
+	int to = after < blocks.size() ? blocks[after].first + moved : tokens.size();
+
+	std::vector<Block> cut;
+	if ( before == 0 ) {
+		Block header;
+		header.first = 0;
+		cut.push_back(header);
+	}
+	for ( int k = from; k < to; k++ ) {
+		if ( starts_state(k) ) {
+			Block state;
+			state.first = k;
+			cut.push_back(state);
+		}
+	}
+	for ( unsigned int b = 0; b < cut.size(); b++ ) {
+		cut[b].count = ( b + 1 < cut.size() ? cut[b + 1].first : to ) - cut[b].first;
+	}
+
+	for ( unsigned int b = before; b < after; b++ ) delete blocks[b].ast;
+	for ( unsigned int b = after; b < blocks.size(); b++ ) blocks[b].first += moved;
+	blocks.erase(blocks.begin() + before, blocks.begin() + after);
+	blocks.insert(blocks.begin() + before, cut.begin(), cut.end());
+
+	parsed = 0;
+	for ( unsigned int b = before; b < before + cut.size(); b++ ) parse(&blocks[b]);
+}
+
+void Document::parse(Block *block) {
+	int last = block->first + block->count;
+	Token *list = new Token("", endOfFile, NULL);
+	if ( last < (int) tokens.size() ) {
+		list = new Token(text.substr(tokens[last].start, tokens[last].length).c_str(), tokens[last].terminal, list);
+	}
+	for ( int k = last - 1; k >= block->first; k-- ) {
+		list = new Token(text.substr(tokens[k].start, tokens[k].length).c_str(), tokens[k].terminal, list);
+	}
+
+	Parser p;
+	int failed_at = 0;
+	ParseResult pr = p.parseBlock(list, block == &blocks[0] ? "header" : "state", &failed_at);
+	block->ast = pr.ast;
+	block->error = pr.ok ? "" : pr.errors;
+	block->failed_at = failed_at;
+	parsed++;
+
+	while ( list != NULL ) {
+		Token *next = list->next;
+		delete list;
+		list = next;
+	}
+}
+
+std::vector<Diagnostic> Document::diagnostics() {
+	std::vector<Diagnostic> found;
+	for ( unsigned int b = 0; b < blocks.size(); b++ ) {
+		if ( blocks[b].error.empty() ) continue;
+		Diagnostic d;
+		unsigned int k = blocks[b].first + blocks[b].failed_at;
+		if ( k < tokens.size() ) {
+			d.start = tokens[k].start;
+			d.end = tokens[k].start + tokens[k].length;
+		} else {
+			d.start = d.end = text.size();
+		}
+		d.message = blocks[b].error;
+		found.push_back(d);
+	}
+	return found;
+}
+
+/*
+	move_lines updates the line table for the characters from start up to
+	end that text took the place of.
+*/
+void Document::move_lines(int start, int end, std::string text) {
+	std::vector<int>::iterator gone = std::upper_bound(lines.begin(), lines.end(), start);
+	std::vector<int>::iterator kept = std::upper_bound(gone, lines.end(), end);
+	int delta = text.size() - ( end - start );
+	for ( int *l = lines.data() + ( kept - lines.begin() ), *last = lines.data() + lines.size(); l < last; l++ ) *l += delta;
+
+	std::vector<int> fresh;
+	for ( unsigned int k = 0; k < text.size(); k++ ) {
+		if ( text[k] == '\n' ) fresh.push_back(start + k + 1);
+	}
+	gone = lines.erase(gone, kept);
+	lines.insert(gone, fresh.begin(), fresh.end());
+}
+
+void Document::find_lines() {
+	lines.clear();
+	lines.push_back(0);
+	const char *chars = text.c_str();
+	const char *end = chars + text.size();
+	for ( const char *c = chars; ( c = (const char *) memchr(c, '\n', end - c) ) != NULL; c++ ) {
+		lines.push_back(c - chars + 1);
+	}
+}
+
+int Document::offset(int line, int column) {
+	if ( line < 0 ) return 0;
+	if ( line >= (int) lines.size() ) return text.size();
+	int end = line + 1 < (int) lines.size() ? lines[line + 1] - 1 : text.size();
+	int at = lines[line] + ( column < 0 ? 0 : column );
+	return at < end ? at : end;
+}
+
+void Document::position(int offset, int *line, int *column) {
+	unsigned int low = 0, high = lines.size();
+	while ( high - low > 1 ) {
+		unsigned int middle = ( low + high ) / 2;
+		if ( lines[middle] <= offset ) low = middle;
+		else high = middle;
+	}
+	*line = low;
+	*column = offset - lines[low];
+}
@@ -0,0 +1,120 @@
+/*
+	document.h
+	Document is a CFF program that is open in an editor, see lsp.h. It keeps
+	the text, its tokens and a parse of each of its blocks: the header, that
+	is the name, platform and declarations, and then every State.
+
+	An edit re-scans from the token before it only until the tokens fall in
+	step with the old ones again, and reparses only the blocks whose tokens
+	changed. Every other block keeps its AST and its errors. Because the
+	blocks are parsed on their own, an error in one State does not hide the
+	errors in the ones after it.
+
+	Only the line table and the token offsets after the edit are updated
+	for the whole text, so an edit costs about as much in a program of
+	thousands of States as in one of ten.
+*/
+
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include <string>
+#include <vector>
+
+#include "scanner.h"
+#include "ast.h"
+
+/*
+	Lexeme is a token, kept as where it is in the text.
+*/
+class Lexeme {
+	public:
+		tokenType terminal;
+		int start;
+		int length;
+};
+
+/*
+	Block is the header or one State: its first token, which for a State is
+	`initial` or `state`, and the number of tokens it has. ast is the Program
+	without States that the header parses to, or the State, and NULL when
+	the block has a syntax error; error is the message parse gives for it
+	and failed_at the index of the token it is about.
+*/
+class Block {
+	public:
+		int first;
+		int count;
+		Node *ast;
+		std::string error;
+		int failed_at;
+};
+
+/*
+	Diagnostic is a syntax error over the characters from start to end.
+*/
+class Diagnostic {
+	public:
+		int start;
+		int end;
+		std::string message;
+};
+
+class Document {
+	public:
+		/*
+			A Document scans with scanner, which it does not own.
+		*/
+		Document(Scanner *scanner);
+		~Document();
+
+		/*
+			open takes the whole text and scans and parses all of it.
+		*/
+		void open(std::string text);
+
+		/*
+			edit replaces the characters from start up to end by text.
+		*/
+		void edit(int start, int end, std::string text);
+
+		std::vector<Diagnostic> diagnostics();
+
+		/*
+			offset and position convert between character offsets and lines
+			and columns, both counted from 0. Both clamp to the text.
+		*/
+		int offset(int line, int column);
+		void position(int offset, int *line, int *column);
+
+		std::string text;
+		std::vector<Lexeme> tokens;
+		std::vector<Block> blocks;
+
+		/*
+			lines holds the offset every line starts at.
+		*/
+		std::vector<int> lines;
+
+		/*
+			What the last open or edit did: the tokens it scanned and the
+			blocks it parsed.
+		*/
+		int scanned;
+		int parsed;
+
+	private:
+		Scanner *scanner;
+
+		void scan(int from, int first, int delta, int boundary);
+		bool left_open(int k);
+		int reopened(int first);
+		int token_at(int offset);
+		bool starts_state(int k);
+		void split(int changed, int added, int removed);
+		void parse(Block *block);
+		void find_lines();
+		void move_lines(int start, int end, std::string text);
+};
+
+#endif /* DOCUMENT_H */
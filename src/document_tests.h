@@ -0,0 +1,165 @@
+#include <cxxtest/TestSuite.h>
+
+#include "document.h"
+#include "parser.h"
+#include "readInput.h"
+
+#include <string>
+
+using namespace std ;
+
+class DocumentTestSuite : public CxxTest::TestSuite
+{
+public:
+
+    Scanner scanner ;
+
+    // The tokens, blocks and errors of d are those of opening its text afresh.
+    void same_as_opened ( Document &d ) {
+        Document fresh ( &scanner ) ;
+        fresh.open ( d.text ) ;
+        TS_ASSERT_EQUALS ( d.tokens.size(), fresh.tokens.size() ) ;
+        for ( unsigned int k = 0; k < d.tokens.size() && k < fresh.tokens.size(); k++ ) {
+            TS_ASSERT_EQUALS ( d.tokens[k].terminal, fresh.tokens[k].terminal ) ;
+            TS_ASSERT_EQUALS ( d.tokens[k].start, fresh.tokens[k].start ) ;
+            TS_ASSERT_EQUALS ( d.tokens[k].length, fresh.tokens[k].length ) ;
+        }
+        TS_ASSERT_EQUALS ( d.blocks.size(), fresh.blocks.size() ) ;
+        for ( unsigned int b = 0; b < d.blocks.size() && b < fresh.blocks.size(); b++ ) {
+            TS_ASSERT_EQUALS ( d.blocks[b].first, fresh.blocks[b].first ) ;
+            TS_ASSERT_EQUALS ( d.blocks[b].count, fresh.blocks[b].count ) ;
+            TS_ASSERT_EQUALS ( d.blocks[b].error, fresh.blocks[b].error ) ;
+        }
+    }
+
+    void test_open_parses_every_state ( ) {
+        Document d ( &scanner ) ;
+        d.open ( readInputFromFile ( "../samples/box.cff" ) ) ;
+        TS_ASSERT_EQUALS ( d.blocks.size(), 6u ) ;
+        TS_ASSERT_EQUALS ( d.parsed, 6 ) ;
+        TS_ASSERT ( dynamic_cast<Program *> ( d.blocks[0].ast ) ) ;
+        TS_ASSERT ( dynamic_cast<State *> ( d.blocks[1].ast ) ) ;
+        TS_ASSERT ( d.diagnostics().empty() ) ;
+    }
+
+    void test_edit_reparses_only_its_state ( ) {
+        Document d ( &scanner ) ;
+        d.open ( readInputFromFile ( "../samples/box.cff" ) ) ;
+        vector<Node *> before ;
+        for ( unsigned int b = 0; b < d.blocks.size(); b++ ) before.push_back ( d.blocks[b].ast ) ;
+
+        int at = d.text.find ( "xPos >= 100" ) + 8 ;
+        d.edit ( at, at + 3, "250" ) ;
+        TS_ASSERT_EQUALS ( d.scanned, 2 ) ;
+        TS_ASSERT_EQUALS ( d.parsed, 1 ) ;
+        for ( unsigned int b = 0; b < d.blocks.size(); b++ ) {
+            if ( b == 3 ) {
+                TS_ASSERT_DIFFERS ( d.blocks[b].ast, before[b] ) ;
+            } else {
+                TS_ASSERT_EQUALS ( d.blocks[b].ast, before[b] ) ;
+            }
+        }
+        same_as_opened ( d ) ;
+    }
+
+    void test_an_error_in_every_state ( ) {
+        Document d ( &scanner ) ;
+        d.open ( "name: M ; platform: IntegerComputer ;\n"
+                 "initial state: A { goto B when true performing { } ; }\n"
+                 "state: B { goto A when performing { } ; }\n"
+                 "state: C { exit when true performing { } }\n" ) ;
+        vector<Diagnostic> found = d.diagnostics() ;
+        TS_ASSERT_EQUALS ( found.size(), 2u ) ;
+
+        // the first is what a parse of the whole program says
+        Parser p ;
+        ParseResult pr = p.parse ( d.text.c_str() ) ;
+        TS_ASSERT_EQUALS ( found[0].message, pr.errors ) ;
+
+        int line, column ;
+        d.position ( found[0].start, &line, &column ) ;
+        TS_ASSERT_EQUALS ( line, 2 ) ;
+        TS_ASSERT_EQUALS ( column, 23 ) ;
+        d.position ( found[1].start, &line, &column ) ;
+        TS_ASSERT_EQUALS ( line, 3 ) ;
+        TS_ASSERT_EQUALS ( column, 41 ) ;
+
+        // fixing one leaves the other
+        d.edit ( d.offset ( 3, 41 ), d.offset ( 3, 41 ), " ;" ) ;
+        TS_ASSERT_EQUALS ( d.parsed, 1 ) ;
+        TS_ASSERT_EQUALS ( d.diagnostics().size(), 1u ) ;
+        same_as_opened ( d ) ;
+    }
+
+    void test_tokens_that_run_on ( ) {
+        Document d ( &scanner ) ;
+        d.open ( "name: M ; platform: IntegerComputer ;\n"
+                 "initial state: A { exit when 12. performing { } ; }\n" ) ;
+        int at = d.text.find ( "12." ) + 3 ;
+        d.edit ( at, at, "5" ) ;
+        same_as_opened ( d ) ;
+        TS_ASSERT ( d.diagnostics().empty() ) ;
+
+        at = d.text.find ( "exit" ) + 4 ;
+        d.edit ( at, at, "s" ) ;
+        same_as_opened ( d ) ;
+        TS_ASSERT_EQUALS ( d.diagnostics().size(), 1u ) ;
+    }
+
+    void test_comments_and_strings_opened_before_the_edit ( ) {
+        Document d ( &scanner ) ;
+        d.open ( readInputFromFile ( "../samples/box.cff" ) ) ;
+
+        // opening a comment takes in the States after it ...
+        int at = d.text.find ( "state: MoveEast" ) ;
+        d.edit ( at, at, "/* " ) ;
+        same_as_opened ( d ) ;
+        TS_ASSERT_EQUALS ( d.diagnostics().size(), 1u ) ;
+
+        // ... until it is closed far below
+        at = d.text.find ( "state: MoveWest" ) ;
+        d.edit ( at, at, " */ " ) ;
+        same_as_opened ( d ) ;
+        TS_ASSERT_EQUALS ( d.blocks.size(), 4u ) ;
+        TS_ASSERT ( d.diagnostics().empty() ) ;
+
+        // and a quote can be closed anywhere after it
+        at = d.text.find ( "int timesAround" ) ;
+        d.edit ( at, at, "\"" ) ;
+        same_as_opened ( d ) ;
+        d.edit ( d.text.size(), d.text.size(), "\"" ) ;
+        same_as_opened ( d ) ;
+    }
+
+    void test_many_edits_agree_with_open ( ) {
+        const char *pieces[] = { "\"", "'", "/*", "*/", "//", "\n", " ", "state", "initial", "}", "{",
+                                 "1", ".", "x", ":=", ";", "exit when true performing { } ;", "" } ;
+        Document d ( &scanner ) ;
+        d.open ( readInputFromFile ( "../samples/box.cff" ) ) ;
+        unsigned int seed = 1 ;
+        for ( int k = 0; k < 300; k++ ) {
+            seed = seed * 1103515245 + 12345 ;
+            int start = ( seed >> 8 ) % ( d.text.size() + 1 ) ;
+            int end = start + ( seed >> 4 ) % 4 ;
+            d.edit ( start, end, pieces[ ( seed >> 12 ) % 18 ] ) ;
+            same_as_opened ( d ) ;
+        }
+    }
+
+    void test_offset_and_position ( ) {
+        Document d ( &scanner ) ;
+        d.open ( "ab\ncde\n\nf" ) ;
+        TS_ASSERT_EQUALS ( d.offset ( 1, 2 ), 5 ) ;
+        TS_ASSERT_EQUALS ( d.offset ( 1, 10 ), 6 ) ;
+        TS_ASSERT_EQUALS ( d.offset ( 3, 0 ), 8 ) ;
+        TS_ASSERT_EQUALS ( d.offset ( 9, 0 ), 9 ) ;
+        int line, column ;
+        d.position ( 7, &line, &column ) ;
+        TS_ASSERT_EQUALS ( line, 2 ) ;
+        TS_ASSERT_EQUALS ( column, 0 ) ;
+        d.position ( 9, &line, &column ) ;
+        TS_ASSERT_EQUALS ( line, 3 ) ;
+        TS_ASSERT_EQUALS ( column, 1 ) ;
+    }
+
+} ;
@@ -0,0 +1,352 @@
+#include "evaluator.h"
+#include "translator.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <map>
+#include <sstream>
+
+/*
+	----
+	Value is a value of the running Machine.
+	type is the C++ type it has in the Machine: "int", "char", "bool",
+	"float", "double", "string" or "literal" (a string constant, which is a
+	const char * in C++). A float is kept in f, rounded to a float.
+	----
+*/
+
+class Value {
+	public:
+		Value() : type(""), i(0), f(0.0) {}
+
+		std::string type;
+		long long i;
+		double f;
+		std::string s;
+
+		bool is_floating() {
+			return type == "float" || type == "double";
+		}
+		bool is_text() {
+			return type == "string" || type == "literal";
+		}
+		double as_double() {
+			return is_floating() ? f : (double) i;
+		}
+};
+
+typedef std::map<std::string, Value> Values;
+
+/*
+	----
+	Evaluation.
+	Whatever the evaluator can not do exactly like the Machine is thrown as
+	the reason, like the Parser throws its errors.
+	----
+*/
+
+class Evaluation {
+	public:
+		Evaluation(Program *p);
+
+		// the Machine variables, the platform fields and the locals of a transition
+		Values members;
+		Values platform;
+		Values locals;
+		std::map<std::string, std::string> types;
+
+		std::string name;
+		std::ostringstream out;
+
+		Value eval(Expr *e);
+		void assign(Stmt *st);
+		void next_state();
+
+	private:
+		Value constant(Constant *c);
+		Value variable(Variable *v);
+		Value arithmetic(std::string op, Value l, Value r);
+		bool compare(std::string op, Value l, Value r);
+		Value convert(Value v, std::string type, std::string name);
+};
+
+Evaluation::Evaluation(Program *p) {
+	this->name = p->get_platform()->get_variable()->get_name();
+
+	PlatformTraits traits = _platform_traits(this->name);
+	std::map<std::string, std::string>::iterator f;
+	for ( f = traits.fields.begin(); f != traits.fields.end(); f++ ) {
+		this->types[f->first] = ( f->second == "std::string" ? "string" : f->second );
+	}
+	// IntegerComputer starts with output 0, the robot nowhere in particular
+	if ( this->name == "IntegerComputer" ) {
+		Value zero;
+		zero.type = "int";
+		this->platform["output"] = zero;
+	}
+
+	DeclList *d = p->get_decls();
+	while ( is_node_type<SeqDecl>(d) ) {
+		Decl *decl = ((SeqDecl *)d)->get_decl();
+		this->types[decl->get_variable()->get_name()] = decl->get_type()->get_type();
+		d = ((SeqDecl *)d)->get_tail();
+	}
+}
+
+Value Evaluation::constant(Constant *c) {
+	std::string lexeme(c->get_value());
+	Value v;
+	if ( is_node_type<Integer>(c) ) {
+		v.type = "int";
+		v.i = atoll(lexeme.c_str());
+		if ( lexeme.size() > 10 || v.i > INT_MAX ) throw std::string("an int constant that does not fit");
+	} else if ( is_node_type<Float>(c) ) {
+		v.type = "double";
+		v.f = strtod(lexeme.c_str(), NULL);
+	} else if ( is_node_type<Char>(c) ) {
+		if ( lexeme.size() != 3 || lexeme[1] == '\\' ) throw std::string("a char escape");
+		v.type = "char";
+		v.i = (char) lexeme[1];
+	} else if ( is_node_type<Bool>(c) ) {
+		v.type = "bool";
+		v.i = ( lexeme == "true" );
+	} else {
+		if ( lexeme.find('\\') != std::string::npos ) throw std::string("a string escape");
+		v.type = "literal";
+		v.s = lexeme.substr(1, lexeme.size() - 2);
+	}
+	return v;
+}
+
+Value Evaluation::variable(Variable *v) {
+	std::string var(v->get_name());
+	Values *values = v->is_on_platform() ? &this->platform : ( v->is_local() ? &this->locals : &this->members );
+	Values::iterator found = values->find(var);
+	if ( found == values->end() ) throw std::string("a read of " + var + " before it is assigned");
+	return found->second;
+}
+
+Value Evaluation::arithmetic(std::string op, Value l, Value r) {
+	Value v;
+	if ( l.is_text() || r.is_text() ) {
+		if ( op != "+" || !l.is_text() || !r.is_text() || ( l.type == "literal" && r.type == "literal" ) ) {
+			throw std::string("string arithmetic the Machine does not do");
+		}
+		v.type = "string";
+		v.s = l.s + r.s;
+		return v;
+	}
+
+	if ( l.type == "double" || r.type == "double" ) {
+		double a = l.as_double();
+		double b = r.as_double();
+		if ( op == "/" && b == 0.0 ) throw std::string("a division by zero");
+		v.type = "double";
+		v.f = ( op == "+" ) ? a + b : ( op == "-" ) ? a - b : ( op == "*" ) ? a * b : a / b;
+		return v;
+	}
+	if ( l.type == "float" || r.type == "float" ) {
+		float a = (float) l.as_double();
+		float b = (float) r.as_double();
+		if ( op == "/" && b == 0.0f ) throw std::string("a division by zero");
+		v.type = "float";
+		v.f = ( op == "+" ) ? a + b : ( op == "-" ) ? a - b : ( op == "*" ) ? a * b : a / b;
+		return v;
+	}
+
+	// char and bool are promoted to int
+	long long a = l.i;
+	long long b = r.i;
+	if ( op == "/" && b == 0 ) throw std::string("a division by zero");
+	v.type = "int";
+	v.i = ( op == "+" ) ? a + b : ( op == "-" ) ? a - b : ( op == "*" ) ? a * b : a / b;
+	if ( v.i < INT_MIN || v.i > INT_MAX ) throw std::string("an int overflow");
+	return v;
+}
+
+bool Evaluation::compare(std::string op, Value l, Value r) {
+	int order;
+	if ( l.is_text() || r.is_text() ) {
+		if ( !l.is_text() || !r.is_text() || ( l.type == "literal" && r.type == "literal" ) ) {
+			throw std::string("a string comparison the Machine does not do");
+		}
+		order = l.s.compare(r.s);
+	} else if ( l.type == "double" || r.type == "double" ) {
+		double a = l.as_double();
+		double b = r.as_double();
+		order = ( a < b ) ? -1 : ( a > b ) ? 1 : 0;
+		if ( isnan(a) || isnan(b) ) return op == "!=";
+	} else if ( l.type == "float" || r.type == "float" ) {
+		float a = (float) l.as_double();
+		float b = (float) r.as_double();
+		order = ( a < b ) ? -1 : ( a > b ) ? 1 : 0;
+		if ( isnan(a) || isnan(b) ) return op == "!=";
+	} else {
+		order = ( l.i < r.i ) ? -1 : ( l.i > r.i ) ? 1 : 0;
+	}
+
+	if ( op == "==" ) return order == 0;
+	if ( op == "!=" ) return order != 0;
+	if ( op == "<" ) return order < 0;
+	if ( op == "<=" ) return order <= 0;
+	if ( op == ">" ) return order > 0;
+	return order >= 0;
+}
+
+/*
+	The value stored into the variable or platform field name of the given CFF
+	type, which is "" when neither the Machine nor its platform declares name.
+*/
+Value Evaluation::convert(Value v, std::string type, std::string name) {
+	if ( type.empty() ) {
+		throw std::string("an assignment to " + name + ", which is not declared");
+	}
+	if ( type != "int" && type != "char" && type != "bool" && type != "float" && type != "string" ) {
+		throw std::string("an assignment to " + name + " of type " + type);
+	}
+	Value to;
+	to.type = type;
+	if ( type == "string" ) {
+		if ( v.is_text() ) to.s = v.s;
+		else if ( v.type == "char" ) to.s = std::string(1, (char) v.i);
+		else throw std::string("a string assigned something else");
+		return to;
+	}
+	if ( v.is_text() ) throw std::string("a string assigned to a number");
+
+	if ( type == "float" ) {
+		to.f = (float) v.as_double();
+	} else if ( type == "bool" ) {
+		to.i = ( v.as_double() != 0.0 );
+	} else if ( v.is_floating() ) {
+		// a float that does not fit the integer is undefined
+		double limit = ( type == "char" ) ? 128.0 : 2147483648.0;
+		if ( isnan(v.f) || v.f <= -limit - 1.0 || v.f >= limit ) throw std::string("a float that does not fit");
+		to.i = ( type == "char" ) ? (long long)(char)(int) v.f : (long long)(int) v.f;
+	} else {
+		to.i = ( type == "char" ) ? (long long)(char) v.i : v.i;
+	}
+	return to;
+}
+
+Value Evaluation::eval(Expr *e) {
+	if ( is_node_type<Constant>(e) ) return this->constant((Constant *)e);
+	if ( is_node_type<Variable>(e) ) return this->variable((Variable *)e);
+	if ( is_node_type<Operator>(e) ) {
+		Operator *o = (Operator *)e;
+		return this->arithmetic(o->get_operator(), this->eval(o->get_left()), this->eval(o->get_right()));
+	}
+	if ( is_node_type<Comparison>(e) ) {
+		Comparison *c = (Comparison *)e;
+		Value v;
+		v.type = "bool";
+		v.i = this->compare(c->get_operator(), this->eval(c->get_left()), this->eval(c->get_right()));
+		return v;
+	}
+	throw std::string("an expression it does not know");
+}
+
+void Evaluation::assign(Stmt *st) {
+	Variable *lhs = st->get_variable();
+	Value v = this->eval(st->get_expr());
+	std::string type(this->types[lhs->get_name()]);
+	if ( lhs->is_on_platform() ) {
+		this->platform[lhs->get_name()] = this->convert(v, type, lhs->get_name());
+	} else if ( lhs->is_local() ) {
+		this->locals[lhs->get_name()] = this->convert(v, lhs->get_local_type(), lhs->get_name());
+	} else {
+		this->members[lhs->get_name()] = this->convert(v, type, lhs->get_name());
+	}
+}
+
+/*
+	What the platform prints when the Machine leaves a State, see cffc/RunTime.cpp.
+*/
+void Evaluation::next_state() {
+	if ( this->name == "IntegerComputer" ) {
+		this->out << this->platform["output"].i << "\n";
+		return;
+	}
+	Values::iterator x = this->platform.find("xPos");
+	Values::iterator y = this->platform.find("yPos");
+	if ( x == this->platform.end() || y == this->platform.end() ) throw std::string("a position printed before it is set");
+	this->out << "  XPos: " << (float) x->second.f << "  YPos: " << (float) y->second.f << "\n";
+}
+
+/*
+	True if the Machine reads the sensor of its platform somewhere.
+*/
+static bool _reads_input(Expr *e) {
+	if ( is_node_type<Variable>(e) ) return ((Variable *)e)->is_on_platform() && ((Variable *)e)->get_name() == "input";
+	if ( is_node_type<Operator>(e) ) return _reads_input(((Operator *)e)->get_left()) || _reads_input(((Operator *)e)->get_right());
+	if ( is_node_type<Comparison>(e) ) return _reads_input(((Comparison *)e)->get_left()) || _reads_input(((Comparison *)e)->get_right());
+	return false;
+}
+
+static bool _reads_input(Stmt *st) {
+	for ( ; st && !st->is_empty(); st = st->get_next() ) {
+		if ( _reads_input(st->get_expr()) ) return true;
+	}
+	return false;
+}
+
+bool evaluate(Program *p, long steps, std::string *output, std::string *reason) {
+	*reason = "";
+	std::string platform(p->get_platform()->get_variable()->get_name());
+	if ( platform != "PositionalRobot" && platform != "IntegerComputer" ) return false;
+
+	std::map<std::string, State *> by_name;
+	State *s = NULL;
+	for ( State *state = p->get_states(); state && !state->is_empty(); state = state->get_next() ) {
+		by_name[state->get_variable()->get_name()] = state;
+		if ( state->is_initial() && !s ) s = state;
+		for ( Transition *t = state->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			std::vector<Stmt *> fused = t->get_fused();
+			bool reads = _reads_input(t->get_expr()) || _reads_input(t->get_stmt());
+			for ( unsigned int k = 0; k < fused.size(); k++ ) reads = reads || _reads_input(fused[k]);
+			if ( reads ) return false;
+		}
+	}
+	if ( !s ) return false;
+
+	Evaluation machine(p);
+	long taken = 0;
+	try {
+		while ( s ) {
+			Transition *t = s->get_transition();
+			for ( ; t && !t->is_empty(); t = t->get_next() ) {
+				if ( t->is_never() ) continue;
+				if ( t->is_always() ) break;
+				Value guard = machine.eval(t->get_expr());
+				if ( guard.as_double() != 0.0 ) break;
+			}
+			// no transition was taken
+			if ( !t || t->is_empty() ) break;
+
+			machine.locals.clear();
+			for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) machine.assign(st);
+			std::vector<Stmt *> fused = t->get_fused();
+			for ( unsigned int k = 0; k < fused.size(); k++ ) {
+				machine.next_state();
+				machine.locals.clear();
+				for ( Stmt *st = fused[k]; st && !st->is_empty(); st = st->get_next() ) machine.assign(st);
+			}
+			machine.next_state();
+
+			taken += 1 + fused.size();
+			if ( taken > steps ) throw std::string("more than " + _int_to_string(steps) + " transitions");
+
+			if ( t->is_exit() ) break;
+			std::map<std::string, State *>::iterator next = by_name.find(t->get_variable()->get_name());
+			if ( next == by_name.end() ) throw std::string("a goto to a State that does not exist");
+			s = next->second;
+		}
+	} catch ( std::string why ) {
+		*reason = "The Machine was not run at compile time: " + why + ".";
+		return false;
+	}
+
+	*output = machine.out.str();
+	return true;
+}
@@ -0,0 +1,31 @@
+/*
+	evaluator.h
+	The evaluator runs a Machine inside cffc. A Machine whose platform gives
+	it nothing at run time (PositionalRobot, or IntegerComputer when input
+	is never read) prints the same on every run, so cffc can run it once
+	and emit only what it printed; see _cpp_evaluated in translator.h.
+
+	It computes what the C++ Machine computes: float members and platform
+	fields are floats, Float constants are doubles, and the usual arithmetic
+	conversions apply. Everything the C++ would leave undefined (a read
+	before the first assignment, int overflow, division by zero, a float
+	that does not fit the int it is stored in) stops the evaluation, and
+	cffc translates the Machine as usual.
+*/
+
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <string>
+
+#include "ast.h"
+
+/*
+	evaluate runs p from its initial State for at most steps transitions.
+	Returns true and sets output to everything the platform printed when
+	the Machine stopped in time. Otherwise returns false; reason says why
+	the evaluation failed, or is "" when the Machine takes input at run time.
+*/
+bool evaluate(Program *p, long steps, std::string *output, std::string *reason);
+
+#endif /* EVALUATOR_H */
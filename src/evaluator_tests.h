@@ -0,0 +1,88 @@
+#include <cxxtest/TestSuite.h>
+
+#include "evaluator.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "parseResult.h"
+#include "readInput.h"
+#include "ast.h"
+
+#include <string>
+
+using namespace std ;
+
+class EvaluatorTestSuite : public CxxTest::TestSuite
+{
+public:
+
+    Program *parse_program ( string text ) {
+        Parser p ;
+        ParseResult pr = p.parse ( text.c_str() ) ;
+        TSM_ASSERT ( pr.errors, pr.ok ) ;
+        return dynamic_cast<Program *> ( pr.ast ) ;
+    }
+
+    void test_box_prints_what_the_machine_prints ( ) {
+        Program *program = parse_program ( readInputFromFile ( "../samples/box.cff" ) ) ;
+        TS_ASSERT ( program ) ;
+        string printed, reason ;
+        TS_ASSERT ( evaluate ( program, 100000, &printed, &reason ) ) ;
+        TS_ASSERT_EQUALS ( printed, string ( readInputFromFile ( "../cffc/box.expected" ) ) ) ;
+
+        // and so does the optimized Machine
+        Program *optimized = parse_program ( readInputFromFile ( "../samples/box.cff" ) ) ;
+        optimize ( optimized, NULL ) ;
+        string again ;
+        TS_ASSERT ( evaluate ( optimized, 100000, &again, &reason ) ) ;
+        TS_ASSERT_EQUALS ( again, printed ) ;
+    }
+
+    void test_integer_computer_without_input ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int n ; float f ;\n"
+            "initial state: S { goto C when true performing { n := 7 / 2 ; f := 0.1 ; } ; }\n"
+            "state: C { goto C when n < 5 performing { n := n + 1 ; output := n * 2 + f * 10 ; } ; exit when true performing { } ; }\n" ) ;
+        string printed, reason ;
+        TS_ASSERT ( evaluate ( program, 100, &printed, &reason ) ) ;
+        TS_ASSERT_EQUALS ( printed, "0\n9\n11\n11\n" ) ;
+    }
+
+    void test_not_evaluated ( ) {
+        string printed, reason ;
+
+        // reads input: nothing to warn about
+        Program *input = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: S { exit when true performing { output := input ; } ; }\n" ) ;
+        TS_ASSERT ( ! evaluate ( input, 100, &printed, &reason ) ) ;
+        TS_ASSERT_EQUALS ( reason, "" ) ;
+
+        // runs for too long
+        Program *forever = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: S { goto S when true performing { output := 1 ; } ; }\n" ) ;
+        TS_ASSERT ( ! evaluate ( forever, 100, &printed, &reason ) ) ;
+        TS_ASSERT_EQUALS ( reason, "The Machine was not run at compile time: more than 100 transitions." ) ;
+
+        // what the C++ leaves undefined
+        Program *unset = parse_program (
+            "name: M ; platform: PositionalRobot ;\n"
+            "initial state: S { exit when true performing { xPos := xPos + 1.0 ; } ; }\n" ) ;
+        TS_ASSERT ( ! evaluate ( unset, 100, &printed, &reason ) ) ;
+        TS_ASSERT_EQUALS ( reason, "The Machine was not run at compile time: a read of xPos before it is assigned." ) ;
+
+        Program *overflow = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: S { exit when true performing { output := 2147483647 + 1 ; } ; }\n" ) ;
+        TS_ASSERT ( ! evaluate ( overflow, 100, &printed, &reason ) ) ;
+        TS_ASSERT_EQUALS ( reason, "The Machine was not run at compile time: an int overflow." ) ;
+
+        // a name the platform does not have
+        Program *undeclared = parse_program (
+            "name: M ; platform: PositionalRobot ;\n"
+            "initial state: S { exit when true performing { move := 1 ; } ; }\n" ) ;
+        TS_ASSERT ( ! evaluate ( undeclared, 100, &printed, &reason ) ) ;
+        TS_ASSERT_EQUALS ( reason, "The Machine was not run at compile time: an assignment to move, which is not declared." ) ;
+    }
+};
@@ -0,0 +1,184 @@
+#include "generator.h"
+#include <sstream>
+#include <stdlib.h>
+
+GeneratorOptions::GeneratorOptions() {
+	this->states = 100;
+	this->transitions = 4;
+	this->stmts = 2;
+	this->depth = 2;
+	this->decls = 8;
+	this->comments = 10;
+	this->limit = 10000;
+	this->seed = 1;
+	this->errors = "";
+}
+
+/*
+	parse
+	Every option takes a number, e.g. `--states 1000`.
+*/
+bool GeneratorOptions::parse(int argc, char **argv) {
+	for ( int i = 1; i < argc; i++ ) {
+		std::string arg(argv[i]);
+
+		if ( i + 1 >= argc ) {
+			this->errors = "Option \"" + arg + "\" needs a number.";
+			return false;
+		}
+		int n = atoi(argv[++i]);
+
+		if ( arg == "--states" ) this->states = n;
+		else if ( arg == "--transitions" ) this->transitions = n;
+		else if ( arg == "--stmts" ) this->stmts = n;
+		else if ( arg == "--depth" ) this->depth = n;
+		else if ( arg == "--decls" ) this->decls = n;
+		else if ( arg == "--comments" ) this->comments = n;
+		else if ( arg == "--limit" ) this->limit = n;
+		else if ( arg == "--seed" ) this->seed = n;
+		else {
+			this->errors = "Unknown option \"" + arg + "\".";
+			return false;
+		}
+	}
+
+	if ( this->states < 1 || this->transitions < 1 || this->decls < 1 ) {
+		this->errors = "There must be at least one State, transition and Decl.";
+		return false;
+	}
+	return true;
+}
+
+std::string generator_usage() {
+	std::string output("");
+	output = output + "Usage: cffgen [options] > program.cff\n";
+	output = output + "Options (defaults in brackets):\n";
+	output = output + "  --states N       States [100]\n";
+	output = output + "  --transitions N  transitions per State, the exit included [4]\n";
+	output = output + "  --stmts N        statements per transition, the step counter not included [2]\n";
+	output = output + "  --depth N        operators per expression [2]\n";
+	output = output + "  --decls N        int variables [8]\n";
+	output = output + "  --comments N     percentage of lines with a comment [10]\n";
+	output = output + "  --limit N        steps before every State exits [10000]\n";
+	output = output + "  --seed N         seed of the generator [1]\n";
+	return output;
+}
+
+/*
+	Generator
+	A small linear congruential generator, so the programs do not depend on
+	the C library's rand().
+*/
+class Generator {
+	public:
+		Generator(GeneratorOptions o) : options(o), state(o.seed) {}
+
+		std::string program();
+
+	private:
+		int next(int n);
+		void comment(std::ostringstream &out, std::string indent);
+		std::string variable();
+		std::string expr(int depth);
+		std::string guard();
+
+		GeneratorOptions options;
+		unsigned int state;
+};
+
+int Generator::next(int n) {
+	state = state * 1103515245u + 12345u;
+	return ( state >> 16 ) % n;
+}
+
+void Generator::comment(std::ostringstream &out, std::string indent) {
+	if ( next(100) >= options.comments ) return;
+	if ( next(2) ) out << indent << "// generated comment " << next(1000) << "\n";
+	else out << indent << "/* generated comment\n" << indent << "   spanning two lines */\n";
+}
+
+std::string Generator::variable() {
+	std::ostringstream out;
+	out << "v" << next(options.decls);
+	return out.str();
+}
+
+/*
+	expr
+	Sums and products of variables and small constants, `depth` operators deep.
+	There is no division, so a Machine can not divide by zero.
+*/
+std::string Generator::expr(int depth) {
+	if ( depth <= 0 ) {
+		if ( next(3) == 0 ) {
+			std::ostringstream out;
+			out << next(10);
+			return out.str();
+		}
+		return variable();
+	}
+
+	static const char *ops[] = { " + ", " - ", " * " };
+	int left = next(depth);
+	return "(" + expr(left) + ops[next(3)] + expr(depth - 1 - left) + ")";
+}
+
+std::string Generator::guard() {
+	static const char *comparisons[] = { " < ", " > ", " <= ", " >= ", " == ", " != " };
+	return expr(options.depth / 2) + comparisons[next(6)] + expr(options.depth / 2);
+}
+
+std::string Generator::program() {
+	std::ostringstream out;
+
+	out << "/* Generated by cffgen: " << options.states << " States, "
+	    << options.transitions << " transitions each, seed " << options.seed << ". */\n\n";
+	out << "name: Generated ;\n";
+	out << "platform: IntegerComputer ;\n\n";
+
+	out << "int steps ;\n";
+	for (int d = 0; d < options.decls; d++) {
+		comment(out, "");
+		out << "int v" << d << " ;\n";
+	}
+	out << "\n";
+
+	// Machine variables start out undefined, so Init sets them all
+	out << "initial state: Init {\n";
+	out << "  goto S0 when true performing {\n";
+	out << "    steps := 0 ;\n";
+	for (int d = 0; d < options.decls; d++) out << "    v" << d << " := " << d << " ;\n";
+	out << "  } ;\n";
+	out << "}\n\n";
+
+	for (int s = 0; s < options.states; s++) {
+		comment(out, "");
+		out << "state: S" << s << " {\n";
+
+		out << "  exit when steps >= " << options.limit << " performing { output := steps ; } ;\n";
+
+		for (int t = 1; t < options.transitions; t++) {
+			comment(out, "  ");
+			std::string when("true");
+			if ( t + 1 < options.transitions ) when = guard();
+
+			out << "  goto S" << next(options.states) << " when " << when << " performing {\n";
+			for (int k = 0; k < options.stmts; k++) {
+				comment(out, "    ");
+				out << "    " << variable() << " := " << expr(options.depth) << " ;\n";
+			}
+			out << "    steps := steps + 1 ;\n";
+			out << "    output := steps ;\n";
+			out << "  } ;\n";
+		}
+
+		out << "}\n\n";
+	}
+
+	return out.str();
+}
+
+std::string generate_cff(GeneratorOptions options) {
+	Generator g(options);
+	return g.program();
+}
@@ -0,0 +1,47 @@
+/*
+	generator.h
+	Generates synthetic CFF programs of any size, for benchmarking the compiler
+	(cffbench) and the generated Machines.
+
+	The programs run on IntegerComputer. The initial State Init sets every
+	variable and goes to S0. Every other State first exits once the step
+	counter reaches `limit`, then has `transitions - 1` more transitions whose
+	guards compare expressions of the variables; the last one is always `true`,
+	so a Machine keeps moving until the limit. Every transition counts a step
+	and performs `stmts` assignments of expressions `depth` operators deep.
+
+	The same GeneratorOptions (and seed) always give the same program.
+*/
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <string>
+
+class GeneratorOptions {
+	public:
+		GeneratorOptions();
+
+		bool parse(int argc, char **argv);
+
+		int states;
+		int transitions;
+		int stmts;
+		int depth;
+		int decls;
+
+		/*
+			comments is the percentage of lines with a comment before them.
+		*/
+		int comments;
+
+		int limit;
+		unsigned int seed;
+
+		std::string errors;
+};
+
+std::string generate_cff(GeneratorOptions options);
+std::string generator_usage();
+
+#endif /* GENERATOR_H */
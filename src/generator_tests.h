@@ -0,0 +1,64 @@
+#include <cxxtest/TestSuite.h>
+
+#include "generator.h"
+#include "parser.h"
+#include "parseResult.h"
+#include "ast.h"
+
+#include <string>
+
+using namespace std ;
+
+class GeneratorTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+    void test_generated_program_parses ( ) {
+        GeneratorOptions options ;
+        options.states = 20 ;
+        options.comments = 50 ;
+        string text = generate_cff ( options ) ;
+
+        Parser p ;
+        ParseResult pr = p.parse ( text.c_str() ) ;
+        TSM_ASSERT ( pr.errors, pr.ok ) ;
+
+        Program *program = dynamic_cast<Program *> ( pr.ast ) ;
+        TS_ASSERT ( program ) ;
+        // the States asked for and Init
+        TS_ASSERT_EQUALS ( program->getNumStates(), 21 ) ;
+        // steps and the decls asked for
+        TS_ASSERT_EQUALS ( program->getNumVarDecls(), options.decls + 1 ) ;
+    }
+
+    void test_deep_expressions_parse ( ) {
+        GeneratorOptions options ;
+        options.states = 5 ;
+        options.depth = 12 ;
+        options.stmts = 6 ;
+        Parser p ;
+        ParseResult pr = p.parse ( generate_cff ( options ).c_str() ) ;
+        TSM_ASSERT ( pr.errors, pr.ok ) ;
+    }
+
+    void test_same_seed_same_program ( ) {
+        GeneratorOptions a ;
+        GeneratorOptions b ;
+        TS_ASSERT_EQUALS ( generate_cff ( a ), generate_cff ( b ) ) ;
+
+        b.seed = 2 ;
+        TS_ASSERT_DIFFERS ( generate_cff ( a ), generate_cff ( b ) ) ;
+    }
+
+    void test_parse_options ( ) {
+        const char *argv[] = { "cffgen", "--states", "7", "--depth", "1" } ;
+        GeneratorOptions options ;
+        TS_ASSERT ( options.parse ( 5, (char **) argv ) ) ;
+        TS_ASSERT_EQUALS ( options.states, 7 ) ;
+        TS_ASSERT_EQUALS ( options.depth, 1 ) ;
+
+        const char *bad[] = { "cffgen", "--sates", "7" } ;
+        GeneratorOptions wrong ;
+        TS_ASSERT ( ! wrong.parse ( 3, (char **) bad ) ) ;
+    }
+};
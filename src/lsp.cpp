@@ -0,0 +1,298 @@
+#include "lsp.h"
+#include "document.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+	Json is a JSON value, as much of one as the messages need: kind is
+	'o'bject, 'a'rray, 's'tring, 'n'umber, 'b'oolean or '0' for null.
+	Missing members read as null.
+*/
+class Json {
+	public:
+		Json() : kind('0'), number(0) {}
+
+		char kind;
+		std::string text;
+		double number;
+		std::map<std::string, Json> members;
+		std::vector<Json> items;
+
+		const Json &operator[](std::string key) const {
+			static const Json none;
+			std::map<std::string, Json>::const_iterator found = members.find(key);
+			return found == members.end() ? none : found->second;
+		}
+};
+
+static void skip_space(const char *&p, const char *end) {
+	while ( p < end && ( *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' ) ) p++;
+}
+
+static bool read_string(const char *&p, const char *end, std::string *s) {
+	if ( p == end || *p != '"' ) return false;
+	p++;
+	*s = "";
+	while ( p < end && *p != '"' ) {
+		char c = *p++;
+		if ( c != '\\' ) {
+			*s += c;
+			continue;
+		}
+		if ( p == end ) return false;
+		c = *p++;
+		if ( c == 'n' ) *s += '\n';
+		else if ( c == 't' ) *s += '\t';
+		else if ( c == 'r' ) *s += '\r';
+		else if ( c == 'b' ) *s += '\b';
+		else if ( c == 'f' ) *s += '\f';
+		else if ( c == 'u' ) {
+			if ( end - p < 4 ) return false;
+			unsigned int u = strtoul(std::string(p, 4).c_str(), NULL, 16);
+			p += 4;
+			// as UTF-8; a pair of surrogates is kept as two characters
+			if ( u < 0x80 ) {
+				*s += (char) u;
+			} else if ( u < 0x800 ) {
+				*s += (char) ( 0xc0 | ( u >> 6 ) );
+				*s += (char) ( 0x80 | ( u & 0x3f ) );
+			} else {
+				*s += (char) ( 0xe0 | ( u >> 12 ) );
+				*s += (char) ( 0x80 | ( ( u >> 6 ) & 0x3f ) );
+				*s += (char) ( 0x80 | ( u & 0x3f ) );
+			}
+		}
+		else *s += c;
+	}
+	if ( p == end ) return false;
+	p++;
+	return true;
+}
+
+static bool read_json(const char *&p, const char *end, Json *v) {
+	skip_space(p, end);
+	if ( p == end ) return false;
+	if ( *p == '{' ) {
+		v->kind = 'o';
+		p++;
+		skip_space(p, end);
+		if ( p < end && *p == '}' ) {
+			p++;
+			return true;
+		}
+		while ( true ) {
+			std::string key;
+			skip_space(p, end);
+			if ( ! read_string(p, end, &key) ) return false;
+			skip_space(p, end);
+			if ( p == end || *p != ':' ) return false;
+			p++;
+			if ( ! read_json(p, end, &v->members[key]) ) return false;
+			skip_space(p, end);
+			if ( p < end && *p == ',' ) {
+				p++;
+			} else if ( p < end && *p == '}' ) {
+				p++;
+				return true;
+			} else {
+				return false;
+			}
+		}
+	}
+	if ( *p == '[' ) {
+		v->kind = 'a';
+		p++;
+		skip_space(p, end);
+		if ( p < end && *p == ']' ) {
+			p++;
+			return true;
+		}
+		while ( true ) {
+			v->items.push_back(Json());
+			if ( ! read_json(p, end, &v->items.back()) ) return false;
+			skip_space(p, end);
+			if ( p < end && *p == ',' ) {
+				p++;
+			} else if ( p < end && *p == ']' ) {
+				p++;
+				return true;
+			} else {
+				return false;
+			}
+		}
+	}
+	if ( *p == '"' ) {
+		v->kind = 's';
+		return read_string(p, end, &v->text);
+	}
+	std::string rest(p, end - p < 5 ? end - p : 5);
+	if ( rest.substr(0, 4) == "true" ) {
+		v->kind = 'b';
+		v->number = 1;
+		p += 4;
+		return true;
+	}
+	if ( rest == "false" ) {
+		v->kind = 'b';
+		p += 5;
+		return true;
+	}
+	if ( rest.substr(0, 4) == "null" ) {
+		p += 4;
+		return true;
+	}
+	const char *number = p;
+	while ( p < end && strchr("+-.0123456789eE", *p) ) p++;
+	if ( p == number ) return false;
+	v->kind = 'n';
+	v->text = std::string(number, p - number);
+	v->number = atof(v->text.c_str());
+	return true;
+}
+
+static std::string quote(std::string s) {
+	std::string q("\"");
+	for ( unsigned int k = 0; k < s.size(); k++ ) {
+		unsigned char c = s[k];
+		if ( c == '"' || c == '\\' ) {
+			q += '\\';
+			q += c;
+		} else if ( c == '\n' ) {
+			q += "\\n";
+		} else if ( c < 0x20 ) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			q += escaped;
+		} else {
+			q += c;
+		}
+	}
+	return q + "\"";
+}
+
+/*
+	Reading and writing the messages, each a header with its Content-Length,
+	an empty line and the JSON.
+*/
+static bool read_message(std::istream &in, std::string *body) {
+	long length = -1;
+	std::string line;
+	while ( std::getline(in, line) ) {
+		if ( ! line.empty() && line[line.size() - 1] == '\r' ) line.erase(line.size() - 1);
+		if ( line.empty() ) {
+			if ( length < 0 ) continue;
+			body->resize(length);
+			return length == 0 || in.read(&(*body)[0], length);
+		}
+		if ( line.substr(0, 15) == "Content-Length:" ) length = atol(line.c_str() + 15);
+	}
+	return false;
+}
+
+static void write_message(std::ostream &out, std::string body) {
+	out << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+	out.flush();
+}
+
+static std::string id_of(const Json &id) {
+	if ( id.kind == 's' ) return quote(id.text);
+	if ( id.kind == 'n' ) return id.text;
+	return "null";
+}
+
+static void reply(std::ostream &out, const Json &id, std::string result) {
+	write_message(out, "{\"jsonrpc\":\"2.0\",\"id\":" + id_of(id) + ",\"result\":" + result + "}");
+}
+
+static void reply_error(std::ostream &out, const Json &id, int code, std::string message) {
+	std::ostringstream body;
+	body << "{\"jsonrpc\":\"2.0\",\"id\":" << id_of(id) << ",\"error\":{\"code\":" << code << ",\"message\":" << quote(message) << "}}";
+	write_message(out, body.str());
+}
+
+static std::string where(Document *d, int offset) {
+	int line, column;
+	d->position(offset, &line, &column);
+	std::ostringstream position;
+	position << "{\"line\":" << line << ",\"character\":" << column << "}";
+	return position.str();
+}
+
+static void publish(std::ostream &out, std::string uri, Document *d) {
+	std::string list("");
+	if ( d ) {
+		std::vector<Diagnostic> found = d->diagnostics();
+		for ( unsigned int k = 0; k < found.size(); k++ ) {
+			if ( k > 0 ) list += ",";
+			list += "{\"range\":{\"start\":" + where(d, found[k].start) + ",\"end\":" + where(d, found[k].end) + "}"
+				+ ",\"severity\":1,\"source\":\"cffc\",\"message\":" + quote(found[k].message) + "}";
+		}
+	}
+	write_message(out, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":"
+		+ quote(uri) + ",\"diagnostics\":[" + list + "]}}");
+}
+
+int lsp(std::istream &in, std::ostream &out) {
+	Scanner scanner;
+	std::map<std::string, Document *> documents;
+	bool shut_down = false;
+
+	std::string body;
+	while ( read_message(in, &body) ) {
+		Json message;
+		const char *p = body.data();
+		if ( ! read_json(p, body.data() + body.size(), &message) || message.kind != 'o' ) {
+			reply_error(out, Json(), -32700, "Parse error");
+			continue;
+		}
+
+		std::string method = message["method"].text;
+		const Json &id = message["id"];
+		const Json &params = message["params"];
+		std::string uri = params["textDocument"]["uri"].text;
+
+		if ( method == "initialize" ) {
+			reply(out, id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2}},"
+				"\"serverInfo\":{\"name\":\"cffc\"}}");
+		} else if ( method == "shutdown" ) {
+			shut_down = true;
+			reply(out, id, "null");
+		} else if ( method == "exit" ) {
+			break;
+		} else if ( method == "textDocument/didOpen" ) {
+			if ( ! documents[uri] ) documents[uri] = new Document(&scanner);
+			documents[uri]->open(params["textDocument"]["text"].text);
+			publish(out, uri, documents[uri]);
+		} else if ( method == "textDocument/didChange" ) {
+			Document *d = documents[uri];
+			if ( ! d ) d = documents[uri] = new Document(&scanner);
+			const std::vector<Json> &changes = params["contentChanges"].items;
+			for ( unsigned int k = 0; k < changes.size(); k++ ) {
+				const Json &range = changes[k]["range"];
+				if ( range.kind == 'o' ) {
+					int start = d->offset(range["start"]["line"].number, range["start"]["character"].number);
+					int end = d->offset(range["end"]["line"].number, range["end"]["character"].number);
+					d->edit(start, end, changes[k]["text"].text);
+				} else {
+					d->open(changes[k]["text"].text);
+				}
+			}
+			publish(out, uri, d);
+		} else if ( method == "textDocument/didClose" ) {
+			delete documents[uri];
+			documents.erase(uri);
+			publish(out, uri, NULL);
+		} else if ( message.members.count("id") ) {
+			reply_error(out, id, -32601, "Method not found: " + method);
+		}
+	}
+
+	for ( std::map<std::string, Document *>::iterator d = documents.begin(); d != documents.end(); d++ ) delete d->second;
+	return shut_down ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+/*
+	lsp.h
+	`cffc --lsp` is a language server. An editor starts it and speaks the
+	Language Server Protocol to it on stdin and stdout, and it answers with
+	the syntax errors of every CFF program the editor has open while they
+	are typed. Each program is kept as a Document (document.h), so an edit
+	costs a scan of the tokens around it and a parse of the State it is in,
+	not a parse of the whole program.
+
+	It takes initialize, textDocument/didOpen, textDocument/didChange with
+	either the whole text or ranges of it, textDocument/didClose, shutdown
+	and exit, and sends textDocument/publishDiagnostics for every program
+	that was opened, changed or closed. Other requests get MethodNotFound.
+	Columns are counted in bytes, which for a CFF program, all ASCII, is
+	what the editor counts too.
+*/
+
+#ifndef LSP_H
+#define LSP_H
+
+#include <iostream>
+
+/*
+	lsp serves the messages on in until exit or the end of in, and writes
+	its answers on out. Returns the exit status of cffc: 0 when shutdown
+	came before the end, 1 otherwise.
+*/
+int lsp(std::istream &in, std::ostream &out);
+
+#endif /* LSP_H */
@@ -0,0 +1,1383 @@
+#include "optimizer.h"
+#include "translator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+/*
+	----
+	FoldValue is the value of a constant Expr while folding.
+	type is "int" (Integer, Char and Bool constants, which C++ promotes to int
+	in arithmetic), "float" (a double, like a Float constant in C++) or "" when
+	the Expr is not a constant that can be folded.
+	----
+*/
+
+class FoldValue {
+	public:
+		FoldValue() : type(""), i(0), f(0.0) {}
+
+		std::string type;
+		long long i;
+		double f;
+
+		double as_double() {
+			return this->type == "float" ? this->f : (double) this->i;
+		}
+};
+
+/*
+	Reads a Char lexeme such as 'a' or '\0'. Returns false for escapes it does not know.
+*/
+static bool _fold_char(std::string lexeme, long long *c) {
+	if ( lexeme.size() == 3 && lexeme[0] == '\'' && lexeme[2] == '\'' ) {
+		*c = (unsigned char) lexeme[1];
+		return lexeme[1] != '\\';
+	}
+	if ( lexeme.size() == 4 && lexeme[0] == '\'' && lexeme[1] == '\\' && lexeme[3] == '\'' ) {
+		switch ( lexeme[2] ) {
+			case '0': *c = 0; return true;
+			case 'n': *c = '\n'; return true;
+			case 't': *c = '\t'; return true;
+			case 'r': *c = '\r'; return true;
+			case '\\': *c = '\\'; return true;
+			case '\'': *c = '\''; return true;
+		}
+	}
+	return false;
+}
+
+static FoldValue _fold_value(Expr *e) {
+	FoldValue v;
+	if ( is_node_type<Integer>(e) ) {
+		std::string lexeme(((Constant *)e)->get_value());
+		char *end;
+		long long n = strtoll(lexeme.c_str(), &end, 10);
+		// a literal too large for an int is a long in C++, leave it alone
+		if ( *end == '\0' && n <= INT_MAX && n >= -INT_MAX ) {
+			v.type = "int";
+			v.i = n;
+		}
+	} else if ( is_node_type<Float>(e) ) {
+		std::string lexeme(((Constant *)e)->get_value());
+		char *end;
+		double d = strtod(lexeme.c_str(), &end);
+		if ( *end == '\0' ) {
+			v.type = "float";
+			v.f = d;
+		}
+	} else if ( is_node_type<Char>(e) ) {
+		if ( _fold_char(((Constant *)e)->get_value(), &v.i) ) v.type = "int";
+	} else if ( is_node_type<Bool>(e) ) {
+		std::string lexeme(((Constant *)e)->get_value());
+		if ( lexeme == "true" || lexeme == "false" ) {
+			v.type = "int";
+			v.i = ( lexeme == "true" );
+		}
+	}
+	return v;
+}
+
+/*
+	Makes the constant for a folded value, or returns NULL if it can not be written
+	as a literal of the same type and value.
+*/
+static Expr *_fold_constant(FoldValue v) {
+	if ( v.type == "int" ) {
+		// -INT_MAX - 1 has no literal of type int
+		if ( v.i > INT_MAX || v.i < -INT_MAX ) return NULL;
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%lld", v.i);
+		return new Integer(buffer);
+	}
+	if ( v.type == "float" ) {
+		if ( !isfinite(v.f) ) return NULL;
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%.17g", v.f);
+		std::string lexeme(buffer);
+		if ( lexeme.find_first_of(".e") == std::string::npos ) lexeme = lexeme + ".0";
+		return new Float(lexeme);
+	}
+	return NULL;
+}
+
+static Expr *_fold_operator(Operator *o, FoldValue l, FoldValue r) {
+	FoldValue v;
+	std::string op(o->get_operator());
+
+	if ( l.type == "float" || r.type == "float" ) {
+		double a = l.as_double();
+		double b = r.as_double();
+		v.type = "float";
+		if ( op == "+" ) v.f = a + b;
+		else if ( op == "-" ) v.f = a - b;
+		else if ( op == "*" ) v.f = a * b;
+		else if ( op == "/" && b != 0.0 ) v.f = a / b;
+		else return NULL;
+	} else {
+		long long a = l.i;
+		long long b = r.i;
+		v.type = "int";
+		if ( op == "+" ) v.i = a + b;
+		else if ( op == "-" ) v.i = a - b;
+		else if ( op == "*" ) v.i = a * b;
+		else if ( op == "/" && b != 0 ) v.i = a / b;
+		else return NULL;
+	}
+	return _fold_constant(v);
+}
+
+static Expr *_fold_comparison(Comparison *c, FoldValue l, FoldValue r) {
+	std::string op(c->get_operator());
+	bool result;
+
+	if ( l.type == "float" || r.type == "float" ) {
+		double a = l.as_double();
+		double b = r.as_double();
+		if ( op == "==" ) result = a == b;
+		else if ( op == "!=" ) result = a != b;
+		else if ( op == "<" ) result = a < b;
+		else if ( op == "<=" ) result = a <= b;
+		else if ( op == ">" ) result = a > b;
+		else if ( op == ">=" ) result = a >= b;
+		else return NULL;
+	} else {
+		long long a = l.i;
+		long long b = r.i;
+		if ( op == "==" ) result = a == b;
+		else if ( op == "!=" ) result = a != b;
+		else if ( op == "<" ) result = a < b;
+		else if ( op == "<=" ) result = a <= b;
+		else if ( op == ">" ) result = a > b;
+		else if ( op == ">=" ) result = a >= b;
+		else return NULL;
+	}
+	return new Bool(result ? "true" : "false");
+}
+
+/*
+	The CFF type of an Expr, or "" when it is not known.
+*/
+static std::string _fold_type(Expr *e, std::map<std::string, std::string> &types) {
+	if ( is_node_type<Integer>(e) ) return "int";
+	if ( is_node_type<Float>(e) ) return "float";
+	if ( is_node_type<Char>(e) ) return "char";
+	if ( is_node_type<Bool>(e) ) return "bool";
+	if ( is_node_type<String>(e) ) return "string";
+	if ( is_node_type<Comparison>(e) ) return "bool";
+	if ( is_node_type<Variable>(e) ) {
+		std::map<std::string, std::string>::iterator found = types.find(((Variable *)e)->get_name());
+		return found == types.end() ? "" : found->second;
+	}
+	if ( is_node_type<Operator>(e) ) {
+		std::string l(_fold_type(((Operator *)e)->get_left(), types));
+		std::string r(_fold_type(((Operator *)e)->get_right(), types));
+		if ( l == "float" || r == "float" ) return "float";
+		if ( ( l == "int" || l == "char" || l == "bool" ) && ( r == "int" || r == "char" || r == "bool" ) ) return "int";
+	}
+	return "";
+}
+
+static bool _is_integer(Expr *e, long long n) {
+	if ( !is_node_type<Integer>(e) ) return false;
+	FoldValue v = _fold_value(e);
+	return v.type == "int" && v.i == n;
+}
+
+/*
+	Drops an identity of an Operator with one Integer operand. Only where the
+	other operand keeps its type: x + 0 is not x when x is a char, and for
+	floats only the identities that are exact for -0.0 too are used.
+*/
+static Expr *_fold_identity(Operator *o, std::map<std::string, std::string> &types) {
+	Expr *l = o->get_left();
+	Expr *r = o->get_right();
+	std::string lt(_fold_type(l, types));
+	std::string rt(_fold_type(r, types));
+	bool l_number = ( lt == "int" || lt == "float" );
+	bool r_number = ( rt == "int" || rt == "float" );
+	std::string op(o->get_operator());
+
+	if ( op == "+" ) {
+		if ( _is_integer(r, 0) && lt == "int" ) return l;
+		if ( _is_integer(l, 0) && rt == "int" ) return r;
+	} else if ( op == "-" ) {
+		if ( _is_integer(r, 0) && l_number ) return l;
+	} else if ( op == "*" ) {
+		if ( _is_integer(r, 1) && l_number ) return l;
+		if ( _is_integer(l, 1) && r_number ) return r;
+		if ( _is_integer(r, 0) && lt == "int" ) return r;
+		if ( _is_integer(l, 0) && rt == "int" ) return l;
+	} else if ( op == "/" ) {
+		if ( _is_integer(r, 1) && l_number ) return l;
+	}
+	return NULL;
+}
+
+Expr *fold_expr(Expr *e, std::map<std::string, std::string> &types, int *folded) {
+	if ( is_node_type<Operator>(e) ) {
+		Operator *o = (Operator *)e;
+		o->set_left( fold_expr(o->get_left(), types, folded) );
+		o->set_right( fold_expr(o->get_right(), types, folded) );
+
+		FoldValue l = _fold_value(o->get_left());
+		FoldValue r = _fold_value(o->get_right());
+		Expr *result = NULL;
+		if ( !l.type.empty() && !r.type.empty() ) {
+			result = _fold_operator(o, l, r);
+		} else {
+			result = _fold_identity(o, types);
+		}
+		if ( result ) {
+			(*folded)++;
+			return result;
+		}
+	} else if ( is_node_type<Comparison>(e) ) {
+		Comparison *c = (Comparison *)e;
+		c->set_left( fold_expr(c->get_left(), types, folded) );
+		c->set_right( fold_expr(c->get_right(), types, folded) );
+
+		FoldValue l = _fold_value(c->get_left());
+		FoldValue r = _fold_value(c->get_right());
+		if ( !l.type.empty() && !r.type.empty() ) {
+			Expr *result = _fold_comparison(c, l, r);
+			if ( result ) {
+				(*folded)++;
+				return result;
+			}
+		}
+	}
+	return e;
+}
+
+std::map<std::string, std::string> variable_types(Program *p) {
+	std::map<std::string, std::string> types;
+
+	PlatformTraits traits = _platform_traits(p->get_platform()->get_variable()->get_name());
+	std::map<std::string, std::string>::iterator f;
+	for ( f = traits.fields.begin(); f != traits.fields.end(); f++ ) {
+		types[f->first] = ( f->second == "std::string" ? "string" : f->second );
+	}
+
+	DeclList *d = p->get_decls();
+	while ( is_node_type<SeqDecl>(d) ) {
+		Decl *decl = ((SeqDecl *)d)->get_decl();
+		types[decl->get_variable()->get_name()] = decl->get_type()->get_type();
+		d = ((SeqDecl *)d)->get_tail();
+	}
+	return types;
+}
+
+int fold_constants(Program *p) {
+	std::map<std::string, std::string> types = variable_types(p);
+	int folded = 0;
+
+	for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+		for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+
+			t->set_expr( fold_expr(t->get_expr(), types, &folded) );
+			FoldValue guard = _fold_value(t->get_expr());
+			if ( !guard.type.empty() ) {
+				bool held = ( guard.as_double() != 0.0 );
+				t->set_always(held);
+				t->set_never(!held);
+			}
+
+			for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) {
+				st->set_expr( fold_expr(st->get_expr(), types, &folded) );
+			}
+		}
+	}
+	return folded;
+}
+
+/*
+	Removes every State that can not be reached from the initial State and
+	returns how many it removed, their names in names. A Program without an
+	initial State is left alone.
+*/
+static int _remove_unreachable(Program *p, std::string *names) {
+	State *first = p->get_states();
+	if ( !first || first->is_empty() ) return 0;
+
+	std::map<std::string, State *> by_name;
+	State *initial = NULL;
+	for ( State *s = first; s; s = s->get_next() ) {
+		by_name[s->get_variable()->get_name()] = s;
+		if ( s->is_initial() && !initial ) initial = s;
+	}
+	if ( !initial ) return 0;
+
+	std::map<State *, bool> reached;
+	std::vector<State *> work;
+	reached[initial] = true;
+	work.push_back(initial);
+	while ( !work.empty() ) {
+		State *s = work.back();
+		work.pop_back();
+		for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			if ( t->is_exit() ) continue;
+			std::map<std::string, State *>::iterator target = by_name.find(t->get_variable()->get_name());
+			if ( target == by_name.end() || reached[target->second] ) continue;
+			reached[target->second] = true;
+			work.push_back(target->second);
+		}
+	}
+
+	int removed = 0;
+	State *kept = NULL;
+	State *last = NULL;
+	for ( State *s = first; s; s = s->get_next() ) {
+		if ( !reached[s] ) {
+			removed++;
+			*names = *names + ( names->empty() ? "" : ", " ) + s->get_variable()->get_name();
+			continue;
+		}
+		if ( last ) last->set_next(s); else kept = s;
+		last = s;
+	}
+	if ( removed > 0 ) {
+		last->set_next(NULL);
+		p->set_states(kept);
+	}
+	return removed;
+}
+
+std::string eliminate_dead(Program *p, int *transitions, int *states) {
+	std::string warnings("");
+	*transitions = 0;
+	*states = 0;
+
+	State *first = p->get_states();
+	if ( !first || first->is_empty() ) return warnings;
+
+	// dead transitions, unless --profile wants to count every guard
+	if ( ! p->get_options()->profile ) {
+		for ( State *s = first; s; s = s->get_next() ) {
+			Transition *kept = NULL;
+			Transition *last = NULL;
+			int removed = 0;
+			for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+				if ( !_live_transition(s, t) ) {
+					removed++;
+					continue;
+				}
+				if ( last ) last->set_next(t); else kept = t;
+				last = t;
+			}
+			if ( removed == 0 ) continue;
+
+			if ( last ) last->set_next(NULL); else kept = new Transition();
+			s->set_transition(kept);
+			*transitions += removed;
+			warnings = warnings + "Warning: State " + s->get_variable()->get_name() + ": removed "
+			           + _int_to_string(removed) + ( removed == 1 ? " transition" : " transitions" )
+			           + " that can never be taken.\n";
+		}
+	}
+
+	std::string names("");
+	*states = _remove_unreachable(p, &names);
+	if ( *states > 0 ) {
+		warnings = warnings + "Warning: removed " + _int_to_string(*states)
+		           + ( *states == 1 ? " State" : " States" ) + " that can not be reached: " + names + ".\n";
+	}
+	return warnings;
+}
+
+/*
+	----
+	Dataflow over the Machine variables, the members declared in the SeqDecls.
+	Platform fields are never touched: every platform->set_ stays where it is.
+
+	Copies flow forward: at the start of a State, a member is known to hold a
+	copy of another member or of a constant when it does on every way into
+	the State. Liveness flows backward: a member is live at the start of a
+	State when some guard or action reads it before it is written again.
+	An exit or the end of the Machine reads nothing.
+	----
+*/
+
+typedef std::set<std::string> Names;
+typedef std::map<std::string, Expr *> Copies;
+
+static bool _is_member(Expr *e) {
+	return is_node_type<Variable>(e) && !((Variable *)e)->is_on_platform();
+}
+
+/*
+	Every Machine variable read in e, once for each read.
+*/
+static void _members(Expr *e, std::vector<Variable *> &found) {
+	if ( _is_member(e) ) {
+		found.push_back((Variable *)e);
+	} else if ( is_node_type<Operator>(e) ) {
+		_members(((Operator *)e)->get_left(), found);
+		_members(((Operator *)e)->get_right(), found);
+	} else if ( is_node_type<Comparison>(e) ) {
+		_members(((Comparison *)e)->get_left(), found);
+		_members(((Comparison *)e)->get_right(), found);
+	}
+}
+
+static void _uses(Expr *e, Names &names) {
+	std::vector<Variable *> found;
+	_members(e, found);
+	for ( unsigned int k = 0; k < found.size(); k++ ) names.insert(found[k]->get_name());
+}
+
+static Expr *_clone_leaf(Expr *e) {
+	if ( is_node_type<Variable>(e) ) {
+		Variable *v = new Variable(((Variable *)e)->get_name());
+		v->set_on_platform(((Variable *)e)->is_on_platform());
+		return v;
+	}
+	std::string value(((Constant *)e)->get_value());
+	if ( is_node_type<Integer>(e) ) return new Integer(value);
+	if ( is_node_type<Float>(e) ) return new Float(value);
+	if ( is_node_type<Char>(e) ) return new Char(value);
+	if ( is_node_type<Bool>(e) ) return new Bool(value);
+	return new String(value);
+}
+
+static Expr *_propagate_expr(Expr *e, Copies &copies, int *count) {
+	if ( _is_member(e) ) {
+		Copies::iterator found = copies.find(((Variable *)e)->get_name());
+		if ( found == copies.end() ) return e;
+		(*count)++;
+		return _clone_leaf(found->second);
+	}
+	if ( is_node_type<Operator>(e) ) {
+		Operator *o = (Operator *)e;
+		o->set_left( _propagate_expr(o->get_left(), copies, count) );
+		o->set_right( _propagate_expr(o->get_right(), copies, count) );
+	} else if ( is_node_type<Comparison>(e) ) {
+		Comparison *c = (Comparison *)e;
+		c->set_left( _propagate_expr(c->get_left(), copies, count) );
+		c->set_right( _propagate_expr(c->get_right(), copies, count) );
+	}
+	return e;
+}
+
+/*
+	What a statement does to the copies: the member written stops being a copy,
+	and so does every copy of it; it becomes a copy itself when it is assigned
+	another member or a constant of exactly its type. Otherwise the assignment
+	converts, and a read of the source would not give what the member holds:
+	3 in a float does not divide as an int. A Float is emitted as a double
+	literal, so it is never what a float member holds: 0.1f is not 0.1.
+*/
+static void _assign(Copies &copies, Stmt *st, std::map<std::string, std::string> &types) {
+	Variable *lhs = st->get_variable();
+	if ( lhs->is_on_platform() ) return;
+
+	std::string name(lhs->get_name());
+	copies.erase(name);
+	for ( Copies::iterator c = copies.begin(); c != copies.end(); ) {
+		if ( _is_member(c->second) && ((Variable *)c->second)->get_name() == name ) copies.erase(c++);
+		else c++;
+	}
+
+	// a copy of a copy is a copy of the original
+	Expr *e = st->get_expr();
+	if ( _is_member(e) && copies.find(((Variable *)e)->get_name()) != copies.end() ) e = copies[((Variable *)e)->get_name()];
+	if ( !_is_member(e) && !is_node_type<Constant>(e) ) return;
+	if ( _is_member(e) && ((Variable *)e)->get_name() == name ) return;
+	if ( is_node_type<Float>(e) ) return;
+	std::string type(_fold_type(e, types));
+	if ( !type.empty() && type == types[name] ) copies[name] = e;
+}
+
+static bool _same_copy(Expr *a, Expr *b) {
+	return is_node_type<Variable>(a) == is_node_type<Variable>(b) && a->cppCode_cpp() == b->cppCode_cpp();
+}
+
+static std::map<std::string, State *> _states_by_name(Program *p) {
+	std::map<std::string, State *> by_name;
+	for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+		by_name[s->get_variable()->get_name()] = s;
+	}
+	return by_name;
+}
+
+static State *_initial_state(Program *p) {
+	for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+		if ( s->is_initial() ) return s;
+	}
+	return NULL;
+}
+
+int propagate_copies(Program *p) {
+	State *initial = _initial_state(p);
+	if ( !initial ) return 0;
+	std::map<std::string, State *> by_name = _states_by_name(p);
+	std::map<std::string, std::string> types = variable_types(p);
+
+	// a State missing from in has not been reached yet: everything holds there
+	std::map<State *, Copies> in;
+	in[initial] = Copies();
+	std::vector<State *> work;
+	work.push_back(initial);
+
+	while ( !work.empty() ) {
+		State *s = work.back();
+		work.pop_back();
+
+		for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			if ( t->is_exit() || t->is_never() ) continue;
+			std::map<std::string, State *>::iterator target = by_name.find(t->get_variable()->get_name());
+			if ( target == by_name.end() ) continue;
+
+			Copies out = in[s];
+			for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) _assign(out, st, types);
+
+			std::map<State *, Copies>::iterator before = in.find(target->second);
+			if ( before == in.end() ) {
+				in[target->second] = out;
+				work.push_back(target->second);
+				continue;
+			}
+			bool changed = false;
+			for ( Copies::iterator c = before->second.begin(); c != before->second.end(); ) {
+				Copies::iterator o = out.find(c->first);
+				if ( o == out.end() || !_same_copy(o->second, c->second) ) {
+					before->second.erase(c++);
+					changed = true;
+				} else {
+					c++;
+				}
+			}
+			if ( changed ) work.push_back(target->second);
+		}
+	}
+
+	int count = 0;
+	for ( std::map<State *, Copies>::iterator i = in.begin(); i != in.end(); i++ ) {
+		State *s = i->first;
+		for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			Copies copies = i->second;
+			t->set_expr( _propagate_expr(t->get_expr(), copies, &count) );
+			for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) {
+				st->set_expr( _propagate_expr(st->get_expr(), copies, &count) );
+				_assign(copies, st, types);
+			}
+		}
+	}
+	return count;
+}
+
+/*
+	The members live before the statements of t, given what is live after them.
+	With remove set, stores to members that are not live are taken out on the way.
+*/
+static Names _live_through(Transition *t, Names live, bool remove, int *removed) {
+	std::vector<Stmt *> stmts;
+	for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) stmts.push_back(st);
+
+	std::vector<Stmt *> kept;
+	for ( int k = (int) stmts.size() - 1; k >= 0; k-- ) {
+		Variable *lhs = stmts[k]->get_variable();
+		if ( !lhs->is_on_platform() ) {
+			if ( live.find(lhs->get_name()) == live.end() ) {
+				if ( remove ) {
+					(*removed)++;
+					continue;
+				}
+			}
+			live.erase(lhs->get_name());
+		}
+		_uses(stmts[k]->get_expr(), live);
+		kept.push_back(stmts[k]);
+	}
+
+	if ( remove && kept.size() != stmts.size() ) {
+		Stmt *first = NULL;
+		for ( int k = (int) kept.size() - 1; k >= 0; k-- ) {
+			kept[k]->set_next( k > 0 ? kept[k - 1] : NULL );
+			if ( !first ) first = kept[k];
+		}
+		t->set_stmt( first ? first : new Stmt() );
+	}
+	return live;
+}
+
+static std::map<State *, Names> _liveness(Program *p) {
+	std::map<std::string, State *> by_name = _states_by_name(p);
+	std::map<State *, Names> live_in;
+
+	bool changed = true;
+	while ( changed ) {
+		changed = false;
+		for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+			Names live;
+			for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+				_uses(t->get_expr(), live);
+				Names out;
+				if ( !t->is_exit() ) {
+					std::map<std::string, State *>::iterator target = by_name.find(t->get_variable()->get_name());
+					if ( target != by_name.end() ) out = live_in[target->second];
+				}
+				int unused = 0;
+				Names through = _live_through(t, out, false, &unused);
+				live.insert(through.begin(), through.end());
+			}
+			if ( live != live_in[s] ) {
+				live_in[s] = live;
+				changed = true;
+			}
+		}
+	}
+	return live_in;
+}
+
+int eliminate_dead_stores(Program *p, int *locals) {
+	*locals = 0;
+	if ( !p->get_states() || p->get_states()->is_empty() ) return 0;
+	std::map<std::string, State *> by_name = _states_by_name(p);
+
+	// a removed store can make the stores feeding it dead too
+	int removed = 0;
+	std::map<State *, Names> live_in;
+	for ( int before = -1; before != removed; ) {
+		before = removed;
+		live_in = _liveness(p);
+		for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+			for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+				Names out;
+				if ( !t->is_exit() && by_name.find(t->get_variable()->get_name()) != by_name.end() ) {
+					out = live_in[ by_name[t->get_variable()->get_name()] ];
+				}
+				_live_through(t, out, true, &removed);
+			}
+		}
+	}
+
+	// the lockstep backend keeps every member in its lane arrays
+	if ( p->get_options()->backend == "lockstep" ) return removed;
+
+	Names escaping;
+	for ( std::map<State *, Names>::iterator i = live_in.begin(); i != live_in.end(); i++ ) {
+		escaping.insert(i->second.begin(), i->second.end());
+	}
+
+	std::map<std::string, std::string> local_types;
+	DeclList *d = p->get_decls();
+	while ( is_node_type<SeqDecl>(d) ) {
+		Decl *decl = ((SeqDecl *)d)->get_decl();
+		std::string name(decl->get_variable()->get_name());
+		if ( escaping.find(name) == escaping.end() ) {
+			local_types[name] = decl->get_type()->get_type();
+			decl->get_variable()->set_local(local_types[name]);
+			(*locals)++;
+		}
+		d = ((SeqDecl *)d)->get_tail();
+	}
+	if ( local_types.empty() ) return removed;
+
+	// no local is read before it is written in the same block, or it would be live
+	for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+		for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) {
+				std::vector<Variable *> found;
+				_members(st->get_variable(), found);
+				_members(st->get_expr(), found);
+				for ( unsigned int k = 0; k < found.size(); k++ ) {
+					if ( local_types.count(found[k]->get_name()) ) found[k]->set_local(local_types[found[k]->get_name()]);
+				}
+			}
+		}
+	}
+	return removed;
+}
+
+/*
+	----
+	Value ranges.
+
+	For every int Machine variable the analysis keeps an interval of the
+	values it can hold at the start of each State, joined over every way in.
+	A transition is tested with the ranges that are left once every guard
+	before it failed, and is taken with those its own guard allows. A guard
+	that holds for every value left is always taken; one that holds for none
+	is never taken.
+
+	Arithmetic that could overflow an int gives the whole int range, so a
+	range is never narrower than what the Machine computes. A variable that
+	may not have been assigned yet can be read as anything. After a State's
+	ranges grew RANGE_WIDEN times, the bounds that still grow are widened to
+	the limits of an int, which ends the analysis on counting loops; then
+	RANGE_NARROW more rounds over every State take back what the guards bound.
+	----
+*/
+
+#define RANGE_WIDEN 8
+#define RANGE_NARROW 2
+
+class Range {
+	public:
+		Range() : lo(INT_MIN), hi(INT_MAX), unset(false) {}
+		Range(long long l, long long h) : lo(l), hi(h), unset(false) {}
+
+		long long lo;
+		long long hi;
+		// lo > hi: no value assigned yet
+		bool unset;
+
+		bool has_values() {
+			return lo <= hi;
+		}
+
+		// what a read can see
+		Range value() {
+			return unset ? Range() : *this;
+		}
+
+		bool operator==(const Range &r) const {
+			return lo == r.lo && hi == r.hi && unset == r.unset;
+		}
+};
+
+typedef std::map<std::string, Range> Ranges;
+
+static Range _join(Range a, Range b) {
+	Range r(1, 0);
+	if ( a.has_values() && b.has_values() ) r = Range(std::min(a.lo, b.lo), std::max(a.hi, b.hi));
+	else if ( a.has_values() ) r = Range(a.lo, a.hi);
+	else if ( b.has_values() ) r = Range(b.lo, b.hi);
+	r.unset = a.unset || b.unset;
+	return r;
+}
+
+/*
+	Joins from into into and returns true if into grew. With widen, a bound
+	that grows goes to the limit of an int.
+*/
+static bool _join(Ranges &into, Ranges &from, bool widen) {
+	bool changed = false;
+	for ( Ranges::iterator r = into.begin(); r != into.end(); r++ ) {
+		Range joined = _join(r->second, from[r->first]);
+		if ( joined == r->second ) continue;
+		if ( widen && r->second.has_values() ) {
+			if ( joined.lo < r->second.lo ) joined.lo = INT_MIN;
+			if ( joined.hi > r->second.hi ) joined.hi = INT_MAX;
+		}
+		r->second = joined;
+		changed = true;
+	}
+	return changed;
+}
+
+static bool _integral(std::string type) {
+	return type == "int" || type == "char" || type == "bool";
+}
+
+/*
+	The range of an integral Expr; any int when it is not one.
+*/
+static Range _range(Expr *e, Ranges &env, std::map<std::string, std::string> &types) {
+	std::string type(_fold_type(e, types));
+	if ( !_integral(type) ) return Range();
+
+	FoldValue v = _fold_value(e);
+	if ( v.type == "int" ) return Range(v.i, v.i);
+
+	if ( is_node_type<Variable>(e) ) {
+		Ranges::iterator found = env.find(((Variable *)e)->get_name());
+		if ( _is_member(e) && found != env.end() ) return found->second.value();
+		if ( type == "char" ) return Range(CHAR_MIN, CHAR_MAX);
+		if ( type == "bool" ) return Range(0, 1);
+		return Range();
+	}
+	if ( is_node_type<Comparison>(e) ) return Range(0, 1);
+	if ( !is_node_type<Operator>(e) ) return Range();
+
+	Operator *o = (Operator *)e;
+	Range l = _range(o->get_left(), env, types);
+	Range r = _range(o->get_right(), env, types);
+	std::string op(o->get_operator());
+	long long lo, hi;
+	if ( op == "+" ) {
+		lo = l.lo + r.lo;
+		hi = l.hi + r.hi;
+	} else if ( op == "-" ) {
+		lo = l.lo - r.hi;
+		hi = l.hi - r.lo;
+	} else if ( ( op == "*" || op == "/" ) && ( op == "*" || r.lo > 0 || r.hi < 0 ) ) {
+		// both are monotone on each side of zero, so the corners bound them
+		long long corners[4];
+		long long ls[2] = { l.lo, l.hi };
+		long long rs[2] = { r.lo, r.hi };
+		for ( int k = 0; k < 4; k++ ) {
+			corners[k] = ( op == "*" ) ? ls[k / 2] * rs[k % 2] : ls[k / 2] / rs[k % 2];
+		}
+		lo = *std::min_element(corners, corners + 4);
+		hi = *std::max_element(corners, corners + 4);
+	} else {
+		return Range();
+	}
+	if ( lo < INT_MIN || hi > INT_MAX ) return Range();
+	return Range(lo, hi);
+}
+
+static std::string _negated(std::string op) {
+	if ( op == "<" ) return ">=";
+	if ( op == "<=" ) return ">";
+	if ( op == ">" ) return "<=";
+	if ( op == ">=" ) return "<";
+	if ( op == "==" ) return "!=";
+	return "==";
+}
+
+static std::string _swapped(std::string op) {
+	if ( op == "<" ) return ">";
+	if ( op == "<=" ) return ">=";
+	if ( op == ">" ) return "<";
+	if ( op == ">=" ) return "<=";
+	return op;
+}
+
+/*
+	True if l op r holds for some values of l and r.
+*/
+static bool _may_hold(std::string op, Range l, Range r) {
+	if ( op == "<" ) return l.lo < r.hi;
+	if ( op == "<=" ) return l.lo <= r.hi;
+	if ( op == ">" ) return l.hi > r.lo;
+	if ( op == ">=" ) return l.hi >= r.lo;
+	if ( op == "==" ) return l.lo <= r.hi && r.lo <= l.hi;
+	return !( l.lo == l.hi && r.lo == r.hi && l.lo == r.lo );
+}
+
+/*
+	The values of x for which x op r can hold.
+*/
+static Range _constrain(Range x, std::string op, Range r) {
+	if ( op == "<" ) x.hi = std::min(x.hi, r.hi - 1);
+	else if ( op == "<=" ) x.hi = std::min(x.hi, r.hi);
+	else if ( op == ">" ) x.lo = std::max(x.lo, r.lo + 1);
+	else if ( op == ">=" ) x.lo = std::max(x.lo, r.lo);
+	else if ( op == "==" ) {
+		x.lo = std::max(x.lo, r.lo);
+		x.hi = std::min(x.hi, r.hi);
+	} else if ( r.lo == r.hi ) {
+		if ( x.lo == r.lo ) x.lo++;
+		if ( x.hi == r.lo ) x.hi--;
+	}
+	return x;
+}
+
+/*
+	Narrows env to where guard is (taken) or is not (!taken) true.
+	Returns false when that can not happen.
+*/
+static bool _refine(Ranges &env, Expr *guard, bool taken, std::map<std::string, std::string> &types) {
+	if ( !is_node_type<Comparison>(guard) ) return true;
+	Comparison *c = (Comparison *)guard;
+	if ( !_integral(_fold_type(c->get_left(), types)) || !_integral(_fold_type(c->get_right(), types)) ) return true;
+
+	std::string op( taken ? c->get_operator() : _negated(c->get_operator()) );
+	Range l = _range(c->get_left(), env, types);
+	Range r = _range(c->get_right(), env, types);
+	if ( !_may_hold(op, l, r) ) return false;
+
+	Expr *sides[2] = { c->get_left(), c->get_right() };
+	for ( int k = 0; k < 2; k++ ) {
+		if ( !_is_member(sides[k]) ) continue;
+		Ranges::iterator found = env.find(((Variable *)sides[k])->get_name());
+		if ( found == env.end() ) continue;
+		found->second = ( k == 0 ) ? _constrain(l, op, r) : _constrain(r, _swapped(op), l);
+	}
+	return true;
+}
+
+/*
+	Runs the transitions of a State entered with env. The gotos that can be
+	taken add their target and the ranges after their actions to out. When
+	decided is given, guards that are always or never true are marked, and
+	every value an action can store is joined into held.
+*/
+static void _range_transitions(State *s, Ranges env, std::map<std::string, std::string> &types,
+                               std::vector< std::pair<std::string, Ranges> > &out, int *decided, Ranges *held) {
+	for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+		if ( t->is_never() ) continue;
+
+		Ranges taken = env;
+		Ranges rest = env;
+		bool can = _refine(taken, t->get_expr(), true, types);
+		bool other = t->is_always() ? false : _refine(rest, t->get_expr(), false, types);
+		if ( decided && !can ) {
+			t->set_never(true);
+			(*decided)++;
+			continue;
+		}
+		if ( decided && !other && !t->is_always() ) {
+			t->set_always(true);
+			(*decided)++;
+		}
+
+		if ( can ) {
+			for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) {
+				Ranges::iterator lhs = taken.find(st->get_variable()->get_name());
+				if ( st->get_variable()->is_on_platform() || lhs == taken.end() ) continue;
+				lhs->second = _range(st->get_expr(), taken, types);
+				if ( !held ) continue;
+				Ranges::iterator before = held->find(lhs->first);
+				(*held)[lhs->first] = ( before == held->end() ) ? lhs->second : _join(before->second, lhs->second);
+			}
+			if ( !t->is_exit() ) out.push_back(std::make_pair(t->get_variable()->get_name(), taken));
+		}
+		if ( !other ) return;
+		env = rest;
+	}
+}
+
+int analyze_ranges(Program *p, int *narrowed) {
+	*narrowed = 0;
+	State *initial = _initial_state(p);
+	if ( !initial ) return 0;
+	std::map<std::string, State *> by_name = _states_by_name(p);
+	std::map<std::string, std::string> types = variable_types(p);
+
+	// every int member starts out unassigned
+	Ranges start;
+	std::map<std::string, Decl *> decls;
+	DeclList *d = p->get_decls();
+	while ( is_node_type<SeqDecl>(d) ) {
+		Decl *decl = ((SeqDecl *)d)->get_decl();
+		if ( decl->get_type()->get_type() == "int" ) {
+			Range unassigned(1, 0);
+			unassigned.unset = true;
+			start[decl->get_variable()->get_name()] = unassigned;
+			decls[decl->get_variable()->get_name()] = decl;
+		}
+		d = ((SeqDecl *)d)->get_tail();
+	}
+
+	// a State missing from in has not been reached yet
+	std::map<State *, Ranges> in;
+	std::map<State *, int> grown;
+	in[initial] = start;
+	std::vector<State *> work;
+	work.push_back(initial);
+
+	while ( !work.empty() ) {
+		State *s = work.back();
+		work.pop_back();
+
+		std::vector< std::pair<std::string, Ranges> > out;
+		_range_transitions(s, in[s], types, out, NULL, NULL);
+		for ( unsigned int k = 0; k < out.size(); k++ ) {
+			std::map<std::string, State *>::iterator target = by_name.find(out[k].first);
+			if ( target == by_name.end() ) continue;
+
+			std::map<State *, Ranges>::iterator before = in.find(target->second);
+			if ( before == in.end() ) {
+				in[target->second] = out[k].second;
+				work.push_back(target->second);
+			} else if ( _join(before->second, out[k].second, grown[target->second] >= RANGE_WIDEN) ) {
+				grown[target->second]++;
+				work.push_back(target->second);
+			}
+		}
+	}
+
+	// widening overshoots; running every State again from what it found
+	// takes back what the guards on the way in still bound
+	for ( int round = 0; round < RANGE_NARROW; round++ ) {
+		std::map<State *, Ranges> next;
+		next[initial] = start;
+		for ( std::map<State *, Ranges>::iterator i = in.begin(); i != in.end(); i++ ) {
+			std::vector< std::pair<std::string, Ranges> > out;
+			_range_transitions(i->first, i->second, types, out, NULL, NULL);
+			for ( unsigned int k = 0; k < out.size(); k++ ) {
+				std::map<std::string, State *>::iterator target = by_name.find(out[k].first);
+				if ( target == by_name.end() ) continue;
+				if ( next.find(target->second) == next.end() ) next[target->second] = out[k].second;
+				else _join(next[target->second], out[k].second, false);
+			}
+		}
+		in = next;
+	}
+
+	int decided = 0;
+	Ranges held;
+	for ( std::map<State *, Ranges>::iterator i = in.begin(); i != in.end(); i++ ) {
+		std::vector< std::pair<std::string, Ranges> > out;
+		_range_transitions(i->first, i->second, types, out, &decided, &held);
+	}
+
+	// a member that only ever holds small values is stored in a smaller type
+	for ( Ranges::iterator h = held.begin(); h != held.end(); h++ ) {
+		if ( !h->second.has_values() ) continue;
+		std::string storage("");
+		if ( h->second.lo >= SCHAR_MIN && h->second.hi <= SCHAR_MAX ) storage = "signed char";
+		else if ( h->second.lo >= SHRT_MIN && h->second.hi <= SHRT_MAX ) storage = "short";
+		if ( storage.empty() ) continue;
+		decls[h->first]->set_storage(storage);
+		(*narrowed)++;
+	}
+	return decided;
+}
+
+/*
+	----
+	State minimization.
+
+	Every transition is a symbol: its position in the State, its guard, its
+	actions and whether it exits, compared as the C++ they translate to. Two
+	States can be merged when they have the same symbols and every goto leads
+	to States that can be merged as well.
+
+	The States start out partitioned by their list of symbols; Hopcroft's
+	refinement then splits a class whenever some of its States reach a
+	splitter class by a symbol and others do not. A split puts both halves on
+	the worklist for symbols already waiting and only the smaller half
+	otherwise, which keeps the refinement at O(n log n) splits.
+	----
+*/
+
+static std::string _symbol(Transition *t, int position) {
+	return _int_to_string(position) + "\n" + t->get_expr()->cppCode_cpp() + "\n"
+	       + _cpp_stmts(t->get_stmt()) + ( t->is_exit() ? "exit" : "goto" );
+}
+
+int minimize_states(Program *p) {
+	State *first = p->get_states();
+	if ( !first || first->is_empty() ) return 0;
+
+	std::vector<State *> states;
+	std::map<std::string, int> index;
+	for ( State *s = first; s; s = s->get_next() ) {
+		index[s->get_variable()->get_name()] = states.size();
+		states.push_back(s);
+	}
+	int n = states.size();
+
+	// the symbols of every State and where they lead, -1 for an exit
+	std::map<std::string, int> symbols;
+	std::vector< std::vector<int> > symbol(n);
+	std::vector< std::vector<int> > target(n);
+	for ( int k = 0; k < n; k++ ) {
+		int position = 0;
+		for ( Transition *t = states[k]->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			std::string key(_symbol(t, position++));
+			if ( symbols.find(key) == symbols.end() ) {
+				int id = symbols.size();
+				symbols[key] = id;
+			}
+			int to = -1;
+			if ( !t->is_exit() ) {
+				std::map<std::string, int>::iterator found = index.find(t->get_variable()->get_name());
+				// a goto to a State that does not exist keeps its State out of every merge
+				if ( found == index.end() ) return 0;
+				to = found->second;
+			}
+			symbol[k].push_back(symbols[key]);
+			target[k].push_back(to);
+		}
+	}
+	int m = symbols.size();
+
+	// inverse[a][t] are the States that go to t by symbol a
+	std::vector< std::map<int, std::vector<int> > > inverse(m);
+	for ( int k = 0; k < n; k++ ) {
+		for ( unsigned int j = 0; j < symbol[k].size(); j++ ) {
+			if ( target[k][j] >= 0 ) inverse[ symbol[k][j] ][ target[k][j] ].push_back(k);
+		}
+	}
+
+	// the first partition: States with the same symbols
+	std::vector<int> cls(n);
+	std::vector< std::vector<int> > members;
+	std::map< std::vector<int>, int > by_symbols;
+	for ( int k = 0; k < n; k++ ) {
+		std::map< std::vector<int>, int >::iterator found = by_symbols.find(symbol[k]);
+		if ( found == by_symbols.end() ) {
+			by_symbols[symbol[k]] = members.size();
+			members.push_back(std::vector<int>());
+			found = by_symbols.find(symbol[k]);
+		}
+		cls[k] = found->second;
+		members[found->second].push_back(k);
+	}
+
+	std::set< std::pair<int, int> > waiting;
+	for ( unsigned int c = 0; c < members.size(); c++ ) {
+		for ( int a = 0; a < m; a++ ) waiting.insert(std::make_pair(c, a));
+	}
+
+	while ( !waiting.empty() ) {
+		std::pair<int, int> splitter = *waiting.begin();
+		waiting.erase(waiting.begin());
+		int a = splitter.second;
+
+		// the States that reach the splitter by a, grouped by their class
+		std::map<int, std::vector<int> > touched;
+		std::vector<int> &splitter_members = members[splitter.first];
+		for ( unsigned int j = 0; j < splitter_members.size(); j++ ) {
+			std::map<int, std::vector<int> >::iterator from = inverse[a].find(splitter_members[j]);
+			if ( from == inverse[a].end() ) continue;
+			for ( unsigned int i = 0; i < from->second.size(); i++ ) {
+				touched[ cls[from->second[i]] ].push_back(from->second[i]);
+			}
+		}
+
+		std::map<int, std::vector<int> >::iterator y;
+		for ( y = touched.begin(); y != touched.end(); y++ ) {
+			int old_class = y->first;
+			if ( y->second.size() == members[old_class].size() ) continue;
+
+			// the States in X move to a new class
+			int new_class = members.size();
+			members.push_back(y->second);
+			for ( unsigned int j = 0; j < y->second.size(); j++ ) cls[ y->second[j] ] = new_class;
+			std::vector<int> rest;
+			for ( unsigned int j = 0; j < members[old_class].size(); j++ ) {
+				if ( cls[ members[old_class][j] ] == old_class ) rest.push_back(members[old_class][j]);
+			}
+			members[old_class] = rest;
+
+			int smaller = ( members[new_class].size() < rest.size() ) ? new_class : old_class;
+			for ( int b = 0; b < m; b++ ) {
+				if ( waiting.count(std::make_pair(old_class, b)) ) {
+					waiting.insert(std::make_pair(new_class, b));
+				} else {
+					waiting.insert(std::make_pair(smaller, b));
+				}
+			}
+		}
+	}
+
+	// every class is represented by its initial State, or else its first one
+	std::vector<int> representative(members.size(), -1);
+	for ( int k = 0; k < n; k++ ) {
+		int c = cls[k];
+		if ( representative[c] < 0 || ( states[k]->is_initial() && !states[ representative[c] ]->is_initial() ) ) {
+			representative[c] = k;
+		}
+	}
+
+	int merged = 0;
+	State *kept = NULL;
+	State *last = NULL;
+	for ( int k = 0; k < n; k++ ) {
+		for ( Transition *t = states[k]->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			if ( t->is_exit() ) continue;
+			int to = representative[ cls[ index[t->get_variable()->get_name()] ] ];
+			if ( to != index[t->get_variable()->get_name()] ) t->set_variable( states[to]->get_variable() );
+		}
+		if ( representative[cls[k]] != k ) {
+			merged++;
+			continue;
+		}
+		if ( last ) last->set_next(states[k]); else kept = states[k];
+		last = states[k];
+	}
+	if ( merged > 0 ) {
+		last->set_next(NULL);
+		p->set_states(kept);
+	}
+	return merged;
+}
+
+/*
+	----
+	Chain fusion.
+
+	A glue State does nothing but take its one transition, which is always
+	taken, to another State. Every goto into it is redirected past the whole
+	chain of glue States that follows, and the actions along the chain
+	become the fused Stmts of the goto. The translator still calls
+	next_state and enter_state between them, since the platforms print and
+	read their sensors there; only the dispatch to the glue States is saved.
+	----
+*/
+
+/*
+	The transition of a glue State, or NULL if the State is not one.
+*/
+static Transition *_glue(State *s) {
+	Transition *t = s->get_transition();
+	while ( t && !t->is_empty() && !_live_transition(s, t) ) t = t->get_next();
+	if ( !t || t->is_empty() || !t->is_always() || t->is_exit() ) return NULL;
+	if ( t->get_variable()->get_name() == s->get_variable()->get_name() ) return NULL;
+	return t;
+}
+
+int fuse_chains(Program *p, int *transitions) {
+	*transitions = 0;
+	// the lockstep and coroutine backends step their States in their own way,
+	// and a simulated robot spends virtual time in every State
+	std::string backend(p->get_options()->backend);
+	if ( backend != "recursive" && backend != "runner" ) return 0;
+	if ( !_initial_state(p) ) return 0;
+
+	// the glue States as written, before any goto is redirected
+	std::map<std::string, State *> by_name = _states_by_name(p);
+	std::map<std::string, Stmt *> glue_stmt;
+	std::map<std::string, Variable *> glue_target;
+	for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+		Transition *t = _glue(s);
+		if ( !t ) continue;
+		glue_stmt[s->get_variable()->get_name()] = t->get_stmt();
+		glue_target[s->get_variable()->get_name()] = t->get_variable();
+	}
+	if ( glue_target.empty() ) return 0;
+
+	for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+		for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			if ( t->is_exit() ) continue;
+
+			// follow the chain until it leaves the glue States or comes back
+			// around, which makes a cycle of glue States a self loop
+			std::vector<Stmt *> fused = t->get_fused();
+			std::set<std::string> seen;
+			seen.insert(s->get_variable()->get_name());
+			Variable *target = t->get_variable();
+			while ( glue_target.count(target->get_name()) && !seen.count(target->get_name()) ) {
+				seen.insert(target->get_name());
+				fused.push_back(glue_stmt[target->get_name()]);
+				target = glue_target[target->get_name()];
+			}
+			if ( fused.size() == t->get_fused().size() ) continue;
+
+			t->set_variable(by_name.count(target->get_name()) ? by_name[target->get_name()]->get_variable() : target);
+			t->set_fused(fused);
+			(*transitions)++;
+		}
+	}
+
+	std::string names("");
+	return _remove_unreachable(p, &names);
+}
+
+/*
+	----
+	Shared guards and actions.
+
+	Wide Machines repeat the same guard, or the same actions, in many States.
+	Compared as the C++ they translate to, like in State minimization, each
+	one that comes up at least twice and is at least SHARE_BYTES of C++ gets
+	an id. The translator emits it once, as a noinline member function, and
+	every Transition with that id calls it (see _cpp_shared in translator.h).
+
+	The Transitions of a State that goes back to itself are left out: the
+	recursive backend keeps the variables of such a State in locals while it
+	loops, and a member function would not see them.
+	----
+*/
+
+#define SHARE_BYTES 64
+
+static bool _self_loop(State *s) {
+	for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+		if ( !_live_transition(s, t) || t->is_exit() ) continue;
+		if ( t->get_variable()->get_name() == s->get_variable()->get_name() ) return true;
+	}
+	return false;
+}
+
+/*
+	Gives an id to every body in uses that comes up often enough, in order.
+*/
+static int _share(std::vector<std::pair<std::string, Transition *> > &uses, bool guards) {
+	std::map<std::string, int> count;
+	for ( unsigned int k = 0; k < uses.size(); k++ ) count[uses[k].first]++;
+
+	std::map<std::string, int> ids;
+	for ( unsigned int k = 0; k < uses.size(); k++ ) {
+		std::string body(uses[k].first);
+		if ( count[body] < 2 || body.size() < SHARE_BYTES ) continue;
+		if ( !ids.count(body) ) {
+			int id = ids.size() + 1;
+			ids[body] = id;
+		}
+		if ( guards ) uses[k].second->set_shared_guard(ids[body]);
+		else uses[k].second->set_shared_action(ids[body]);
+	}
+	return ids.size();
+}
+
+int share_bodies(Program *p, int *actions) {
+	*actions = 0;
+	// the other backends have no member functions to call, or share already
+	std::string backend(p->get_options()->backend);
+	if ( backend != "recursive" && !p->get_options()->is_stepping() ) return 0;
+
+	std::vector<std::pair<std::string, Transition *> > guards, stmts;
+	for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+		if ( _self_loop(s) ) continue;
+		for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+			if ( !_live_transition(s, t) ) continue;
+			if ( !t->is_always() ) guards.push_back(std::make_pair(t->get_expr()->cppCode_cpp(), t));
+			if ( !t->get_stmt()->is_empty() ) stmts.push_back(std::make_pair(_cpp_stmts(t->get_stmt()), t));
+		}
+	}
+
+	*actions = _share(stmts, false);
+	return _share(guards, true);
+}
+
+std::string optimize(Program *p, Stats *stats) {
+	int folded = fold_constants(p);
+
+	// a Machine built with --swap can take over from an older version in any
+	// State and with any values, so nothing may be derived from running it
+	// from its initial State, and every State and variable keeps its name
+	bool whole = ( p->get_options()->backend != "swap" );
+
+	int copies = 0;
+	int narrowed = 0;
+	int decided = 0;
+	int transitions = 0;
+	int states = 0;
+	int locals = 0;
+	int stores = 0;
+	std::string warnings("");
+	if ( whole ) {
+		copies = propagate_copies(p);
+		if ( copies > 0 ) folded += fold_constants(p);
+
+		decided = analyze_ranges(p, &narrowed);
+
+		warnings = eliminate_dead(p, &transitions, &states);
+
+		stores = eliminate_dead_stores(p, &locals);
+	}
+
+	// the trace and the profile report the States as they were written
+	int merged = 0;
+	int fused = 0;
+	int fused_transitions = 0;
+	int shared_guards = 0;
+	int shared_actions = 0;
+	if ( ! p->get_options()->trace && ! p->get_options()->profile ) {
+		if ( whole ) {
+			merged = minimize_states(p);
+			fused = fuse_chains(p, &fused_transitions);
+		}
+		shared_guards = share_bodies(p, &shared_actions);
+	}
+
+	if ( stats ) {
+		stats->count("folded", folded);
+		stats->count("dead_transitions", transitions);
+		stats->count("dead_states", states);
+		stats->count("copies", copies);
+		stats->count("range_guards", decided);
+		stats->count("narrowed", narrowed);
+		stats->count("dead_stores", stores);
+		stats->count("locals", locals);
+		stats->count("merged_states", merged);
+		stats->count("fused_states", fused);
+		stats->count("fused_transitions", fused_transitions);
+		stats->count("shared_guards", shared_guards);
+		stats->count("shared_actions", shared_actions);
+	}
+	return warnings;
+}
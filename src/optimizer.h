@@ -0,0 +1,112 @@
+/*
+	optimizer.h
+	The optimizer rewrites the AST of a Program between checking and
+	translation. Every pass keeps what the Machine does; it only changes how
+	much code is emitted for it and how much work the Machine does per step.
+
+	cffc runs all passes unless it is given --no-optimize. A Machine built
+	with --swap may be entered in any State, so it only gets fold_constants
+	and share_bodies, which look at one Transition at a time.
+*/
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <string>
+#include <map>
+
+#include "ast.h"
+#include "stats.h"
+
+/*
+	optimize runs every pass over the Program and counts what they did in stats,
+	which may be NULL. Returns the warnings of the passes, one per line.
+*/
+std::string optimize(Program *p, Stats *stats);
+
+/*
+	fold_constants evaluates constant subexpressions and comparisons, drops
+	identities (x * 1, x + 0, x - 0, x / 1) and replaces x * 0 by 0 for ints.
+	Guards that fold to true or false mark their Transition always or never
+	taken; the translator leaves out what can not run.
+
+	Integer results are only folded when they fit in an int, and division is
+	only folded when the divisor is not zero, so the Machine computes exactly
+	what it computed before.
+
+	Returns the number of Exprs that were replaced.
+*/
+int fold_constants(Program *p);
+
+/*
+	analyze_ranges computes the interval of values every int Machine variable
+	can hold at the start of each State, refined by the guards on the way in.
+	Guards that hold for every value left mark their Transition always taken,
+	those that hold for none never taken. A member whose assignments all fit
+	in a signed char or a short is stored as one; narrowed counts them.
+	Returns the number of Transitions marked.
+*/
+int analyze_ranges(Program *p, int *narrowed);
+
+/*
+	eliminate_dead removes the transitions that can never be taken (after
+	fold_constants marked them), then every State that can not be reached
+	from the initial State. It counts both and returns a warning naming what
+	was removed. With --profile the transitions are kept, so every guard is
+	counted; a Program without an initial State is left alone.
+*/
+std::string eliminate_dead(Program *p, int *transitions, int *states);
+
+/*
+	propagate_copies replaces reads of a Machine variable that holds a copy of
+	another Machine variable or of a constant, on every way to the read, by
+	that variable or constant. Only a copy of exactly the variable's type
+	counts, so no read changes type. Returns the number of reads replaced.
+*/
+int propagate_copies(Program *p);
+
+/*
+	eliminate_dead_stores removes the assignments to Machine variables that
+	are overwritten, or never read, before any read. A Machine variable that is
+	never live at the start of a State does not need to outlive a transition,
+	so it becomes a C++ local of the transition (but not for --lockstep, whose
+	variables are lane arrays); locals counts them. Assignments to the platform
+	are all kept. Returns the number of assignments removed.
+*/
+int eliminate_dead_stores(Program *p, int *locals);
+
+/*
+	minimize_states merges States that behave the same: the same guards and
+	actions in the same order, leading to States that behave the same. Each
+	group keeps one State, the initial one if it is in there; the gotos to the
+	others are redirected to it. Returns the number of States removed.
+*/
+int minimize_states(Program *p);
+
+/*
+	fuse_chains redirects every goto into a State that only goes on to another
+	State, by a transition that is always taken, past the whole chain of such
+	States. The actions of the chain become the fused Stmts of the goto; the
+	translator still calls next_state and enter_state between them. Only the
+	recursive and runner backends fuse. transitions counts the gotos that were
+	redirected; returns the number of States that are no longer reached.
+*/
+int fuse_chains(Program *p, int *transitions);
+
+/*
+	share_bodies gives an id to every guard and every list of actions that
+	several Transitions translate to the same C++, so the translator emits
+	each once as a member function of the Machine. Only the recursive and
+	stepping backends share, and not in States that loop on themselves.
+	actions counts the shared actions; returns the number of shared guards.
+*/
+int share_bodies(Program *p, int *actions);
+
+/*
+	The folding of a single Expr, for passes and tests. types maps every
+	variable to its CFF type ("int", "float", "char", "string", "bool").
+*/
+Expr *fold_expr(Expr *e, std::map<std::string, std::string> &types, int *folded);
+std::map<std::string, std::string> variable_types(Program *p);
+
+#endif /* OPTIMIZER_H */
@@ -0,0 +1,480 @@
+#include <cxxtest/TestSuite.h>
+
+#include "optimizer.h"
+#include "parser.h"
+#include "parseResult.h"
+#include "ast.h"
+#include "translator.h"
+#include "readInput.h"
+
+#include <string>
+
+using namespace std ;
+
+class OptimizerTestSuite : public CxxTest::TestSuite
+{
+public:
+
+    Program *parse_program ( string text ) {
+        Parser p ;
+        ParseResult pr = p.parse ( text.c_str() ) ;
+        TSM_ASSERT ( pr.errors, pr.ok ) ;
+        return dynamic_cast<Program *> ( pr.ast ) ;
+    }
+
+    Program *folded ( string guard, string expr ) {
+        string text = "name: M ; platform: IntegerComputer ;\n"
+                      "int i ; float f ; char c ;\n"
+                      "initial state: S {\n"
+                      "  exit when " + guard + " performing { output := " + expr + " ; } ;\n"
+                      "}\n" ;
+        Program *program = parse_program ( text ) ;
+        TS_ASSERT ( program ) ;
+        fold_constants ( program ) ;
+        return program ;
+    }
+
+    string guard_of ( Program *program ) {
+        return program->get_states()->get_transition()->get_expr()->cppCode_cpp() ;
+    }
+
+    string stmt_of ( Program *program ) {
+        return program->get_states()->get_transition()->get_stmt()->get_expr()->cppCode_cpp() ;
+    }
+
+    void test_fold_arithmetic ( ) {
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "2 + 3 * 4" ) ), "14" ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "(2 + 3) * 4" ) ), "20" ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "7 / 2" ) ), "3" ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "1.5 * 2" ) ), "3.0" ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "i + (1 + 1)" ) ), " ( this->i + 2 ) " ) ;
+    }
+
+    void test_no_fold_when_result_differs ( ) {
+        // division by zero and int overflow are left for the Machine
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "1 / 0" ) ), " ( 1 / 0 ) " ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "2147483647 + 1" ) ), " ( 2147483647 + 1 ) " ) ;
+    }
+
+    void test_identities ( ) {
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "i * 1" ) ), "this->i" ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "0 + i" ) ), "this->i" ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "i * 0" ) ), "0" ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "f / 1" ) ), "this->f" ) ;
+        // f + 0 is not f for -0.0, c + 0 is an int
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "f + 0" ) ), " ( this->f + 0 ) " ) ;
+        TS_ASSERT_EQUALS ( stmt_of ( folded ( "true", "c + 0" ) ), " ( this->c + 0 ) " ) ;
+    }
+
+    void test_constant_guards ( ) {
+        Program *always = folded ( "1 + 1 == 2", "0" ) ;
+        TS_ASSERT_EQUALS ( guard_of ( always ), "true" ) ;
+        TS_ASSERT ( always->get_states()->get_transition()->is_always() ) ;
+
+        Program *never = folded ( "'a' > 'b'", "0" ) ;
+        TS_ASSERT_EQUALS ( guard_of ( never ), "false" ) ;
+        TS_ASSERT ( never->get_states()->get_transition()->is_never() ) ;
+
+        Program *unknown = folded ( "i < 2 * 3", "0" ) ;
+        TS_ASSERT_EQUALS ( guard_of ( unknown ), " this->i < 6 " ) ;
+        TS_ASSERT ( ! unknown->get_states()->get_transition()->is_always() ) ;
+        TS_ASSERT ( ! unknown->get_states()->get_transition()->is_never() ) ;
+    }
+
+    void test_unreachable_transitions_not_emitted ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: S {\n"
+            "  goto S when 1 > 2 performing { output := 1 ; } ;\n"
+            "  exit when true performing { output := 2 ; } ;\n"
+            "  goto S when input > 0 performing { output := 3 ; } ;\n"
+            "}\n" ) ;
+        fold_constants ( program ) ;
+        string code = program->cppCode_cpp() ;
+        TS_ASSERT ( code.find ( "set_output(1)" ) == string::npos ) ;
+        TS_ASSERT ( code.find ( "set_output(2)" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "set_output(3)" ) == string::npos ) ;
+    }
+
+    void test_eliminate_dead ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "state: Orphan { goto A when true performing { } ; }\n"
+            "initial state: A {\n"
+            "  goto B when input > 0 performing { } ;\n"
+            "  exit when true performing { } ;\n"
+            "  goto C when true performing { } ;\n"
+            "}\n"
+            "state: B { goto A when 2 < 1 performing { } ; }\n"
+            "state: C { goto Orphan when true performing { } ; }\n" ) ;
+        fold_constants ( program ) ;
+
+        int transitions, states ;
+        string warnings = eliminate_dead ( program, &transitions, &states ) ;
+        TS_ASSERT_EQUALS ( transitions, 2 ) ;
+        TS_ASSERT_EQUALS ( states, 2 ) ;
+        TS_ASSERT ( warnings.find ( "Orphan, C" ) != string::npos ) ;
+
+        TS_ASSERT_EQUALS ( program->getNumStates(), 2 ) ;
+        State *a = program->get_states() ;
+        TS_ASSERT_EQUALS ( a->get_variable()->get_name(), "A" ) ;
+        TS_ASSERT ( ! a->get_transition()->get_next()->has_next() ) ;
+        // B lost its only transition
+        TS_ASSERT ( a->get_next()->get_transition()->is_empty() ) ;
+        TS_ASSERT ( ! a->get_next()->has_next() ) ;
+    }
+
+    void test_eliminate_dead_keeps_live_program ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: A { goto B when true performing { } ; }\n"
+            "state: B { goto A when input > 0 performing { } ; exit when true performing { } ; }\n" ) ;
+        fold_constants ( program ) ;
+
+        int transitions, states ;
+        TS_ASSERT_EQUALS ( eliminate_dead ( program, &transitions, &states ), "" ) ;
+        TS_ASSERT_EQUALS ( program->getNumStates(), 2 ) ;
+    }
+
+    void test_propagate_copies_across_states ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int a ; int b ;\n"
+            "initial state: A { goto B when true performing { a := 3 ; b := a ; } ; }\n"
+            "state: B { exit when b == 3 performing { output := a ; } ; }\n" ) ;
+        fold_constants ( program ) ;
+        TS_ASSERT_EQUALS ( propagate_copies ( program ), 3 ) ;
+        fold_constants ( program ) ;
+
+        Transition *exit = program->get_states()->get_next()->get_transition() ;
+        TS_ASSERT ( exit->is_always() ) ;
+        TS_ASSERT_EQUALS ( exit->get_stmt()->get_expr()->cppCode_cpp(), "3" ) ;
+
+        // nothing reads a or b any more
+        int locals ;
+        TS_ASSERT_EQUALS ( eliminate_dead_stores ( program, &locals ), 2 ) ;
+        TS_ASSERT_EQUALS ( locals, 2 ) ;
+        TS_ASSERT ( program->get_states()->get_transition()->get_stmt()->is_empty() ) ;
+    }
+
+    void test_copies_meet_at_join ( ) {
+        // B is entered with a = 1 from A and a = 2 from C, so a is not a constant there
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int a ;\n"
+            "initial state: A { goto B when true performing { a := 1 ; } ; }\n"
+            "state: B { goto C when input > 0 performing { output := a ; } ; exit when true performing { } ; }\n"
+            "state: C { goto B when true performing { a := 2 ; } ; }\n" ) ;
+        TS_ASSERT_EQUALS ( propagate_copies ( program ), 0 ) ;
+    }
+
+    void test_copies_keep_their_type ( ) {
+        // a float holding 0.1 is not the double 0.1
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "float f ;\n"
+            "initial state: A { goto B when true performing { f := 0.1 ; } ; }\n"
+            "state: B { exit when f == 0.1 performing { output := 1 ; } ; exit when true performing { output := 2 ; } ; }\n" ) ;
+        TS_ASSERT_EQUALS ( propagate_copies ( program ), 0 ) ;
+        fold_constants ( program ) ;
+        TS_ASSERT ( ! program->get_states()->get_next()->get_transition()->is_always() ) ;
+
+        // 3 in a float divides as a float
+        program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "float f ; int g ;\n"
+            "initial state: A { goto B when true performing { f := 3 ; } ; }\n"
+            "state: B { exit when true performing { g := f / 2 * 10 ; output := g ; } ; }\n" ) ;
+        TS_ASSERT_EQUALS ( propagate_copies ( program ), 0 ) ;
+
+        // nor is a char a copy of an int, or the other way round
+        program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int i ; char c ; int j ;\n"
+            "initial state: A { goto B when true performing { c := 66 ; i := c ; j := 'a' ; } ; }\n"
+            "state: B { exit when true performing { output := i + j ; } ; }\n" ) ;
+        TS_ASSERT_EQUALS ( propagate_copies ( program ), 0 ) ;
+
+        // a member of the same type still is
+        program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "float f ; float h ;\n"
+            "initial state: A { goto B when true performing { f := input ; h := f ; } ; }\n"
+            "state: B { exit when true performing { output := h / 2 ; } ; }\n" ) ;
+        TS_ASSERT_EQUALS ( propagate_copies ( program ), 1 ) ;
+    }
+
+    void test_dead_stores_and_locals ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int a ; int b ; int t ;\n"
+            "initial state: A { goto B when true performing {\n"
+            "  a := input ; b := a ; a := 5 ; t := b * 2 ; output := t + 1 ; } ; }\n"
+            "state: B { exit when b > 0 performing { output := b ; } ; }\n" ) ;
+        Options options ;
+        program->set_options ( options ) ;
+
+        int locals ;
+        TS_ASSERT_EQUALS ( eliminate_dead_stores ( program, &locals ), 1 ) ;
+        TS_ASSERT_EQUALS ( locals, 2 ) ;
+
+        string code = program->cppCode_cpp() ;
+        TS_ASSERT ( code.find ( "int a = platform->get_input();" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "this->b = a;" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "int t = " ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "5" ) == string::npos ) ;
+
+        string header = program->cppCode_h() ;
+        TS_ASSERT ( header.find ( "int b;" ) != string::npos ) ;
+        TS_ASSERT ( header.find ( "int t;" ) == string::npos ) ;
+    }
+
+    void test_locals_read_in_comparisons ( ) {
+        Program *program = parse_program (
+            "name: L ; platform: IntegerStreamComputer ;\n"
+            "int t ; int flag ;\n"
+            "initial state: A { goto B when true performing { t := input * 2 ; flag := t > 3 ; } ; }\n"
+            "state: B { exit when flag == 1 performing { output := 1 ; } ; goto A when true performing { output := 0 ; } ; }\n" ) ;
+        Options options ;
+        program->set_options ( options ) ;
+
+        int locals ;
+        eliminate_dead_stores ( program, &locals ) ;
+        TS_ASSERT_EQUALS ( locals, 1 ) ;
+
+        string code = program->cppCode_cpp() ;
+        TS_ASSERT ( code.find ( "int t = " ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "this->t" ) == string::npos ) ;
+        TS_ASSERT ( program->cppCode_h().find ( "int t;" ) == string::npos ) ;
+    }
+
+    void test_self_loop_emitted_as_loop ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int i ; int n ;\n"
+            "initial state: Count {\n"
+            "  goto Count when i < n performing { i := i + 1 ; } ;\n"
+            "  exit when true performing { output := i ; } ;\n"
+            "}\n" ) ;
+        Options options ;
+        program->set_options ( options ) ;
+        TS_ASSERT ( _loops ( program, program->get_states() ) ) ;
+
+        string code = program->cppCode_cpp() ;
+        TS_ASSERT ( code.find ( "int i = this->i;" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "int n = this->n;" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "continue;" ) != string::npos ) ;
+        // i is written back, n is only read
+        TS_ASSERT ( code.find ( "this->i = i;" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "this->n = n;" ) == string::npos ) ;
+        TS_ASSERT ( code.find ( "\t\tCount();" ) == string::npos ) ;
+
+        options.backend = "runner" ;
+        program->set_options ( options ) ;
+        TS_ASSERT ( ! _loops ( program, program->get_states() ) ) ;
+    }
+
+    void test_stream_map_emitted_as_batch_kernel ( ) {
+        Program *program = parse_program ( readInputFromFile ( "../samples/squareMapper.cff" ) ) ;
+        optimize ( program, NULL ) ;
+        TS_ASSERT ( _batches ( program ) ) ;
+        string code = program->cppCode_cpp() ;
+        TS_ASSERT ( code.find ( "output[k] = ( input[k] * input[k] );" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "run_stream_batch(argc, argv, SquareMapper_kernel)" ) != string::npos ) ;
+
+        Options options ;
+        options.batch = false ;
+        program->set_options ( options ) ;
+        TS_ASSERT ( ! _batches ( program ) ) ;
+
+        // a divisor that can be 0 traps on its own step, after the lines before it
+        Program *divides = parse_program (
+            "name: M ; platform: IntegerStreamComputer ;\n"
+            "initial state: S { goto S when true performing { output := 100 / input ; } ; }\n" ) ;
+        optimize ( divides, NULL ) ;
+        TS_ASSERT ( ! _batches ( divides ) ) ;
+
+        // n is kept from one step to the next
+        Program *sums = parse_program (
+            "name: M ; platform: IntegerStreamComputer ;\n"
+            "int n ;\n"
+            "initial state: S { goto S when true performing { n := n + input ; output := n ; } ; }\n" ) ;
+        optimize ( sums, NULL ) ;
+        TS_ASSERT ( ! _batches ( sums ) ) ;
+    }
+
+    void test_minimize_merges_equivalent_states ( ) {
+        // A, B and C count the same way; D writes another output
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: B { goto C when input > 0 performing { output := 1 ; } ; exit when true performing { } ; }\n"
+            "state: A { goto B when input > 0 performing { output := 1 ; } ; exit when true performing { } ; }\n"
+            "state: C { goto A when input > 0 performing { output := 1 ; } ; exit when true performing { } ; }\n"
+            "state: D { goto A when input > 0 performing { output := 2 ; } ; exit when true performing { } ; }\n" ) ;
+
+        TS_ASSERT_EQUALS ( minimize_states ( program ), 2 ) ;
+        TS_ASSERT_EQUALS ( program->getNumStates(), 2 ) ;
+
+        State *b = program->get_states() ;
+        TS_ASSERT_EQUALS ( b->get_variable()->get_name(), "B" ) ;
+        TS_ASSERT_EQUALS ( b->get_transition()->get_variable()->get_name(), "B" ) ;
+        State *d = b->get_next() ;
+        TS_ASSERT_EQUALS ( d->get_variable()->get_name(), "D" ) ;
+        TS_ASSERT_EQUALS ( d->get_transition()->get_variable()->get_name(), "B" ) ;
+    }
+
+    void test_minimize_splits_by_targets ( ) {
+        // A and B look the same, but only B leads to a State that exits at once
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: A { goto B when input > 0 performing { } ; exit when true performing { } ; }\n"
+            "state: B { goto C when input > 0 performing { } ; exit when true performing { } ; }\n"
+            "state: C { exit when true performing { } ; }\n" ) ;
+
+        TS_ASSERT_EQUALS ( minimize_states ( program ), 0 ) ;
+        TS_ASSERT_EQUALS ( program->getNumStates(), 3 ) ;
+    }
+
+    void test_fuse_chains ( ) {
+        // A and B only pass on to C; C goes back through A
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int n ;\n"
+            "initial state: S { goto A when true performing { n := 0 ; } ; }\n"
+            "state: A { goto B when true performing { n := n + 1 ; } ; }\n"
+            "state: B { goto C when true performing { output := n ; } ; }\n"
+            "state: C { goto A when n < input performing { } ; exit when true performing { } ; }\n" ) ;
+        fold_constants ( program ) ;
+
+        int transitions ;
+        TS_ASSERT_EQUALS ( fuse_chains ( program, &transitions ), 2 ) ;
+        TS_ASSERT_EQUALS ( transitions, 3 ) ;
+        TS_ASSERT_EQUALS ( program->getNumStates(), 2 ) ;
+
+        State *s = program->get_states() ;
+        TS_ASSERT_EQUALS ( s->get_transition()->get_variable()->get_name(), "C" ) ;
+        TS_ASSERT_EQUALS ( s->get_transition()->get_fused().size(), 2u ) ;
+        State *c = s->get_next() ;
+        TS_ASSERT_EQUALS ( c->get_variable()->get_name(), "C" ) ;
+        TS_ASSERT_EQUALS ( c->get_transition()->get_variable()->get_name(), "C" ) ;
+
+        // the hooks of A and B are still called, in order
+        string code = program->cppCode_cpp() ;
+        TS_ASSERT ( code.find ( "\t\tthis->n = 0;\n"
+                                "\t\tplatform->next_state();\n"
+                                "\t\tplatform->enter_state();\n"
+                                "\t\tthis->n =  ( this->n + 1 ) ;\n"
+                                "\t\tplatform->next_state();\n"
+                                "\t\tplatform->enter_state();\n"
+                                "\t\tplatform->set_output(this->n);\n"
+                                "\t\tplatform->next_state();\n"
+                                "\t\tC();\n" ) != string::npos ) ;
+    }
+
+    void test_fuse_chains_only_recursive_and_runner ( ) {
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "initial state: S { goto A when true performing { } ; }\n"
+            "state: A { goto B when true performing { output := 1 ; } ; }\n"
+            "state: B { exit when true performing { } ; }\n" ) ;
+        fold_constants ( program ) ;
+        Options options ;
+        options.backend = "lockstep" ;
+        program->set_options ( options ) ;
+
+        int transitions ;
+        TS_ASSERT_EQUALS ( fuse_chains ( program, &transitions ), 0 ) ;
+        TS_ASSERT_EQUALS ( transitions, 0 ) ;
+        TS_ASSERT_EQUALS ( program->getNumStates(), 3 ) ;
+    }
+
+    void test_swap_keeps_states_and_variables ( ) {
+        // D can not be reached, n is 0 in A and only holds 0 or 1
+        string text =
+            "name: M ; platform: IntegerComputer ;\n"
+            "int n ;\n"
+            "initial state: S { goto A when true performing { n := 0 ; } ; }\n"
+            "state: A { goto B when input > n performing { n := 1 ; } ; exit when true performing { } ; }\n"
+            "state: B { goto A when input > n performing { n := 1 ; } ; exit when true performing { } ; }\n"
+            "state: D { goto A when true performing { output := n ; } ; }\n" ;
+        Program *program = parse_program ( text ) ;
+        optimize ( program, NULL ) ;
+        TS_ASSERT_EQUALS ( program->getNumStates(), 3 ) ;
+        TS_ASSERT_EQUALS ( ( (SeqDecl *) program->get_decls() )->get_decl()->get_storage(), "signed char" ) ;
+
+        // a swapped in Machine may go on from any of them
+        Program *swapped = parse_program ( text ) ;
+        Options options ;
+        options.backend = "swap" ;
+        swapped->set_options ( options ) ;
+        optimize ( swapped, NULL ) ;
+        TS_ASSERT_EQUALS ( swapped->getNumStates(), 4 ) ;
+        Decl *n = ( (SeqDecl *) swapped->get_decls() )->get_decl() ;
+        TS_ASSERT_EQUALS ( n->get_storage(), "int" ) ;
+        TS_ASSERT ( n->get_variable()->cppCode_cpp().find ( "this->" ) == 0 ) ;
+    }
+
+    void test_share_bodies ( ) {
+        // A and B have the same long guard and actions; C loops on itself
+        string guard = "( n * 3 + m ) > ( input * 7 + n )" ;
+        string action = "n := n * 1000 + m ; m := m * 10 + n ; output := n + m ;" ;
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int n ; int m ;\n"
+            "initial state: A { exit when " + guard + " performing { } ; goto B when true performing { " + action + " } ; }\n"
+            "state: B { exit when " + guard + " performing { } ; goto C when true performing { " + action + " } ; }\n"
+            "state: C { exit when " + guard + " performing { } ; goto C when n < 5 performing { " + action + " } ; goto A when true performing { } ; }\n" ) ;
+        fold_constants ( program ) ;
+
+        int actions ;
+        TS_ASSERT_EQUALS ( share_bodies ( program, &actions ), 1 ) ;
+        TS_ASSERT_EQUALS ( actions, 1 ) ;
+        State *a = program->get_states() ;
+        TS_ASSERT_EQUALS ( a->get_transition()->get_shared_guard(), 1 ) ;
+        TS_ASSERT_EQUALS ( a->get_transition()->get_next()->get_shared_action(), 1 ) ;
+        State *c = a->get_next()->get_next() ;
+        TS_ASSERT_EQUALS ( c->get_transition()->get_shared_guard(), 0 ) ;
+
+        string code = program->cppCode_cpp() ;
+        TS_ASSERT ( code.find ( "__attribute__((noinline)) void M::shared_action_1() {" ) != string::npos ) ;
+        TS_ASSERT ( code.find ( "\tif (shared_guard_1()) {" ) != string::npos ) ;
+        TS_ASSERT ( program->cppCode_h().find ( "\t\tbool shared_guard_1();\n" ) != string::npos ) ;
+    }
+
+    void test_ranges_decide_guards ( ) {
+        // n counts from 1 to 10 in B, and only goes up
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int n ; int big ;\n"
+            "initial state: S { goto A when true performing { n := 0 ; big := 0 ; } ; }\n"
+            "state: A { goto B when n < 10 performing { n := n + 1 ; big := big + input ; } ; exit when true performing { } ; }\n"
+            "state: B { exit when n > 10 performing { } ; goto A when n >= 1 performing { } ; exit when true performing { } ; }\n" ) ;
+        fold_constants ( program ) ;
+
+        int narrowed ;
+        TS_ASSERT_EQUALS ( analyze_ranges ( program, &narrowed ), 2 ) ;
+        TS_ASSERT_EQUALS ( narrowed, 1 ) ;
+
+        Transition *b = program->get_states()->get_next()->get_next()->get_transition() ;
+        TS_ASSERT ( b->is_never() ) ;
+        TS_ASSERT ( b->get_next()->is_always() ) ;
+
+        // n fits in a signed char; big adds up input
+        TS_ASSERT ( program->cppCode_h().find ( "\t\tsigned char n;\n" ) != string::npos ) ;
+        TS_ASSERT ( program->cppCode_h().find ( "\t\tint big;\n" ) != string::npos ) ;
+    }
+
+    void test_ranges_unknown_input ( ) {
+        // i is only bounded by input, and could overflow
+        Program *program = parse_program (
+            "name: M ; platform: IntegerComputer ;\n"
+            "int i ;\n"
+            "initial state: S { goto C when true performing { i := 0 ; } ; }\n"
+            "state: C { goto C when i <= input performing { i := i + 1 ; } ; exit when i < 0 performing { } ; exit when true performing { } ; }\n" ) ;
+        fold_constants ( program ) ;
+
+        int narrowed ;
+        TS_ASSERT_EQUALS ( analyze_ranges ( program, &narrowed ), 0 ) ;
+        TS_ASSERT_EQUALS ( narrowed, 0 ) ;
+    }
+};
@@ -0,0 +1,158 @@
+#include "options.h"
+
+#include <stdlib.h>
+
+Options::Options() {
+	this->backend = "recursive";
+	this->filename = "";
+	this->errors = "";
+	this->trace = false;
+	this->profile = false;
+	this->stats = "";
+	this->optimize = true;
+	this->evaluate = 100000;
+	this->batch = true;
+	this->split = 0;
+	this->serve = "";
+	this->connect = "";
+	this->lsp = false;
+}
+
+/*
+	parse
+	Walks the arguments given to cffc. Anything starting with "--" is a switch,
+	the remaining argument is the CFF file name.
+	Returns false and sets errors if something is not understood.
+*/
+bool Options::parse(int argc, char **argv) {
+
+	for ( int i = 1; i < argc; i++ ) {
+		std::string arg(argv[i]);
+
+		if ( arg == "--runner" ) {
+			this->backend = "runner";
+		} else if ( arg == "--lockstep" ) {
+			this->backend = "lockstep";
+		} else if ( arg == "--simulation" ) {
+			this->backend = "simulation";
+		} else if ( arg == "--coroutine" ) {
+			this->backend = "coroutine";
+		} else if ( arg == "--table" ) {
+			this->backend = "table";
+		} else if ( arg == "--swap" ) {
+			this->backend = "swap";
+		} else if ( arg == "--trace" ) {
+			this->trace = true;
+		} else if ( arg == "--profile" ) {
+			this->profile = true;
+		} else if ( arg == "--stats" ) {
+			this->stats = "text";
+		} else if ( arg == "--stats=json" ) {
+			this->stats = "json";
+		} else if ( arg == "--no-optimize" ) {
+			this->optimize = false;
+		} else if ( arg == "--no-batch" ) {
+			this->batch = false;
+		} else if ( arg.substr(0, 11) == "--evaluate=" ) {
+			std::string n(arg.substr(11));
+			if ( n.empty() || n.find_first_not_of("0123456789") != std::string::npos ) {
+				this->errors = "--evaluate needs a number of transitions.";
+				return false;
+			}
+			this->evaluate = atol(n.c_str());
+		} else if ( arg.substr(0, 8) == "--split=" ) {
+			std::string n(arg.substr(8));
+			if ( n.empty() || n.find_first_not_of("0123456789") != std::string::npos ) {
+				this->errors = "--split needs a number of files.";
+				return false;
+			}
+			this->split = atoi(n.c_str());
+		} else if ( arg.substr(0, 8) == "--serve=" && arg.size() > 8 ) {
+			this->serve = arg.substr(8);
+		} else if ( arg.substr(0, 10) == "--connect=" && arg.size() > 10 ) {
+			this->connect = arg.substr(10);
+		} else if ( arg == "--lsp" ) {
+			this->lsp = true;
+		} else if ( arg.substr(0, 2) == "--" ) {
+			this->errors = "Unknown option \"" + arg + "\".";
+			return false;
+		} else if ( this->filename.empty() ) {
+			this->filename = arg;
+		} else {
+			this->errors = "Only one CFF file can be compiled at a time.";
+			return false;
+		}
+	}
+
+	if ( ! this->serve.empty() ) {
+		if ( ! this->filename.empty() || ! this->connect.empty() ) {
+			this->errors = "--serve takes no CFF file and no --connect.";
+			return false;
+		}
+		return true;
+	}
+
+	if ( this->lsp ) {
+		if ( ! this->filename.empty() || ! this->connect.empty() ) {
+			this->errors = "--lsp takes no CFF file and no --connect, the editor sends the programs.";
+			return false;
+		}
+		return true;
+	}
+
+	if ( this->filename.empty() ) {
+		this->errors = "No CFF file given.";
+		return false;
+	}
+
+	if ( this->trace && this->backend == "lockstep" ) {
+		this->errors = "--trace can not be used with --lockstep.";
+		return false;
+	}
+	if ( this->profile && this->backend == "lockstep" ) {
+		this->errors = "--profile can not be used with --lockstep.";
+		return false;
+	}
+	if ( this->split > 0 && ( this->backend != "recursive" || this->trace || this->profile ) ) {
+		this->errors = "--split only works with the recursive backend, without --trace or --profile.";
+		return false;
+	}
+	if ( ( this->trace || this->profile ) && this->backend == "table" ) {
+		this->errors = "--trace and --profile can not be used with --table.";
+		return false;
+	}
+	if ( ( this->trace || this->profile ) && this->backend == "swap" ) {
+		this->errors = "--trace and --profile can not be used with --swap.";
+		return false;
+	}
+
+	return true;
+}
+
+bool Options::is_stepping() {
+	return ( this->backend == "runner" || this->backend == "simulation" || this->backend == "swap" );
+}
+
+std::string options_usage() {
+	std::string output("");
+	output = output + "Usage: cffc [options] <filename>\n";
+	output = output + "Options:\n";
+	output = output + "  --runner      emit a step() based Machine run by the multi-instance Runner\n";
+	output = output + "  --lockstep    emit a struct-of-arrays Machine that steps many lanes at once\n";
+	output = output + "  --simulation  emit a step() based Machine for a fleet on a virtual clock\n";
+	output = output + "  --coroutine   emit a C++20 coroutine Machine that waits for its input\n";
+	output = output + "  --table       emit transition tables and one generic loop, for very large Machines\n";
+	output = output + "  --swap        emit a step() based Machine as a shared object that swap_host can reload\n";
+	output = output + "  --trace       record every transition when compiled with -DCFFC_TRACING\n";
+	output = output + "  --profile     count States, guards and action time when compiled with -DCFFC_PROFILING\n";
+	output = output + "  --stats       report time, allocations and peak RSS of every compiler phase\n";
+	output = output + "  --stats=json  the same as JSON\n";
+	output = output + "  --no-optimize translate the program as written, without folding constants\n";
+	output = output + "  --evaluate=N  run a Machine without input for up to N transitions at compile time [100000]\n";
+	output = output + "  --no-batch    step a Machine that maps a stream one input at a time\n";
+	output = output + "  --split=N     spread the States over N files for make -j (see Machine.mk)\n";
+	output = output + "  --serve=SOCKET    answer compiles on a Unix socket until stopped\n";
+	output = output + "  --connect=SOCKET  compile on the server at SOCKET, or here when there is none\n";
+	output = output + "  --lsp         report syntax errors to an editor as a language server on stdin and stdout\n";
+	return output;
+}
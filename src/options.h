@@ -0,0 +1,102 @@
+/*
+	options.h
+	Options holds the command line switches given to cffc.
+	It is filled in once by cffc.cpp and then handed to the Program,
+	so the translator can decide how the Machine should be emitted.
+*/
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+
+class Options {
+	public:
+		Options();
+
+		bool parse(int argc, char **argv);
+
+		/*
+			is_stepping is true for every backend whose Machine exposes step()
+			instead of recursing from one state function into the next.
+		*/
+		bool is_stepping();
+
+		/*
+			backend is one of:
+				"recursive" (default) one member function per State, calling the next State
+				"runner"    step() based Machine driven by the multi-instance Runner
+				"simulation" step() based Machine run as a fleet on virtual time, see cffc/Simulation.h
+				"lockstep"  struct-of-arrays Machine running many lanes at once, see cffc/Lanes.h
+				"coroutine" C++20 coroutine Machine awaiting its sensor data, see cffc/RunTime.h
+				"table"     transition tables run by one generic loop, for very large Machines
+				"swap"      step() based Machine in a shared object that swap_host can reload, see cffc/Swap.h
+		*/
+		std::string backend;
+
+		/*
+			trace adds CFFC_TRACE calls to every transition, see cffc/Trace.h.
+		*/
+		bool trace;
+
+		/*
+			profile adds CFFC_PROFILE probes to every State and guard, see cffc/Profile.h.
+		*/
+		bool profile;
+
+		/*
+			stats is "" (off), "text" or "json", see stats.h.
+		*/
+		std::string stats;
+
+		/*
+			optimize runs the passes of optimizer.h before translation (default),
+			--no-optimize turns them off.
+		*/
+		bool optimize;
+
+		/*
+			evaluate is the most transitions cffc runs a Machine that takes no
+			input for at compile time, see evaluator.h. When it finishes in
+			time, the recursive backend emits only what it printed.
+			--evaluate=N sets it, --evaluate=0 turns it off.
+		*/
+		long evaluate;
+
+		/*
+			batch lets the recursive backend emit a Machine that only maps each
+			input of an IntegerStreamComputer to its output as a kernel over
+			blocks of inputs, see _cpp_batch in translator.h. --no-batch turns
+			it off.
+		*/
+		bool batch;
+
+		/*
+			split is the number of files the recursive backend spreads the
+			State functions over, Machine_1.cpp and on, so they can be compiled
+			in parallel; see _cpp_split_parts in translator.h. 0 (default)
+			keeps them in Machine.cpp. --split=N sets it.
+		*/
+		int split;
+
+		/*
+			serve is the Unix socket that `cffc --serve=SOCKET` answers compiles
+			on, connect the one `cffc --connect=SOCKET` sends its compile to;
+			see server.h. Both are "" when not given.
+		*/
+		std::string serve;
+		std::string connect;
+
+		/*
+			lsp makes cffc a language server on stdin and stdout that reports
+			the syntax errors of the programs an editor has open, see lsp.h.
+		*/
+		bool lsp;
+
+		std::string filename;
+		std::string errors;
+};
+
+std::string options_usage();
+
+#endif /* OPTIONS_H */
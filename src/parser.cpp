@@ -15,26 +15,114 @@
 
 using namespace std;
 
-Parser::Parser ( ) { } 
+Parser::Parser ( ) {
+    stats = NULL;
+    scanner = NULL;
+}
+
+/*
+    The AST copies every lexeme it keeps, so the tokens can go as soon as
+    the parse is done. The list of ExtTokens ends with endOfFile.
+*/
+static void free_tokens (Token *scanned, ExtToken *extended) {
+    while ( scanned != NULL ) {
+        Token *next = scanned->next;
+        delete scanned;
+        scanned = next;
+    }
+    while ( extended != NULL ) {
+        ExtToken *next = extended->terminal == endOfFile ? NULL : extended->next;
+        delete extended;
+        extended = next;
+    }
+}
 
 ParseResult Parser::parse (const char *text) {
     assert (text != NULL);
 
     ParseResult pr;
+    Scanner *s = scanner;
+    Token *scanned = NULL;
+    tokens = NULL;
+
+    // the phase that is being timed, if any, when an error is thrown
+    bool timing = false;
     try {
-        Scanner *s = new Scanner();
-        tokens = extendTokenList ( this, s->scan (text) );
+        // a Scanner of its own compiles every token pattern, which is part of the scan
+        if ( stats ) stats->begin("scan");
+        timing = stats != NULL;
+        if ( ! s ) s = new Scanner();
+        scanned = s->scan (text);
+        if ( stats ) stats->end();
+
+        if ( stats ) {
+            long count = 0;
+            for ( Token *t = scanned; t != NULL; t = t->next ) count++;
+            stats->count("tokens", count);
+            stats->begin("extend");
+        }
+        tokens = extendTokenList ( this, scanned );
+        if ( stats ) stats->end();
 
         assert(tokens != NULL);
         currToken = tokens;
+
+        if ( stats ) stats->begin("parse");
         pr = parseProgram( );
-        delete s;
+        if ( stats ) stats->end();
+        timing = false;
     }
     catch (string errMsg) {
+        if ( timing ) stats->end();
         pr.ok = false;
         pr.errors = errMsg;
         pr.ast = NULL;
     }
+    if ( s != scanner ) delete s;
+    free_tokens ( scanned, tokens );
+    tokens = NULL;
+    currToken = NULL;
+    return pr;
+}
+
+ParseResult Parser::parseBlock (Token *scanned, std::string part, int *failed_at) {
+    assert (scanned != NULL);
+
+    ParseResult pr;
+    tokens = extendTokenList ( this, scanned );
+    currToken = tokens;
+    try {
+        if ( part == "header" ) {
+            ParseResult variable, platform, decls;
+
+            match(nameKwd);
+            match(colon);
+            variable = parseVariableName();
+            match(semiColon);
+            platform = parsePlatform();
+            decls = parseDecls();
+
+            pr.ast = new Program( (Variable *)variable.ast, (Platform *)platform.ast, (DeclList *)decls.ast, new State() );
+        } else {
+            pr = parseState();
+
+            // what parseStates would make of the rest
+            if ( ! nextIs(endOfFile) && ! nextIs(initialKwd) ) {
+                match(stateKwd);
+            }
+        }
+    }
+    catch (string errMsg) {
+        pr.ok = false;
+        pr.errors = errMsg;
+        pr.ast = NULL;
+
+        *failed_at = 0;
+        for ( ExtToken *t = tokens; t != currToken; t = t->next ) (*failed_at)++;
+    }
+    free_tokens ( NULL, tokens );
+    tokens = NULL;
+    currToken = NULL;
     return pr;
 }
 
@@ -17,6 +17,7 @@
 #include "scanner.h"
 #include "parseResult.h"
 #include "ast.h"
+#include "stats.h"
 
 #include <string>
 #include <iostream>
@@ -31,6 +32,17 @@ public:
     ParseResult parse (const char *text);
     ParseResult prank (const char *text, std::string type);
 
+    /*
+        parseBlock parses scanned, a list of Tokens ending with endOfFile,
+        as one block of a program: "header" is the name, platform and
+        declarations, which it returns as a Program without States, and
+        "state" is one State. The first token of the block after it may
+        come before endOfFile, for the errors to read as they do in parse.
+        When it fails, *failed_at is the index of the Token it failed on.
+        Used by Document to reparse one State at a time, see document.h.
+    */
+    ParseResult parseBlock (Token *scanned, std::string part, int *failed_at);
+
     // Parser methods for the nonterminals:
     // Program, Platform, Decls, Decl, States, State,
     // Transitions, Transition, Stmts, Stmt, Expr
@@ -107,6 +119,19 @@ public:
     ExtToken *currToken;
     ExtToken *prevToken;
 
+    /*
+        When stats is set, parse times its scan, extend and parse phases
+        and counts the tokens, see stats.h.
+    */
+    Stats *stats;
+
+    /*
+        When scanner is set, parse scans with it instead of making a Scanner
+        of its own, which compiles every token pattern. A Scanner can be used
+        by one Parser at a time; the compile server keeps them warm, see server.h.
+    */
+    Scanner *scanner;
+
 };
 
 template <class J>
@@ -52,3 +52,19 @@ int matchRegex (regex_t *re, const char *text) {
     }
 }
 
+int matchRegex (regex_t *re, const char *text, int length) {
+    int status ;
+    const int nsub=1 ;
+    regmatch_t matches[nsub] ;
+
+    matches[0].rm_so = 0 ;
+    matches[0].rm_eo = length ;
+    status = regexec(re, text, (size_t)nsub, matches, REG_STARTEND);
+
+    if (status==REG_NOMATCH) {
+        return 0 ;
+    }
+    else {
+        return matches[0].rm_eo ;
+    }
+}
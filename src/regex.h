@@ -11,4 +11,11 @@ regex_t *makeRegex (const char* pattern) ;
 
 int matchRegex (regex_t *, const char *) ;
 
+/*
+    This form looks at no more than length characters of the text, which
+    need not end there. regexec measures the text it is given first, so
+    the Scanner bounds every match to keep scanning linear in the text.
+*/
+int matchRegex (regex_t *, const char *, int length) ;
+
 #endif /* REGEX_H */
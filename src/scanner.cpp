@@ -1,4 +1,5 @@
 #include <regex.h>
+#include <string.h>
 #include <string>
 #include <iostream>
 
@@ -132,60 +133,32 @@ Token *Scanner::scan(const char* text) {
 
 	int tokensCreated = 0;
 	int matched_characters = 0;
-	int best_match = 0;
+
+	// the rest of the text is this long, so no match has to measure it
+	int length = strlen(text);
 
 	Token *first = NULL;
 	Token *previous = NULL;
-	bool type_set = false;
 
 	tokenType typeFound;
 
-	matched_characters = _consume(text);
+	matched_characters = _consume(text, length);
 	text = text + matched_characters;
+	length = length - matched_characters;
 
-	while ( text[0] != '\0' ) {
-		best_match = 0;
-		type_set = false;
-
-		for (std::vector<tokenType>::size_type i = 0; i != this->order.size(); i++) {			
-			tokenType key = this->order[i];
-			regex_t *regex = this->expressions.at(key);
-
-			matched_characters = matchRegex(regex, text);
-
-			if ( matched_characters > best_match ) {
-				best_match = matched_characters;
-				type_set = true;
-				typeFound = key;
-			}
-
-		}
+	while ( length > 0 ) {
 
+		matched_characters = match(text, length, &typeFound);
 
 		Token *temp = new Token();
 		tokensCreated++;
-		if ( type_set == false ) {
-			
-			// aritifcally capture whatever the first character we didn't find is
-			matched_characters = 1;
-
-			// obviously, no type was set so this is a lexical error
-			temp->terminal = lexicalError;
-			std::string lexeme (text, matched_characters);
 
-			temp->lexeme = lexeme;
+		temp->terminal = typeFound;
+		std::string lexeme (text, matched_characters);
+		temp->lexeme = lexeme;
 
-			// set the text to the next character after processing
-			text = text + 1;
-
-		} else { // in this branch, save the token and lexeme found
-			temp->terminal = (tokenType)typeFound;
-
-			std::string lexeme (text, best_match);
-			temp->lexeme = lexeme;
-
-			text = text + best_match;
-		}
+		text = text + matched_characters;
+		length = length - matched_characters;
 
 		if ( previous != NULL ) {
 			previous->next = temp;
@@ -195,8 +168,9 @@ Token *Scanner::scan(const char* text) {
 		previous = temp;
 
 
-		matched_characters = this->_consume(text);
+		matched_characters = this->_consume(text, length);
 		text = text + matched_characters;
+		length = length - matched_characters;
 
 	}
 
@@ -215,12 +189,53 @@ Token *Scanner::scan(const char* text) {
 	return first;
 }
 
+/*
+	match finds the token at the start of text, of which length characters
+	are left, and returns how many characters it takes. The longest match
+	wins, the earlier one in order on a tie. A character no token starts
+	with is a lexicalError on its own.
+*/
+int Scanner::match(const char *text, int length, tokenType *terminal) {
+
+	int matched_characters = 0;
+	int best_match = 0;
+	bool type_set = false;
+
+	for (std::vector<tokenType>::size_type i = 0; i != this->order.size(); i++) {			
+		tokenType key = this->order[i];
+		regex_t *regex = this->expressions.at(key);
+
+		matched_characters = matchRegex(regex, text, length);
+
+		if ( matched_characters > best_match ) {
+			best_match = matched_characters;
+			type_set = true;
+			*terminal = key;
+		}
+
+	}
+
+	if ( type_set == false ) {
+
+		// aritifcally capture whatever the first character we didn't find is
+		*terminal = lexicalError;
+		return 1;
+
+	}
+
+	return best_match;
+}
+
 /*
 	While this is based on WordCount, it is now
 	built to iterate over ignore_expressions which contains
 	regex for whitespace and comments.
 */
 int Scanner::_consume(const char *text) {
+    return _consume(text, strlen(text));
+}
+
+int Scanner::_consume(const char *text, int length) {
 
     int numMatchedChars = 0;
     int totalNumMatchedChars = 0;
@@ -230,7 +245,7 @@ int Scanner::_consume(const char *text) {
         stillConsumingWhiteSpace = 0;  // exit loop if not reset by a match
 
         for(int i = ignore_expressions.size(); i > 0; --i) {
-        	numMatchedChars = matchRegex(ignore_expressions[i-1], text);
+        	numMatchedChars = matchRegex(ignore_expressions[i-1], text, length - totalNumMatchedChars);
         	totalNumMatchedChars += numMatchedChars;
         	if (numMatchedChars > 0) {
             text = text + numMatchedChars;
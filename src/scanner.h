@@ -66,7 +66,9 @@ class Scanner {
         Scanner();
         ~Scanner();
         Token *scan(const char*);
+        int match(const char*, int, tokenType*);
         int _consume(const char*);
+        int _consume(const char*, int);
 };
 
 
@@ -0,0 +1,231 @@
+#include "server.h"
+
+#include <iostream>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+	The server remembers this many compiles; the oldest is forgotten first.
+*/
+#define SERVE_CACHE 256
+
+/*
+	Reading and writing the messages.
+*/
+static bool write_all(int fd, const char *data, size_t n) {
+	while ( n > 0 ) {
+		ssize_t written = write(fd, data, n);
+		if ( written <= 0 ) return false;
+		data += written;
+		n -= written;
+	}
+	return true;
+}
+
+static bool read_all(int fd, char *data, size_t n) {
+	while ( n > 0 ) {
+		ssize_t got = read(fd, data, n);
+		if ( got <= 0 ) return false;
+		data += got;
+		n -= got;
+	}
+	return true;
+}
+
+static void put_count(std::string &message, uint32_t n) {
+	message.append((const char *) &n, sizeof(n));
+}
+
+static void put_string(std::string &message, const std::string &s) {
+	put_count(message, s.size());
+	message.append(s);
+}
+
+static bool get_count(int fd, uint32_t *n) {
+	return read_all(fd, (char *) n, sizeof(*n));
+}
+
+static bool get_string(int fd, std::string *s) {
+	uint32_t n;
+	if ( ! get_count(fd, &n) ) return false;
+	s->resize(n);
+	return n == 0 || read_all(fd, &(*s)[0], n);
+}
+
+static bool socket_address(std::string path, struct sockaddr_un *address) {
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	if ( path.size() >= sizeof(address->sun_path) ) return false;
+	strcpy(address->sun_path, path.c_str());
+	return true;
+}
+
+/*
+	Server holds what the connections share: the Scanners that are not in
+	use and the compiles done so far, keyed by their arguments and program.
+*/
+class Server {
+	public:
+		std::mutex lock;
+		std::vector<Scanner *> scanners;
+		std::map<std::string, Compilation> done;
+		std::deque<std::string> order;
+};
+
+static Compilation serve_compile(Server *server, std::vector<std::string> args, std::string text) {
+	std::string key("");
+	for ( unsigned int k = 0; k < args.size(); k++ ) key = key + args[k] + '\0';
+	key = key + '\0' + text;
+
+	Scanner *scanner = NULL;
+	{
+		std::lock_guard<std::mutex> hold(server->lock);
+		std::map<std::string, Compilation>::iterator cached = server->done.find(key);
+		if ( cached != server->done.end() ) return cached->second;
+		if ( ! server->scanners.empty() ) {
+			scanner = server->scanners.back();
+			server->scanners.pop_back();
+		}
+	}
+	if ( ! scanner ) scanner = new Scanner();
+
+	std::vector<char *> argv;
+	argv.push_back((char *) "cffc");
+	for ( unsigned int k = 0; k < args.size(); k++ ) argv.push_back(&args[k][0]);
+	argv.push_back(NULL);
+
+	Compilation c;
+	Options options;
+	if ( options.parse(argv.size() - 1, &argv[0]) ) {
+		c = compile(options, text.c_str(), NULL, scanner);
+	} else {
+		c.out = options.errors + "\n" + options_usage();
+		c.status = 1;
+	}
+
+	std::lock_guard<std::mutex> hold(server->lock);
+	server->scanners.push_back(scanner);
+	if ( server->done.find(key) == server->done.end() ) {
+		if ( server->order.size() == SERVE_CACHE ) {
+			server->done.erase(server->order.front());
+			server->order.pop_front();
+		}
+		server->done[key] = c;
+		server->order.push_back(key);
+	}
+	return c;
+}
+
+static void serve_connection(Server *server, int fd) {
+	uint32_t count;
+	std::vector<std::string> args;
+	std::string text;
+	bool ok = get_count(fd, &count);
+	for ( uint32_t k = 0; ok && k < count; k++ ) {
+		args.push_back("");
+		ok = get_string(fd, &args.back());
+	}
+	ok = ok && get_string(fd, &text);
+
+	if ( ok ) {
+		Compilation c = serve_compile(server, args, text);
+		std::string answer("");
+		put_count(answer, c.status);
+		put_string(answer, c.out);
+		put_string(answer, c.err);
+		put_count(answer, c.files.size());
+		for ( unsigned int k = 0; k < c.files.size(); k++ ) {
+			put_string(answer, c.files[k].first);
+			put_string(answer, c.files[k].second);
+		}
+		write_all(fd, answer.data(), answer.size());
+	}
+	close(fd);
+}
+
+static char serving[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+
+static void stop_serving(int s) {
+	unlink(serving);
+	_exit(0);
+}
+
+int serve(std::string socket_path) {
+	struct sockaddr_un address;
+	if ( ! socket_address(socket_path, &address) ) {
+		std::cout << "The socket path \"" << socket_path << "\" is too long." << std::endl;
+		return 1;
+	}
+
+	// a socket nobody answers on is left over from a server that is gone
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( connect(probe, (struct sockaddr *) &address, sizeof(address)) == 0 ) {
+		close(probe);
+		std::cout << "A compile server is already serving on \"" << socket_path << "\"." << std::endl;
+		return 1;
+	}
+	close(probe);
+	unlink(socket_path.c_str());
+
+	int listening = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( listening < 0
+	  || bind(listening, (struct sockaddr *) &address, sizeof(address)) != 0
+	  || listen(listening, 64) != 0 ) {
+		std::cout << "Can not serve on \"" << socket_path << "\": " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	strcpy(serving, socket_path.c_str());
+	signal(SIGINT, stop_serving);
+	signal(SIGTERM, stop_serving);
+	signal(SIGPIPE, SIG_IGN);
+
+	Server *server = new Server();
+	while ( true ) {
+		int fd = accept(listening, NULL, NULL);
+		if ( fd < 0 ) continue;
+		std::thread(serve_connection, server, fd).detach();
+	}
+	return 0;
+}
+
+bool compile_remote(std::string socket_path, std::vector<std::string> args, const char *text, Compilation *c) {
+	struct sockaddr_un address;
+	if ( ! socket_address(socket_path, &address) ) return false;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( fd < 0 ) return false;
+	if ( connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0 ) {
+		close(fd);
+		return false;
+	}
+
+	std::string request("");
+	put_count(request, args.size());
+	for ( unsigned int k = 0; k < args.size(); k++ ) put_string(request, args[k]);
+	put_string(request, text);
+
+	uint32_t status = 0, files = 0;
+	bool ok = write_all(fd, request.data(), request.size())
+		&& get_count(fd, &status)
+		&& get_string(fd, &c->out)
+		&& get_string(fd, &c->err)
+		&& get_count(fd, &files);
+	if ( ok ) c->status = status;
+	c->files.clear();
+	for ( uint32_t k = 0; ok && k < files; k++ ) {
+		std::string path, contents;
+		ok = get_string(fd, &path) && get_string(fd, &contents);
+		c->files.push_back(std::make_pair(path, contents));
+	}
+	close(fd);
+	return ok;
+}
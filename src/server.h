@@ -0,0 +1,40 @@
+/*
+	server.h
+	`cffc --serve=SOCKET` is a compile server: it listens on a Unix domain
+	socket and compiles for every `cffc --connect=SOCKET ...` that asks, so a
+	build that runs cffc on thousands of small programs does not set up a
+	compiler for each of them. The server keeps its Scanners, whose token
+	patterns are compiled once, and the results of the compiles it has done.
+	Every connection is served by a thread of its own.
+
+	The client still reads the program and writes the files itself, so paths
+	are those of the client, and it prints and exits exactly as a cffc that
+	compiled in its own process would. When no server answers it does that.
+
+	Requests and answers are written as 32 bit counts and lengths followed
+	by the bytes: the arguments and the program one way, the Compilation
+	(compiler.h) the other.
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <vector>
+
+#include "compiler.h"
+
+/*
+	serve answers compiles on socket_path until it is stopped by a signal.
+	Returns the exit status of cffc when it can not listen there.
+*/
+int serve(std::string socket_path);
+
+/*
+	compile_remote has the server at socket_path compile text, with args the
+	arguments cffc was given, less --connect. Returns false when there is no
+	server there or it hung up, c is set otherwise.
+*/
+bool compile_remote(std::string socket_path, std::vector<std::string> args, const char *text, Compilation *c);
+
+#endif /* SERVER_H */
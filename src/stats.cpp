@@ -0,0 +1,143 @@
+#include "stats.h"
+#include <new>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <stdlib.h>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+/*
+	The allocation counters. Every thread counts its own, so the threads of
+	the compile server (server.h) do not share them.
+*/
+static thread_local long allocations = 0;
+static thread_local long allocated_bytes = 0;
+
+void *operator new(std::size_t size) {
+	allocations++;
+	allocated_bytes += size;
+	void *p = malloc(size ? size : 1);
+	if ( p == NULL ) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, std::size_t size) noexcept {
+	free(p);
+}
+
+long stats_allocations() {return allocations;}
+long stats_allocated_bytes() {return allocated_bytes;}
+
+long stats_peak_rss() {
+#ifdef __unix__
+	struct rusage usage;
+	if ( getrusage(RUSAGE_SELF, &usage) == 0 ) return usage.ru_maxrss;
+#endif
+	return 0;
+}
+
+static double stats_clock() {
+	std::chrono::duration<double> d = std::chrono::steady_clock::now().time_since_epoch();
+	return d.count();
+}
+
+Stats::Stats() {
+	this->current = "";
+	this->start = 0;
+	this->start_allocations = 0;
+	this->start_bytes = 0;
+}
+
+void Stats::begin(std::string phase) {
+	this->current = phase;
+	this->start_allocations = stats_allocations();
+	this->start_bytes = stats_allocated_bytes();
+	this->start = stats_clock();
+}
+
+void Stats::end() {
+	Phase p;
+	p.seconds = stats_clock() - this->start;
+	p.name = this->current;
+	p.allocations = stats_allocations() - this->start_allocations;
+	p.bytes = stats_allocated_bytes() - this->start_bytes;
+	p.peak_rss = stats_peak_rss();
+	this->phases.push_back(p);
+}
+
+void Stats::count(std::string name, long n) {
+	this->counts.push_back( std::pair<std::string, long>(name, n) );
+}
+
+/*
+	text
+	One line per phase, then the totals and the counts.
+*/
+std::string Stats::text() {
+	std::ostringstream o;
+	o << std::left << std::setw(10) << "phase"
+	  << std::right << std::setw(12) << "ms"
+	  << std::setw(14) << "allocations"
+	  << std::setw(14) << "bytes"
+	  << std::setw(14) << "peak RSS KB" << "\n";
+
+	double seconds = 0;
+	long allocs = 0;
+	long bytes = 0;
+	for (std::vector<Phase>::size_type k = 0; k != this->phases.size(); k++) {
+		Phase &p = this->phases[k];
+		o << std::left << std::setw(10) << p.name
+		  << std::right << std::setw(12) << std::fixed << std::setprecision(3) << p.seconds * 1000
+		  << std::setw(14) << p.allocations
+		  << std::setw(14) << p.bytes
+		  << std::setw(14) << p.peak_rss << "\n";
+		seconds += p.seconds;
+		allocs += p.allocations;
+		bytes += p.bytes;
+	}
+	o << std::left << std::setw(10) << "total"
+	  << std::right << std::setw(12) << seconds * 1000
+	  << std::setw(14) << allocs
+	  << std::setw(14) << bytes
+	  << std::setw(14) << stats_peak_rss() << "\n";
+
+	for (std::vector< std::pair<std::string, long> >::size_type k = 0; k != this->counts.size(); k++) {
+		o << this->counts[k].first << ": " << this->counts[k].second << "\n";
+	}
+	return o.str();
+}
+
+/*
+	json
+	{ "phases": [ { "name": ..., "seconds": ..., ... }, ... ], "counts": { ... } }
+	Phase names and count names are plain words, so they need no escaping.
+*/
+std::string Stats::json() {
+	std::ostringstream o;
+	o << "{\n  \"phases\": [\n";
+	for (std::vector<Phase>::size_type k = 0; k != this->phases.size(); k++) {
+		Phase &p = this->phases[k];
+		o << "    { \"name\": \"" << p.name << "\""
+		  << ", \"seconds\": " << std::setprecision(9) << p.seconds
+		  << ", \"allocations\": " << p.allocations
+		  << ", \"bytes\": " << p.bytes
+		  << ", \"peak_rss_kb\": " << p.peak_rss << " }";
+		if ( k + 1 != this->phases.size() ) o << ",";
+		o << "\n";
+	}
+	o << "  ],\n  \"counts\": {\n";
+	for (std::vector< std::pair<std::string, long> >::size_type k = 0; k != this->counts.size(); k++) {
+		o << "    \"" << this->counts[k].first << "\": " << this->counts[k].second;
+		if ( k + 1 != this->counts.size() ) o << ",";
+		o << "\n";
+	}
+	o << "  }\n}\n";
+	return o.str();
+}
@@ -0,0 +1,63 @@
+/*
+	stats.h
+	Stats is what `cffc --stats` reports about one compile: for every phase its
+	wall time, how many allocations it made and how many bytes they asked for,
+	and the peak RSS of the process at its end, followed by the sizes of the
+	program (tokens, nodes, states, transitions).
+
+	Allocations are counted by the global operator new in stats.cpp, which is
+	linked into everything that links the parser.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include <vector>
+
+class Stats {
+	public:
+		Stats();
+
+		/*
+			begin starts timing a phase, end finishes the phase begun last.
+		*/
+		void begin(std::string phase);
+		void end();
+
+		void count(std::string name, long n);
+
+		std::string text();
+		std::string json();
+
+	private:
+		class Phase {
+			public:
+				std::string name;
+				double seconds;
+				long allocations;
+				long bytes;
+				long peak_rss;
+		};
+
+		std::vector<Phase> phases;
+		std::vector< std::pair<std::string, long> > counts;
+
+		std::string current;
+		double start;
+		long start_allocations;
+		long start_bytes;
+};
+
+/*
+	The process wide counters behind Stats.
+*/
+long stats_allocations();
+long stats_allocated_bytes();
+
+/*
+	stats_peak_rss is the peak resident set size of the process in KB.
+*/
+long stats_peak_rss();
+
+#endif /* STATS_H */
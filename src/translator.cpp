@@ -1,12 +1,50 @@
 #include "translator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <set>
+#include <vector>
 
 /*
-  Adds the RunTime and Machine to the CPP file.
+  Adds the platforms and the Machine to the CPP file. Platform.h is the
+  trimmed part of the RunTime that a Machine needs; the coroutine backend
+  needs the asynchronous RunTime of RunTime.h.
+  The runner and simulation backends also need the Runner or the Simulation,
+  the swap backend the C ABI of Swap.h; the lockstep backend uses Lanes instead. Those come first, so that g++ can
+  use their precompiled headers (make -f Makefile_Robot pch). With --trace or
+  --profile the names they report with follow.
 */
-std::string _cpp_includes() {
+std::string _cpp_includes(Program *p) {
   std::string output("");
-  output = output + "#include \"RunTime.h\"\n";
+  if ( p->get_options()->backend == "lockstep" ) {
+    output = output + "#include \"Lanes.h\"\n";
+    output = output + "#include \"Machine.h\"\n";
+    return output;
+  }
+  if ( p->get_options()->backend == "runner" ) {
+    output = output + "#include \"Runner.h\"\n";
+  }
+  if ( p->get_options()->backend == "simulation" ) {
+    output = output + "#include \"Simulation.h\"\n";
+  }
+  if ( p->get_options()->backend == "swap" ) {
+    output = output + "#include <string.h>\n";
+    output = output + "#include \"Swap.h\"\n";
+  }
+  if ( p->get_options()->backend == "coroutine" ) {
+    output = output + "#include \"RunTime.h\"\n";
+  } else {
+    output = output + "#include \"Platform.h\"\n";
+  }
+  if ( p->get_options()->trace ) {
+    output = output + "#include \"Trace.h\"\n";
+  }
+  if ( p->get_options()->profile ) {
+    output = output + "#include \"Profile.h\"\n";
+  }
   output = output + "#include \"Machine.h\"\n";
+  output = output + _cpp_trace_states(p);
+  output = output + _cpp_profile_names(p);
   return output;
 }
 
@@ -19,6 +57,8 @@ std::string _cpp_constructor_deconstructor(Program *p) {
   std::string name(p->get_variable()->get_name());
   output = output + name + "::" + name + "(" + p->get_platform()->get_variable()->get_name() + " *p) {\n";
   output = output + "\tthis->platform = p;\n";
+  output = output + _cpp_trace_open(p);
+  output = output + _cpp_profile_open(p);
   output = output + "};\n";
   output = output + name + "::~" + name + "() {}\n\n";
   return output;
@@ -37,13 +77,15 @@ std::string _cpp_expr(Expr *e) {
 
 /*
   Adds statements.
-  This will switch between three cases:
+  This will switch between four cases:
     1. No statements.
     2. A statement that LHS is on the platform and thus uses `platform->set_*` where * is the variable name.
-    3. A statement that LHS is on the Machine and thus uses `this->*` where * is the variable name.
+    3. A statement that LHS is a local (see optimizer.h), declared where it is first assigned.
+    4. A statement that LHS is on the Machine and thus uses `this->*` where * is the variable name.
 */
 std::string _cpp_stmts(Stmt *s) {
   std::string output("");
+  std::set<std::string> declared;
 
   if ( s->is_empty() ) {
     return "\t\t// No statements\n";
@@ -54,6 +96,12 @@ std::string _cpp_stmts(Stmt *s) {
     Variable *lhs = s->get_variable();
     if ( lhs->is_on_platform() ) {
       output = output + "\t\tplatform->set_" + lhs->get_name() + "(" + _cpp_expr(s->get_expr()) + ");\n";
+    } else if ( lhs->is_cached() ) {
+      output = output + "\t\t" + lhs->get_name() + " = " + _cpp_expr(s->get_expr()) + ";\n";
+    } else if ( lhs->is_local() ) {
+      std::string type("");
+      if ( declared.insert(lhs->get_name()).second ) type = lhs->get_local_type() + " ";
+      output = output + "\t\t" + type + lhs->get_name() + " = " + _cpp_expr(s->get_expr()) + ";\n";
     } else {
       output = output + "\t\tthis->" + lhs->get_name() + " = " + _cpp_expr(s->get_expr()) + ";\n";  
     }
@@ -78,27 +126,32 @@ std::string _cpp_stmts(Stmt *s) {
       A. If the transition case is an "exit", no Fn() is added.
       B. Otherwise, the next State Fn() is added.
 */
-std::string _cpp_transitions(Transition *t) {
+std::string _cpp_transitions(Program *p, State *s) {
   std::string output("");
+  Transition *t = s->get_transition();
 
   if ( t->is_empty() ) {
     return "\n\t\t// No transitions\n";
   }
 
   bool first = true;
+  int index = 0;
 
   while ( t ) {
 
-    std::string ask("");
-    if (first) ask = "\tif ";
-      else ask = "else if "; 
+    if ( ! _cpp_emitted(p, s, t) ) {
+      t = t->get_next();
+      index++;
+      continue;
+    }
 
-    output = output + ask + "(" + _cpp_expr(t->get_expr()) + ") {\n";
+    output = output + _cpp_branch(p, s, t, index, first, "\t");
 
     if ( t->is_exit() ) {
 
       // stmts
-      output = output + _cpp_stmts( t->get_stmt() );
+      output = output + _cpp_actions(p, s, t);
+      output = output + _cpp_trace(p, s, t, index);
       // no method call to elsewhere, hence exit
       output = output + "\t\tplatform->next_state();\n";
       //but call next_state anyway because it sucks
@@ -106,7 +159,8 @@ std::string _cpp_transitions(Transition *t) {
     } else {
 
       // stmts
-      output = output + _cpp_stmts( t->get_stmt() );
+      output = output + _cpp_actions(p, s, t);
+      output = output + _cpp_trace(p, s, t, index);
 
       // call next method
       output = output + "\t\tplatform->next_state();\n";
@@ -116,6 +170,7 @@ std::string _cpp_transitions(Transition *t) {
     output = output + "\t} "; 
 
     t = t->get_next();
+    index++;
     if (first) first = false;
   }
 
@@ -141,19 +196,249 @@ std::string _cpp_states(Program *p) {
   }
 
   while ( s ) {   
-    output = output + "void " + p->get_variable()->get_name() + "::" + s->get_variable()->get_name() + "() {\n";
+    output = output + _cpp_state(p, s);
+    s = s->get_next();
+  }
 
-    output = output + "\tplatform->enter_state();\n\n";
-    Transition *t = s->get_transition();
-    output = output + _cpp_transitions(t);
+  return output;
+
+}
+
+/*
+  Adds the function of one State, or its loop (see _cpp_loop_state).
+*/
+std::string _cpp_state(Program *p, State *s) {
+  std::string output("");
 
+  if ( _loops(p, s) ) {
+    return _cpp_loop_state(p, s);
+  }
 
-    output = output + "}\n\n";
-    s = s->get_next();
+  output = output + "void " + p->get_variable()->get_name() + "::" + s->get_variable()->get_name() + "() {\n";
+
+  output = output + _cpp_profile_enter(p, s);
+  output = output + "\tplatform->enter_state();\n\n";
+  output = output + _cpp_transitions(p, s);
+
+  output = output + "}\n\n";
+  return output;
+}
+
+/*
+  Split translation units (cffc --split=N).
+
+  With the recursive backend each State is a function of its own, so the
+  States can be compiled apart. Machine.cpp keeps the constructor and
+  main(), and the State functions go to Machine_1.cpp up to Machine_N.cpp,
+  which make -j compiles at once. Machine.mk lists them for Makefile_Robot.
+
+  The parts are runs of States in the order they are written, cut where
+  the emitted code so far passes the next N-th of the total, so they come
+  out about the same size. Keeping the order means an edit to one State
+  changes its own part, and at most moves a cut next to it.
+*/
+
+/*
+  Adds Machine.cpp of a split Machine: everything but the States.
+*/
+std::string _cpp_split_main(Program *p) {
+  std::string output("");
+  output = output + _cpp_includes(p);
+  output = output + _cpp_constructor_deconstructor(p);
+  output = output + _cpp_shared(p);
+  output = output + _cpp_main(p);
+  return output;
+}
+
+/*
+  Adds the parts of a split Machine, at most n and at least one.
+*/
+std::vector<std::string> _cpp_split_parts(Program *p, int n) {
+  std::vector<std::string> states;
+  unsigned long total = 0;
+  for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+    states.push_back(_cpp_state(p, s));
+    total += states.back().size();
+  }
+
+  std::vector<std::string> parts;
+  std::string part("");
+  unsigned long done = 0;
+  for ( unsigned int k = 0; k < states.size(); k++ ) {
+    part += states[k];
+    done += states[k].size();
+    if ( done * n >= total * ( parts.size() + 1 ) && k + 1 < states.size() ) {
+      parts.push_back(part);
+      part = "";
+    }
+  }
+  parts.push_back(part);
+
+  for ( unsigned int k = 0; k < parts.size(); k++ ) {
+    parts[k] = "#include \"Platform.h\"\n#include \"Machine.h\"\n\n" + parts[k];
+  }
+  return parts;
+}
+
+/*
+  Adds Machine.mk, the rules for the parts of a split Machine.
+*/
+std::string _split_makefile(Program *p, int parts) {
+  std::string output("");
+  output = output + "# The parts of " + p->get_variable()->get_name() + ", written by cffc --split; see Makefile_Robot.\n";
+  output = output + "MACHINE_PARTS =";
+  for ( int k = 1; k <= parts; k++ ) {
+    output = output + " Machine_" + _int_to_string(k) + ".o";
+  }
+  output = output + "\n";
+  for ( int k = 1; k <= parts; k++ ) {
+    std::string part("Machine_" + _int_to_string(k));
+    output = output + "\n" + part + ".o:\t" + part + ".cpp Machine.h Platform.h\n";
+    output = output + "\tg++ $(OPT) -c " + part + ".cpp\n";
+  }
+  return output;
+}
+
+/*
+  Self loops.
+
+  A State with a transition to itself would call itself once per step. When
+  optimizing, the recursive backend emits it as a loop instead: the State
+  function loops until it takes a transition elsewhere. Every step still
+  calls enter_state and next_state, since the platforms print there.
+
+  The Machine variables the State uses are kept in locals while it loops,
+  so they can live in registers: the platform calls in between would
+  otherwise make the compiler reload them from the Machine every step.
+  The ones the State assigns are written back before it leaves the loop.
+*/
+
+/*
+  True if the State is emitted as a loop.
+*/
+bool _loops(Program *p, State *s) {
+  if ( p->get_options()->backend != "recursive" || ! p->get_options()->optimize ) return false;
+  for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+    if ( t->is_exit() || ! _cpp_emitted(p, s, t) ) continue;
+    if ( t->get_variable()->get_name() == s->get_variable()->get_name() ) return true;
+  }
+  return false;
+}
+
+void _cache_variables(Expr *e, std::map<std::string, std::string> &members, std::set<std::string> &used) {
+  if ( is_node_type<Variable>(e) ) {
+    Variable *v = (Variable *)e;
+    if ( v->is_on_platform() || v->is_local() || members.find(v->get_name()) == members.end() ) return;
+    v->set_cached(true);
+    used.insert(v->get_name());
+  } else if ( is_node_type<Operator>(e) ) {
+    _cache_variables(((Operator *)e)->get_left(), members, used);
+    _cache_variables(((Operator *)e)->get_right(), members, used);
+  } else if ( is_node_type<Comparison>(e) ) {
+    _cache_variables(((Comparison *)e)->get_left(), members, used);
+    _cache_variables(((Comparison *)e)->get_right(), members, used);
   }
+}
 
+/*
+  Adds the assignments that write the cached Machine variables back.
+*/
+std::string _cpp_write_back(std::vector<std::string> &written, std::string indent) {
+  std::string output("");
+  for ( unsigned int k = 0; k < written.size(); k++ ) {
+    output = output + indent + "this->" + written[k] + " = " + written[k] + ";\n";
+  }
   return output;
+}
+
+/*
+  Adds a State that loops on its self transitions.
+*/
+std::string _cpp_loop_state(Program *p, State *s) {
+  std::string output("");
+  std::string name(s->get_variable()->get_name());
+
+  // the Machine variables, and which of them the State uses and assigns
+  std::map<std::string, std::string> members;
+  std::vector<std::string> order;
+  DeclList *d = p->get_decls();
+  while ( is_node_type<SeqDecl>(d) ) {
+    Decl *decl = ((SeqDecl *)d)->get_decl();
+    if ( ! decl->get_variable()->is_local() ) {
+      members[decl->get_variable()->get_name()] = decl->get_type()->get_type();
+      order.push_back(decl->get_variable()->get_name());
+    }
+    d = ((SeqDecl *)d)->get_tail();
+  }
+
+  std::set<std::string> used;
+  std::set<std::string> assigned;
+  for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+    _cache_variables(t->get_expr(), members, used);
+    std::vector<Stmt *> blocks = t->get_fused();
+    blocks.insert(blocks.begin(), t->get_stmt());
+    for ( unsigned int k = 0; k < blocks.size(); k++ ) {
+      for ( Stmt *st = blocks[k]; st && !st->is_empty(); st = st->get_next() ) {
+        Variable *lhs = st->get_variable();
+        _cache_variables(lhs, members, used);
+        if ( lhs->is_cached() ) assigned.insert(lhs->get_name());
+        _cache_variables(st->get_expr(), members, used);
+      }
+    }
+  }
+
+  std::vector<std::string> written;
+  output = output + "void " + p->get_variable()->get_name() + "::" + name + "() {\n";
+  for ( unsigned int k = 0; k < order.size(); k++ ) {
+    if ( used.count(order[k]) ) output = output + "\t" + members[order[k]] + " " + order[k] + " = this->" + order[k] + ";\n";
+    if ( assigned.count(order[k]) ) written.push_back(order[k]);
+  }
+  output = output + "\tfor (;;) {\n";
+  output = output + _cpp_profile_enter(p, s);
+  output = output + "\tplatform->enter_state();\n\n";
+
+  Transition *t = s->get_transition();
+  bool first = true;
+  bool covered = false;
+  int index = 0;
+  while ( t && !t->is_empty() ) {
+
+    if ( ! _cpp_emitted(p, s, t) ) {
+      t = t->get_next();
+      index++;
+      continue;
+    }
+    if ( t->is_always() && ! p->get_options()->profile ) covered = true;
+
+    output = output + _cpp_branch(p, s, t, index, first, "\t");
+    output = output + _cpp_actions(p, s, t);
+    output = output + _cpp_trace(p, s, t, index);
+    output = output + "\t\tplatform->next_state();\n";
+
+    if ( ! t->is_exit() && t->get_variable()->get_name() == name ) {
+      output = output + "\t\tcontinue;\n";
+    } else {
+      output = output + _cpp_write_back(written, "\t\t");
+      if ( ! t->is_exit() ) output = output + "\t\t" + t->get_variable()->get_name() + "();\n";
+      output = output + "\t\treturn;\n";
+    }
+
+    output = output + "\t} ";
+
+    t = t->get_next();
+    index++;
+    first = false;
+  }
 
+  // no transition was taken
+  output = output + "\n";
+  if ( ! covered ) {
+    output = output + _cpp_write_back(written, "\t");
+    output = output + "\treturn;\n";
+  }
+  output = output + "\t}\n";
+  output = output + "}\n\n";
+  return output;
 }
 
 /*
@@ -195,54 +480,252 @@ std::string _cpp_main(Program *p) {
 }
 
 /*
-  Below are generic header generate functions.
+  Adds the Machine.cpp of a Machine that cffc ran at compile time (see
+  evaluator.h): main() only prints what the Machine printed.
 */
+std::string _cpp_evaluated(Program *p, std::string printed) {
+  std::string output("");
 
-std::string _header_ifndef_open() {
-  return "#ifndef MACHINE_H\n#define MACHINE_H\n";
+  output = output + "#include <stdio.h>\n";
+  output = output + "#include \"Platform.h\"\n";
+  output = output + "#include \"Machine.h\"\n\n";
+  output = output + "// " + p->get_variable()->get_name() + " takes no input: this is what it prints on every run.\n";
+  output = output + "static const char output[] =\n";
+  output = output + "\t\"";
+  // appended in place, the output can be large
+  for ( unsigned int k = 0; k < printed.size(); k++ ) {
+    unsigned char c = printed[k];
+    if ( c == '\n' ) {
+      output += "\\n\"";
+      if ( k + 1 < printed.size() ) output += "\n\t\"";
+      continue;
+    }
+    if ( c == '"' || c == '\\' ) {
+      output += '\\';
+      output += (char) c;
+    } else if ( c < ' ' || c >= 127 ) {
+      char octal[5];
+      snprintf(octal, sizeof(octal), "\\%03o", c);
+      output += octal;
+    } else {
+      output += (char) c;
+    }
+  }
+  if ( printed.empty() || printed[printed.size() - 1] != '\n' ) output = output + "\"";
+  output = output + ";\n\n";
+
+  output = output + "int main(int argc, char **argv) {\n";
+  output = output + "\tfwrite(output, 1, sizeof(output) - 1, stdout);\n";
+  output = output + "\treturn 0;\n";
+  output = output + "}\n";
+  return output;
 }
-std::string _header_ifndef_close() {
-  return "#endif\n";
+
+/*
+  Below are the batch kernel generate functions.
+
+  A Machine with a single State that goes back to itself on every step,
+  keeps nothing from one step to the next and only maps the input of an
+  IntegerStreamComputer to its output is an elementwise map. The recursive
+  backend emits it as a kernel over whole blocks of inputs, which the
+  compiler can vectorize, and run_stream_batch in cffc/Platform.h parses
+  and prints the blocks around it.
+*/
+
+/*
+  True if an Expr only reads the input and constants, and can not trap:
+  a divisor must be a constant other than 0 and -1.
+*/
+bool _batch_maps(Expr *e) {
+  if ( is_node_type<Variable>(e) ) {
+    Variable *v = (Variable *)e;
+    return v->is_on_platform() && v->get_name() == "input";
+  } else if ( is_node_type<Operator>(e) ) {
+    Operator *o = (Operator *)e;
+    if ( is_node_type<Divide>(o) ) {
+      Expr *r = o->get_right();
+      if ( ! is_node_type<Number>(r) ) return false;
+      double d = atof(((Constant *)r)->get_value().c_str());
+      if ( d == 0 || d == -1 ) return false;
+    }
+    return _batch_maps(o->get_left()) && _batch_maps(o->get_right());
+  } else if ( is_node_type<Comparison>(e) ) {
+    Comparison *c = (Comparison *)e;
+    return _batch_maps(c->get_left()) && _batch_maps(c->get_right());
+  } else if ( is_node_type<Constant>(e) ) {
+    return ! is_node_type<String>(e);
+  }
+  return false;
 }
-std::string _header_machine_class_open(Program *p) {
-  return "class " + p->getName() + " { \n";
+
+/*
+  True if the Machine is emitted as a batch kernel: optimized for the
+  recursive backend, without --trace or --profile, on an IntegerStreamComputer,
+  and its only State always goes back to itself, assigning the output from
+  the input and nothing else.
+*/
+bool _batches(Program *p) {
+  Options *o = p->get_options();
+  if ( ! o->optimize || ! o->batch || o->backend != "recursive" || o->trace || o->profile ) return false;
+  if ( p->get_platform()->get_variable()->get_name() != "IntegerStreamComputer" ) return false;
+
+  State *s = p->get_states();
+  if ( ! s || s->is_empty() || ! s->is_initial() ) return false;
+  if ( s->get_next() && ! s->get_next()->is_empty() ) return false;
+
+  Transition *t = s->get_transition();
+  while ( t && !t->is_empty() && t->is_never() ) t = t->get_next();
+  if ( ! t || t->is_empty() || ! t->is_always() || t->is_exit() ) return false;
+  if ( t->get_variable()->get_name() != s->get_variable()->get_name() ) return false;
+  if ( ! t->get_fused().empty() ) return false;
+
+  bool outputs = false;
+  for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) {
+    Variable *lhs = st->get_variable();
+    if ( ! lhs->is_on_platform() || lhs->get_name() != "output" ) return false;
+    if ( ! _batch_maps(st->get_expr()) ) return false;
+    outputs = true;
+  }
+  return outputs;
 }
-std::string _header_machine_public() {
-  return "\tpublic: \n";
+
+/*
+  Adds an Expr evaluated for element k of the block.
+*/
+std::string _batch_expr(Expr *e) {
+  if ( is_node_type<Variable>(e) ) {
+    return "input[k]";
+  } else if ( is_node_type<Operator>(e) ) {
+    Operator *o = (Operator *)e;
+    return "( " + _batch_expr(o->get_left()) + " " + o->get_operator() + " " + _batch_expr(o->get_right()) + " )";
+  } else if ( is_node_type<Comparison>(e) ) {
+    Comparison *c = (Comparison *)e;
+    return "( " + _batch_expr(c->get_left()) + " " + c->get_operator() + " " + _batch_expr(c->get_right()) + " )";
+  }
+  return ((Constant *)e)->get_value();
 }
-std::string _header_machine_constructor_deconstructor(Program *p) {
+
+/*
+  Adds the kernel and the main() that hands it to run_stream_batch.
+  Only the last assignment to the output is kept, it is the one printed.
+*/
+std::string _cpp_batch(Program *p) {
   std::string output("");
-  output = output + "\t\t" + p->get_variable()->get_name() + "(" + p->get_platform()->get_variable()->get_name() + " *platform);\n";
-  output = output + "\t\t~" + p->get_variable()->get_name() + "();\n";
+  std::string name(p->get_variable()->get_name());
+  Transition *t = p->get_states()->get_transition();
+  while ( t->is_never() ) t = t->get_next();
+
+  Stmt *last = NULL;
+  for ( Stmt *st = t->get_stmt(); st && !st->is_empty(); st = st->get_next() ) {
+    last = st;
+  }
+
+  output = output + "\n// " + name + " maps every input on its own, a block at a time.\n";
+  output = output + "static void " + name + "_kernel(const int * __restrict input, int * __restrict output, int n) {\n";
+  output = output + "\tfor (int block = 0; block < n; block += BATCH_WIDTH) {\n";
+  output = output + "\t\tfor (int k = block; k < block + BATCH_WIDTH; k++) {\n";
+  output = output + "\t\t\toutput[k] = " + _batch_expr(last->get_expr()) + ";\n";
+  output = output + "\t\t}\n";
+  output = output + "\t}\n";
+  output = output + "}\n\n";
+
+  output = output + "int main(int argc, char **argv) {\n";
+  output = output + "\treturn run_stream_batch(argc, argv, " + name + "_kernel);\n";
+  output = output + "}\n";
   return output;
 }
-std::string _header_machine_private(Program *p) {
+
+/*
+  Below are the stepping generate functions.
+  They are used by every backend where Options::is_stepping is true.
+
+  Instead of one State calling the next, each State function returns the
+  id of the next State and step() dispatches on `current_state`.
+  The machine is finished when step() returns false, which happens on an
+  exit, when no transition matched or when the platform halted.
+*/
+
+/*
+  Adds the State id of a State Variable, e.g. `state_Compute`.
+*/
+std::string _state_id(Variable *v) {
+  return "state_" + v->get_name();
+}
+
+/*
+  Adds the constructor and destructor for stepping backends.
+  The Machine starts in the initial State, or is finished right away without one.
+*/
+std::string _cpp_step_constructor_deconstructor(Program *p) {
   std::string output("");
-  output = output + "\tprivate:\n";
-  output = output + "\t\t" + p->get_platform()->get_variable()->get_name() + " *platform;\n";
+  std::string name(p->get_variable()->get_name());
+
+  State *s = p->get_states();
+  while ( s && !s->is_empty() && !s->is_initial() ) {
+    s = s->get_next();
+  }
+  std::string initial("state_exit");
+  if ( s && !s->is_empty() ) initial = _state_id(s->get_variable());
+
+  output = output + name + "::" + name + "(" + p->get_platform()->get_variable()->get_name() + " *p) {\n";
+  output = output + "\tthis->platform = p;\n";
+  output = output + _cpp_trace_open(p);
+  output = output + _cpp_profile_open(p);
+  output = output + "\tthis->current_state = " + initial + ";\n";
+  output = output + "};\n";
+  output = output + name + "::~" + name + "() {}\n\n";
   return output;
 }
-std::string _header_machine_class_close() {
-  return "};\n\n";
-}
-std::string _header_machine_main() {
-  return "int main(int argc, char **argv);\n\n";
-}
 
-std::string _header_machine_decls(Program *p) {
+/*
+  Like _cpp_transitions, but the matched branch returns the next State id
+  rather than calling it. Falling through all branches finishes the Machine.
+*/
+std::string _cpp_step_transitions(Program *p, State *s) {
   std::string output("");
+  Transition *t = s->get_transition();
 
-  DeclList *d = p->get_decls();
+  if ( t->is_empty() ) {
+    return "\n\t\t// No transitions\n\treturn state_exit;\n";
+  }
 
-  while ( is_node_type<SeqDecl>(d) ) {
-    output = output + ((SeqDecl *)d)->cppCode_h();
-    d = ((SeqDecl *)d)->get_tail();
+  bool first = true;
+  int index = 0;
+
+  while ( t ) {
+
+    if ( ! _cpp_emitted(p, s, t) ) {
+      t = t->get_next();
+      index++;
+      continue;
+    }
+
+    output = output + _cpp_branch(p, s, t, index, first, "\t");
+    output = output + _cpp_actions(p, s, t);
+    output = output + _cpp_trace(p, s, t, index);
+    output = output + "\t\tplatform->next_state();\n";
+
+    if ( t->is_exit() ) {
+      output = output + "\t\treturn state_exit;\n";
+    } else {
+      output = output + "\t\treturn " + _state_id(t->get_variable()) + ";\n";
+    }
+
+    output = output + "\t} ";
+
+    t = t->get_next();
+    index++;
+    if (first) first = false;
   }
 
+  output = output + "\n\treturn state_exit;\n";
   return output;
 }
-std::string _header_machine_states(Program *p) {
 
+/*
+  Adds the State functions for stepping backends.
+*/
+std::string _cpp_step_states(Program *p) {
   std::string output("");
 
   State *s = p->get_states();
@@ -253,7 +736,1291 @@ std::string _header_machine_states(Program *p) {
   }
 
   while ( s ) {
-    output = output + "\t\tvoid " + s->get_variable()->get_name() + "();\n";
+    output = output + "int " + p->get_variable()->get_name() + "::" + s->get_variable()->get_name() + "() {\n";
+    output = output + _cpp_profile_enter(p, s);
+    output = output + "\tplatform->enter_state();\n\n";
+    output = output + _cpp_step_transitions(p, s);
+    output = output + "}\n\n";
+    s = s->get_next();
+  }
+
+  return output;
+}
+
+/*
+  Adds step(), which runs the current State once.
+*/
+std::string _cpp_step(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+
+  output = output + "bool " + name + "::step() {\n";
+  output = output + "\tswitch ( this->current_state ) {\n";
+
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + "\t\tcase " + _state_id(s->get_variable()) + ": this->current_state = " + s->get_variable()->get_name() + "(); break;\n";
+    s = s->get_next();
+  }
+
+  output = output + "\t\tdefault: return false;\n";
+  output = output + "\t}\n";
+  output = output + "\treturn ( this->current_state != state_exit && !platform->is_halted() );\n";
+  output = output + "}\n\n";
+  return output;
+}
+
+/*
+  Adds the main() for the runner backend.
+  All of the work (instances, threads, output) is done by run_machines in Runner.h.
+*/
+std::string _cpp_runner_main(Program *p) {
+  std::string output("");
+
+  output = output + "int main(int argc, char **argv) {\n";
+  output = output + "\treturn run_machines<" + p->get_platform()->get_variable()->get_name() + ", " + p->get_variable()->get_name() + ">(argc, argv);\n";
+  output = output + "}\n";
+
+  return output;
+}
+
+/*
+  Adds the C ABI of cffc/Swap.h for the swap backend, in place of main(): the
+  Machine is built as a shared object and stepped by swap_host. Besides
+  creating and stepping the Machine, it names the variables and the States,
+  which is all the host needs to carry a running Machine over to a new version.
+*/
+std::string _cpp_swap_abi(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+  std::string platform(p->get_platform()->get_variable()->get_name());
+  std::string machine("\t" + name + " *m = (" + name + " *) machine;\n");
+
+  std::vector<Decl *> decls;
+  DeclList *d = p->get_decls();
+  while ( is_node_type<SeqDecl>(d) ) {
+    decls.push_back(((SeqDecl *)d)->get_decl());
+    d = ((SeqDecl *)d)->get_tail();
+  }
+
+  output = output + "static const cff_variable variables[] = {\n";
+  for ( unsigned int k = 0; k < decls.size(); k++ ) {
+    output = output + "\t{ \"" + decls[k]->get_variable()->get_name() + "\", \"" + decls[k]->get_type()->get_type() + "\" },\n";
+  }
+  output = output + "\t{ NULL, NULL }\n";
+  output = output + "};\n\n";
+
+  output = output + "int cff_abi(void) { return CFF_SWAP_ABI; }\n";
+  output = output + "const char *cff_platform(void) { return \"" + platform + "\"; }\n";
+  output = output + "void *cff_create(void *platform) { return new " + name + "((" + platform + " *) platform); }\n";
+  output = output + "void cff_destroy(void *machine) { delete (" + name + " *) machine; }\n";
+  output = output + "int cff_step(void *machine) { return ((" + name + " *) machine)->step(); }\n";
+  output = output + "int cff_variables(const cff_variable **v) { *v = variables; return " + _int_to_string(decls.size()) + "; }\n\n";
+
+  output = output + "double cff_get(void *machine, int variable) {\n" + machine;
+  output = output + "\tswitch ( variable ) {\n";
+  for ( unsigned int k = 0; k < decls.size(); k++ ) {
+    output = output + "\t\tcase " + _int_to_string(k) + ": return m->" + decls[k]->get_variable()->get_name() + ";\n";
+  }
+  output = output + "\t}\n";
+  output = output + "\treturn 0;\n";
+  output = output + "}\n\n";
+
+  output = output + "void cff_set(void *machine, int variable, double value) {\n" + machine;
+  output = output + "\tswitch ( variable ) {\n";
+  for ( unsigned int k = 0; k < decls.size(); k++ ) {
+    output = output + "\t\tcase " + _int_to_string(k) + ": m->" + decls[k]->get_variable()->get_name() + " = (" + decls[k]->get_storage() + ") value; break;\n";
+  }
+  output = output + "\t}\n";
+  output = output + "}\n\n";
+
+  output = output + "const char *cff_state(void *machine) {\n" + machine;
+  output = output + "\tswitch ( m->current_state ) {\n";
+  for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+    output = output + "\t\tcase " + name + "::" + _state_id(s->get_variable()) + ": return \"" + s->get_variable()->get_name() + "\";\n";
+  }
+  output = output + "\t}\n";
+  output = output + "\treturn NULL;\n";
+  output = output + "}\n\n";
+
+  output = output + "int cff_set_state(void *machine, const char *state) {\n" + machine;
+  for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+    output = output + "\tif ( strcmp(state, \"" + s->get_variable()->get_name() + "\") == 0 ) { m->current_state = " + name + "::" + _state_id(s->get_variable()) + "; return 1; }\n";
+  }
+  output = output + "\treturn 0;\n";
+  output = output + "}\n";
+
+  return output;
+}
+
+/*
+  Checks that a Machine can be simulated. Returns an error message, or "" when it can.
+*/
+std::string _simulation_check(Program *p) {
+  PlatformTraits traits = _platform_traits(p->get_platform()->get_variable()->get_name());
+
+  if ( ! traits.simulated ) {
+    return "The simulation backend needs a platform with a simulated version (PositionalRobot).";
+  }
+  return "";
+}
+
+/*
+  Adds the main() for the simulation backend.
+  The fleet, the virtual clock and the output are handled by run_simulation in Simulation.h.
+*/
+std::string _cpp_simulation_main(Program *p) {
+  std::string output("");
+
+  output = output + "int main(int argc, char **argv) {\n";
+  output = output + "\treturn run_simulation<Simulated" + p->get_platform()->get_variable()->get_name() + ", " + p->get_variable()->get_name() + ">(argc, argv);\n";
+  output = output + "}\n";
+
+  return output;
+}
+
+/*
+  Adds the State ids, `current_state` and step() to the Machine class.
+*/
+std::string _header_machine_step(Program *p) {
+  std::string output("");
+
+  output = output + "\t\tenum { ";
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + _state_id(s->get_variable()) + ", ";
+    s = s->get_next();
+  }
+  output = output + "state_exit };\n";
+
+  output = output + "\t\tint current_state;\n";
+  output = output + "\t\tbool step();\n";
+  return output;
+}
+
+/*
+  Below are the platform traits.
+  The translator only knows the hand-written platforms of cffc/Platform.h by name,
+  so what it needs to know about their sensors and actuators is written down here.
+*/
+
+PlatformTraits::PlatformTraits() {
+  this->name = "";
+  this->numeric = false;
+  this->async = false;
+  this->simulated = false;
+}
+
+PlatformTraits _platform_traits(std::string name) {
+  PlatformTraits traits;
+  traits.name = name;
+
+  if ( name == "IntegerComputer" || name == "IntegerStreamComputer" ) {
+    traits.fields["input"] = "int";
+    traits.fields["output"] = "int";
+    traits.numeric = true;
+    traits.async = ( name == "IntegerStreamComputer" );
+  } else if ( name == "PositionalRobot" ) {
+    traits.fields["xPos"] = "float";
+    traits.fields["yPos"] = "float";
+    traits.numeric = true;
+    traits.simulated = true;
+  } else if ( name == "RegexRecognizer" ) {
+    traits.fields["nextChar"] = "char";
+    traits.fields["outputBuffer"] = "std::string";
+    traits.async = true;
+  }
+
+  return traits;
+}
+
+/*
+  Below are the lockstep generate functions (cffc --lockstep).
+
+  Every Machine variable and platform field becomes an array with one element per lane,
+  see cffc/Lanes.h. step() runs one step of every lane: for each State that some lane is
+  in, one loop over all lanes evaluates the guards as masks and blends the actions in,
+  so the loop has no branches and GCC vectorizes it. Lanes in other States are masked out.
+  States whose guards or actions divide fall back to a branchy loop, since a masked-out
+  lane could divide by zero.
+*/
+
+/*
+  Checks that a Machine can be run in lockstep. Returns an error message, or "" when it can.
+*/
+std::string _lanes_check_expr(Expr *e, PlatformTraits *traits) {
+  if ( is_node_type<Variable>(e) ) {
+    Variable *v = (Variable *)e;
+    if ( v->is_on_platform() && traits->fields.find(v->get_name()) == traits->fields.end() ) {
+      return "\"" + v->get_name() + "\" is not a sensor or actuator of " + traits->name + ".";
+    }
+  } else if ( is_node_type<String>(e) || is_node_type<Char>(e) ) {
+    return "The lockstep backend only supports numeric constants.";
+  } else if ( is_node_type<Operator>(e) ) {
+    std::string error = _lanes_check_expr( ((Operator *)e)->get_left(), traits );
+    if ( error.empty() ) error = _lanes_check_expr( ((Operator *)e)->get_right(), traits );
+    return error;
+  } else if ( is_node_type<Comparison>(e) ) {
+    std::string error = _lanes_check_expr( ((Comparison *)e)->get_left(), traits );
+    if ( error.empty() ) error = _lanes_check_expr( ((Comparison *)e)->get_right(), traits );
+    return error;
+  }
+  return "";
+}
+
+std::string _lanes_check(Program *p) {
+  PlatformTraits traits = _platform_traits(p->get_platform()->get_variable()->get_name());
+
+  if ( ! traits.numeric ) {
+    return "The lockstep backend needs a numeric platform (IntegerComputer, IntegerStreamComputer or PositionalRobot).";
+  }
+
+  DeclList *d = p->get_decls();
+  while ( is_node_type<SeqDecl>(d) ) {
+    std::string type( ((SeqDecl *)d)->get_decl()->get_type()->get_type() );
+    if ( type != "int" && type != "float" ) {
+      return "The lockstep backend only supports int and float variables.";
+    }
+    d = ((SeqDecl *)d)->get_tail();
+  }
+
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    Transition *t = s->get_transition();
+    while ( t && !t->is_empty() ) {
+      std::string error = _lanes_check_expr(t->get_expr(), &traits);
+
+      Stmt *st = t->get_stmt();
+      while ( error.empty() && st && !st->is_empty() ) {
+        error = _lanes_check_expr(st->get_variable(), &traits);
+        if ( error.empty() ) error = _lanes_check_expr(st->get_expr(), &traits);
+        st = st->get_next();
+      }
+
+      if ( ! error.empty() ) return error;
+      t = t->get_next();
+    }
+    s = s->get_next();
+  }
+
+  return "";
+}
+
+/*
+  Adds the lane element of a Variable, e.g. `m_i[lane]` or `p_input[lane]`.
+*/
+std::string _lanes_variable(Variable *v) {
+  if ( v->is_on_platform() ) {
+    return "p_" + v->get_name() + "[lane]";
+  } else {
+    return "m_" + v->get_name() + "[lane]";
+  }
+}
+
+/*
+  Adds an Expr evaluated for one lane.
+*/
+std::string _lanes_expr(Expr *e) {
+  if ( is_node_type<Variable>(e) ) {
+    return _lanes_variable((Variable *)e);
+  } else if ( is_node_type<Operator>(e) ) {
+    Operator *o = (Operator *)e;
+    return "( " + _lanes_expr(o->get_left()) + " " + o->get_operator() + " " + _lanes_expr(o->get_right()) + " )";
+  } else if ( is_node_type<Comparison>(e) ) {
+    Comparison *c = (Comparison *)e;
+    return "( " + _lanes_expr(c->get_left()) + " " + c->get_operator() + " " + _lanes_expr(c->get_right()) + " )";
+  } else if ( is_node_type<Constant>(e) ) {
+    return ((Constant *)e)->get_value();
+  }
+  return "";
+}
+
+bool _lanes_divides(Expr *e) {
+  if ( is_node_type<Divide>(e) ) return true;
+  if ( is_node_type<Operator>(e) ) {
+    return _lanes_divides( ((Operator *)e)->get_left() ) || _lanes_divides( ((Operator *)e)->get_right() );
+  }
+  if ( is_node_type<Comparison>(e) ) {
+    return _lanes_divides( ((Comparison *)e)->get_left() ) || _lanes_divides( ((Comparison *)e)->get_right() );
+  }
+  return false;
+}
+
+bool _lanes_divides(State *s) {
+  Transition *t = s->get_transition();
+  while ( t && !t->is_empty() ) {
+    if ( _lanes_divides(t->get_expr()) ) return true;
+    Stmt *st = t->get_stmt();
+    while ( st && !st->is_empty() ) {
+      if ( _lanes_divides(st->get_expr()) ) return true;
+      st = st->get_next();
+    }
+    t = t->get_next();
+  }
+  return false;
+}
+
+std::string _lanes_target(Transition *t) {
+  if ( t->is_exit() ) return "state_exit";
+  return _state_id(t->get_variable());
+}
+
+/*
+  Adds the loop over all lanes for one State.
+*/
+std::string _cpp_lanes_state(Program *p, State *s) {
+  std::string output("");
+  std::string id(_state_id(s->get_variable()));
+  Transition *t;
+  int n;
+
+  output = output + "\t// " + s->get_variable()->get_name() + "\n";
+  output = output + "\tif ( occupied[" + id + "] ) {\n";
+  output = output + "\t\tfor (int lane = 0; lane < lanes; lane++) {\n";
+
+  if ( _lanes_divides(s) ) {
+
+    output = output + "\t\t\tif ( state[lane] != " + id + " ) continue;\n";
+
+    bool first = true;
+    t = s->get_transition();
+    while ( t && !t->is_empty() ) {
+      if ( ! _cpp_emitted(p, s, t) ) {
+        t = t->get_next();
+        continue;
+      }
+      output = output + "\t\t\t" + (first ? "if " : "else if ") + "( " + _lanes_expr(t->get_expr()) + " ) {\n";
+      Stmt *st = t->get_stmt();
+      while ( st && !st->is_empty() ) {
+        output = output + "\t\t\t\t" + _lanes_variable(st->get_variable()) + " = " + _lanes_expr(st->get_expr()) + ";\n";
+        st = st->get_next();
+      }
+      output = output + "\t\t\t\tnext[lane] = " + _lanes_target(t) + ";\n";
+      output = output + "\t\t\t\tfired[lane] = 1;\n";
+      output = output + "\t\t\t}\n";
+      first = false;
+      t = t->get_next();
+    }
+
+  } else {
+
+    output = output + "\t\t\tint rest = ( state[lane] == " + id + " );\n";
+
+    // the guards all see the values from before any action
+    n = 0;
+    t = s->get_transition();
+    while ( t && !t->is_empty() ) {
+      if ( ! _cpp_emitted(p, s, t) ) {
+        t = t->get_next();
+        continue;
+      }
+      std::string g("g" + _int_to_string(n));
+      output = output + "\t\t\tint " + g + " = rest & " + _lanes_expr(t->get_expr()) + ";\n";
+      output = output + "\t\t\trest = rest & !" + g + ";\n";
+      n++;
+      t = t->get_next();
+    }
+
+    n = 0;
+    t = s->get_transition();
+    while ( t && !t->is_empty() ) {
+      if ( ! _cpp_emitted(p, s, t) ) {
+        t = t->get_next();
+        continue;
+      }
+      std::string g("g" + _int_to_string(n));
+      Stmt *st = t->get_stmt();
+      while ( st && !st->is_empty() ) {
+        std::string lhs(_lanes_variable(st->get_variable()));
+        output = output + "\t\t\t" + lhs + " = " + g + " ? " + _lanes_expr(st->get_expr()) + " : " + lhs + ";\n";
+        st = st->get_next();
+      }
+      output = output + "\t\t\tnext[lane] = " + g + " ? " + _lanes_target(t) + " : next[lane];\n";
+      output = output + "\t\t\tfired[lane] = fired[lane] | " + g + ";\n";
+      n++;
+      t = t->get_next();
+    }
+  }
+
+  output = output + "\t\t}\n";
+  output = output + "\t}\n\n";
+  return output;
+}
+
+std::string _lanes_platform_name(Program *p) {
+  return p->get_platform()->get_variable()->get_name() + "Lanes";
+}
+
+/*
+  Adds the constructor and destructor. Every lane starts in the initial State,
+  unless the platform halted it already.
+*/
+std::string _cpp_lanes_constructor_deconstructor(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+
+  State *s = p->get_states();
+  while ( s && !s->is_empty() && !s->is_initial() ) {
+    s = s->get_next();
+  }
+  std::string initial("state_exit");
+  if ( s && !s->is_empty() ) initial = _state_id(s->get_variable());
+
+  output = output + name + "::" + name + "(" + _lanes_platform_name(p) + " *p) {\n";
+  output = output + "\tthis->platform = p;\n";
+  output = output + "\tthis->lanes = p->get_lanes();\n";
+
+  DeclList *d = p->get_decls();
+  while ( is_node_type<SeqDecl>(d) ) {
+    Decl *decl = ((SeqDecl *)d)->get_decl();
+    output = output + "\tthis->" + decl->get_variable()->get_name() + " = lane_array<" + decl->get_storage() + ">(this->lanes);\n";
+    d = ((SeqDecl *)d)->get_tail();
+  }
+
+  output = output + "\tthis->current_state = lane_array<int>(this->lanes);\n";
+  output = output + "\tthis->next = lane_array<int>(this->lanes);\n";
+  output = output + "\tthis->fired = lane_array<unsigned char>(this->lanes);\n";
+  output = output + "\tfor (int lane = 0; lane < this->lanes; lane++) {\n";
+  output = output + "\t\tthis->current_state[lane] = p->halted[lane] ? state_exit : " + initial + ";\n";
+  output = output + "\t}\n";
+  output = output + "};\n";
+
+  output = output + name + "::~" + name + "() {\n";
+  d = p->get_decls();
+  while ( is_node_type<SeqDecl>(d) ) {
+    output = output + "\tlane_free(this->" + ((SeqDecl *)d)->get_decl()->get_variable()->get_name() + ");\n";
+    d = ((SeqDecl *)d)->get_tail();
+  }
+  output = output + "\tlane_free(this->current_state);\n";
+  output = output + "\tlane_free(this->next);\n";
+  output = output + "\tlane_free(this->fired);\n";
+  output = output + "}\n\n";
+  return output;
+}
+
+/*
+  Adds step() for all lanes.
+*/
+std::string _cpp_lanes_step(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+  PlatformTraits traits = _platform_traits(p->get_platform()->get_variable()->get_name());
+
+  output = output + "CFFC_LANES_TARGETS\n";
+  output = output + "bool " + name + "::step() {\n";
+  output = output + "\tconst int lanes = this->lanes;\n";
+  output = output + "\tint * __restrict state = this->current_state;\n";
+  output = output + "\tint * __restrict next = this->next;\n";
+  output = output + "\tunsigned char * __restrict fired = this->fired;\n";
+
+  DeclList *d = p->get_decls();
+  while ( is_node_type<SeqDecl>(d) ) {
+    Decl *decl = ((SeqDecl *)d)->get_decl();
+    std::string v(decl->get_variable()->get_name());
+    output = output + "\t" + decl->get_storage() + " * __restrict m_" + v + " = this->" + v + ";\n";
+    d = ((SeqDecl *)d)->get_tail();
+  }
+
+  std::map<std::string, std::string>::iterator f;
+  for ( f = traits.fields.begin(); f != traits.fields.end(); f++ ) {
+    output = output + "\t" + f->second + " * __restrict p_" + f->first + " = platform->" + f->first + ";\n";
+  }
+  output = output + "\n";
+
+  output = output + "\t// how many lanes are in each State, States without lanes are skipped\n";
+  output = output + "\tint occupied[state_exit + 1] = { 0 };\n";
+  output = output + "\tfor (int lane = 0; lane < lanes; lane++) occupied[state[lane]]++;\n";
+  output = output + "\tif ( occupied[state_exit] == lanes ) return false;\n\n";
+
+  output = output + "\tplatform->enter_state(state, state_exit);\n";
+  output = output + "\tfor (int lane = 0; lane < lanes; lane++) {\n";
+  output = output + "\t\tnext[lane] = state_exit;\n";
+  output = output + "\t\tfired[lane] = 0;\n";
+  output = output + "\t}\n\n";
+
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + _cpp_lanes_state(p, s);
+    s = s->get_next();
+  }
+
+  output = output + "\tplatform->next_state(fired);\n";
+  output = output + "\tfor (int lane = 0; lane < lanes; lane++) {\n";
+  output = output + "\t\tstate[lane] = platform->halted[lane] ? state_exit : next[lane];\n";
+  output = output + "\t}\n";
+  output = output + "\treturn true;\n";
+  output = output + "}\n\n";
+  return output;
+}
+
+/*
+  Adds the main() for the lockstep backend, see run_lanes in cffc/Lanes.h.
+*/
+std::string _cpp_lanes_main(Program *p) {
+  std::string output("");
+  output = output + "int main(int argc, char **argv) {\n";
+  output = output + "\treturn run_lanes<" + _lanes_platform_name(p) + ", " + p->get_variable()->get_name() + ">(argc, argv);\n";
+  output = output + "}\n";
+  return output;
+}
+
+/*
+  Adds the body of the lockstep Machine class.
+*/
+std::string _header_lanes_machine(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+
+  output = output + "\t\t" + name + "(" + _lanes_platform_name(p) + " *platform);\n";
+  output = output + "\t\t~" + name + "();\n";
+
+  DeclList *d = p->get_decls();
+  while ( is_node_type<SeqDecl>(d) ) {
+    Decl *decl = ((SeqDecl *)d)->get_decl();
+    output = output + "\t\t" + decl->get_storage() + " *" + decl->get_variable()->get_name() + ";\n";
+    d = ((SeqDecl *)d)->get_tail();
+  }
+
+  output = output + "\t\tenum { ";
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + _state_id(s->get_variable()) + ", ";
+    s = s->get_next();
+  }
+  output = output + "state_exit };\n";
+  output = output + "\t\tint *current_state;\n";
+  output = output + "\t\tbool step();\n";
+
+  output = output + "\tprivate:\n";
+  output = output + "\t\t" + _lanes_platform_name(p) + " *platform;\n";
+  output = output + "\t\tint lanes;\n";
+  output = output + "\t\tint *next;\n";
+  output = output + "\t\tunsigned char *fired;\n";
+  return output;
+}
+
+/*
+  Below are the coroutine generate functions (cffc --coroutine).
+
+  run() is a C++20 coroutine with a `for(;;) switch` over `current_state`. Every State
+  starts by awaiting platform->enter_state_async(), which suspends the Machine until
+  the platform has sensor data, see the asynchronous RunTime in cffc/RunTime.h.
+  Only platforms with an asynchronous version can be used.
+*/
+
+/*
+  Checks that a Machine can be run as a coroutine. Returns an error message, or "" when it can.
+*/
+std::string _coroutine_check(Program *p) {
+  PlatformTraits traits = _platform_traits(p->get_platform()->get_variable()->get_name());
+
+  if ( ! traits.async ) {
+    return "The coroutine backend needs a platform with sensor input (IntegerStreamComputer or RegexRecognizer).";
+  }
+  return "";
+}
+
+/*
+  Adds the asynchronous platform class, e.g. `AsyncIntegerStreamComputer`.
+*/
+std::string _coroutine_platform_name(Program *p) {
+  return "Async" + p->get_platform()->get_variable()->get_name();
+}
+
+std::string _cpp_coroutine_constructor_deconstructor(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+
+  State *s = p->get_states();
+  while ( s && !s->is_empty() && !s->is_initial() ) {
+    s = s->get_next();
+  }
+  std::string initial("state_exit");
+  if ( s && !s->is_empty() ) initial = _state_id(s->get_variable());
+
+  output = output + name + "::" + name + "(" + _coroutine_platform_name(p) + " *p) {\n";
+  output = output + "\tthis->platform = p;\n";
+  output = output + _cpp_trace_open(p);
+  output = output + _cpp_profile_open(p);
+  output = output + "\tthis->current_state = " + initial + ";\n";
+  output = output + "};\n";
+  output = output + name + "::~" + name + "() {}\n\n";
+  return output;
+}
+
+/*
+  Adds one case of run(). A matched branch moves on to the next State,
+  an exit or falling through all branches finishes the Machine.
+*/
+std::string _cpp_coroutine_state(Program *p, State *s) {
+  std::string output("");
+
+  output = output + "\t\tcase " + _state_id(s->get_variable()) + ":\n";
+  output = output + "\t\tco_await platform->enter_state_async();\n";
+  output = output + "\t\tif ( platform->is_halted() ) co_return;\n";
+  output = output + _cpp_profile_enter(p, s);
+  output = output + "\n";
+
+  Transition *t = s->get_transition();
+  bool first = true;
+  int index = 0;
+
+  while ( t && !t->is_empty() ) {
+
+    if ( ! _cpp_emitted(p, s, t) ) {
+      t = t->get_next();
+      index++;
+      continue;
+    }
+
+    output = output + _cpp_branch(p, s, t, index, first, "\t\t");
+    output = output + _cpp_actions(p, s, t);
+    output = output + _cpp_trace(p, s, t, index);
+    output = output + "\t\tplatform->next_state();\n";
+
+    if ( t->is_exit() ) {
+      output = output + "\t\tco_return;\n";
+    } else {
+      output = output + "\t\tcurrent_state = " + _state_id(t->get_variable()) + ";\n";
+      output = output + "\t\tcontinue;\n";
+    }
+
+    output = output + "\t\t} ";
+
+    t = t->get_next();
+    index++;
+    if (first) first = false;
+  }
+
+  output = output + "\n\t\tco_return;\n\n";
+  return output;
+}
+
+/*
+  Adds run(), the whole Machine as one coroutine.
+*/
+std::string _cpp_coroutine_run(Program *p) {
+  std::string output("");
+
+  output = output + "MachineTask " + p->get_variable()->get_name() + "::run() {\n";
+  output = output + "\tfor (;;) switch ( this->current_state ) {\n";
+
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + _cpp_coroutine_state(p, s);
+    s = s->get_next();
+  }
+
+  output = output + "\t\tdefault:\n";
+  output = output + "\t\tco_return;\n";
+  output = output + "\t}\n";
+  output = output + "}\n\n";
+  return output;
+}
+
+/*
+  Adds the main() for the coroutine backend, see run_coroutines in cffc/RunTime.h.
+*/
+std::string _cpp_coroutine_main(Program *p) {
+  std::string output("");
+  output = output + "int main(int argc, char **argv) {\n";
+  output = output + "\treturn run_coroutines<" + _coroutine_platform_name(p) + ", " + p->get_variable()->get_name() + ">(argc, argv);\n";
+  output = output + "}\n";
+  return output;
+}
+
+/*
+  Adds the body of the coroutine Machine class.
+*/
+std::string _header_coroutine_machine(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+
+  output = output + "\t\t" + name + "(" + _coroutine_platform_name(p) + " *platform);\n";
+  output = output + "\t\t~" + name + "();\n";
+
+  output = output + _header_machine_decls(p);
+
+  output = output + "\t\tenum { ";
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + _state_id(s->get_variable()) + ", ";
+    s = s->get_next();
+  }
+  output = output + "state_exit };\n";
+  output = output + "\t\tint current_state;\n";
+  output = output + "\t\tMachineTask run();\n";
+
+  output = output + "\tprivate:\n";
+  output = output + "\t\t" + _coroutine_platform_name(p) + " *platform;\n";
+  return output;
+}
+
+/*
+  Below are the table generate functions (cffc --table).
+
+  For Machines with very many States, one function per State makes g++ slow
+  and the binary big. The table backend emits what each State does as data
+  instead: for every State the range of its transitions, and for every
+  transition a guard id, an action id and the index of the next State.
+  Guards and actions that read the same once emitted are shared, so
+  guard() and action() only hold one case per distinct one, and run() is
+  the same small loop for every Machine.
+
+  g++ takes far longer on one huge function than on many small ones, so the
+  cases of guard() and action() are split into chunks of TABLE_CHUNK, each
+  its own specialization of guards<chunk>() and actions<chunk>(). The header
+  only declares the templates, so it stays the same size too.
+*/
+#define TABLE_CHUNK 64
+
+/*
+  The smallest unsigned type that holds every value up to max.
+*/
+std::string _table_type(int max) {
+  if ( max <= 255 ) return "unsigned char";
+  if ( max <= 65535 ) return "unsigned short";
+  return "int";
+}
+
+/*
+  Adds a static table, sixteen entries to a line. The tables grow with the
+  Machine, so they are appended to in place.
+*/
+std::string _table(std::string name, std::vector<int> &values) {
+  std::string output("");
+  int max = 0;
+  for ( unsigned int k = 0; k < values.size(); k++ ) {
+    if ( values[k] > max ) max = values[k];
+  }
+  output = output + "static const " + _table_type(max) + " " + name + "[] = {";
+  for ( unsigned int k = 0; k < values.size(); k++ ) {
+    output += ( k % 16 == 0 ? "\n\t" : " " ) + _int_to_string(values[k]) + ",";
+  }
+  if ( values.empty() ) output = output + " 0";
+  output = output + "\n};\n";
+  return output;
+}
+
+/*
+  The index of a guard or action in ids, which is added when it is new.
+  Ids start at 1; 0 is the guard that is always true and the empty action.
+*/
+int _table_id(std::map<std::string, int> &ids, std::vector<std::string> &bodies, std::string body) {
+  std::map<std::string, int>::iterator found = ids.find(body);
+  if ( found != ids.end() ) return found->second;
+  bodies.push_back(body);
+  ids[body] = bodies.size();
+  return bodies.size();
+}
+
+/*
+  Adds the tables, the constructor and destructor, guard(), action() and run().
+*/
+std::string _cpp_table(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+
+  std::map<std::string, int> state_index;
+  int states = 0;
+  for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+    state_index[s->get_variable()->get_name()] = states++;
+  }
+
+  std::map<std::string, int> guard_ids, action_ids;
+  std::vector<std::string> guards, actions;
+  std::vector<int> first, guard, action, target;
+  for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+    first.push_back(guard.size());
+    for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+      if ( ! _cpp_emitted(p, s, t) ) continue;
+      guard.push_back(t->is_always() ? 0 : _table_id(guard_ids, guards, _cpp_expr(t->get_expr())));
+      action.push_back(t->get_stmt()->is_empty() ? 0 : _table_id(action_ids, actions, _cpp_stmts(t->get_stmt())));
+      target.push_back(t->is_exit() ? states : state_index[t->get_variable()->get_name()]);
+    }
+  }
+  first.push_back(guard.size());
+
+  output = output + "\n// " + _int_to_string(states) + " States, " + _int_to_string(guard.size()) + " transitions, "
+    + _int_to_string(guards.size()) + " distinct guards and " + _int_to_string(actions.size()) + " distinct actions.\n";
+  output = output + "// The transitions of State s are state_first[s] up to state_first[s + 1]; State " + _int_to_string(states) + " is the exit.\n";
+  output = output + _table("state_first", first);
+  output = output + _table("transition_guard", guard);
+  output = output + _table("transition_action", action);
+  output = output + _table("transition_target", target);
+  output = output + "\n";
+
+  output = output + _cpp_constructor_deconstructor(p);
+
+  int chunks = ( guards.size() + TABLE_CHUNK - 1 ) / TABLE_CHUNK;
+  for ( int c = 0; c < chunks; c++ ) {
+    output += "template <> bool " + name + "::guards<" + _int_to_string(c) + ">(int id) {\n\tswitch ( id ) {\n";
+    for ( int k = c * TABLE_CHUNK; k < (int) guards.size() && k < ( c + 1 ) * TABLE_CHUNK; k++ ) {
+      output += "\t\tcase " + _int_to_string(k + 1) + ": return " + guards[k] + ";\n";
+    }
+    output += "\t}\n\treturn true;\n}\n\n";
+  }
+  output = output + "bool " + name + "::guard(int id) {\n";
+  output = output + "\tif ( id == 0 ) return true;\n";
+  output = output + "\tswitch ( ( id - 1 ) / " + _int_to_string(TABLE_CHUNK) + " ) {\n";
+  for ( int c = 0; c < chunks; c++ ) {
+    output += "\t\tcase " + _int_to_string(c) + ": return guards<" + _int_to_string(c) + ">(id);\n";
+  }
+  output = output + "\t}\n";
+  output = output + "\treturn true;\n";
+  output = output + "}\n\n";
+
+  chunks = ( actions.size() + TABLE_CHUNK - 1 ) / TABLE_CHUNK;
+  for ( int c = 0; c < chunks; c++ ) {
+    output += "template <> void " + name + "::actions<" + _int_to_string(c) + ">(int id) {\n\tswitch ( id ) {\n";
+    for ( int k = c * TABLE_CHUNK; k < (int) actions.size() && k < ( c + 1 ) * TABLE_CHUNK; k++ ) {
+      output += "\tcase " + _int_to_string(k + 1) + ": {\n" + actions[k] + "\t\tbreak;\n\t}\n";
+    }
+    output += "\t}\n}\n\n";
+  }
+  output = output + "void " + name + "::action(int id) {\n";
+  output = output + "\tif ( id == 0 ) return;\n";
+  output = output + "\tswitch ( ( id - 1 ) / " + _int_to_string(TABLE_CHUNK) + " ) {\n";
+  for ( int c = 0; c < chunks; c++ ) {
+    output += "\t\tcase " + _int_to_string(c) + ": actions<" + _int_to_string(c) + ">(id); break;\n";
+  }
+  output = output + "\t}\n";
+  output = output + "}\n\n";
+
+  output = output + "void " + name + "::run(int state) {\n";
+  output = output + "\twhile ( state != " + _int_to_string(states) + " ) {\n";
+  output = output + "\t\tplatform->enter_state();\n";
+  output = output + "\t\tint t = state_first[state];\n";
+  output = output + "\t\tint last = state_first[state + 1];\n";
+  output = output + "\t\twhile ( t < last && ! guard(transition_guard[t]) ) t++;\n";
+  output = output + "\t\tif ( t == last ) return;\n";
+  output = output + "\t\taction(transition_action[t]);\n";
+  output = output + "\t\tplatform->next_state();\n";
+  output = output + "\t\tstate = transition_target[t];\n";
+  output = output + "\t}\n";
+  output = output + "}\n\n";
+  return output;
+}
+
+/*
+  Adds the main() for the table backend, which runs from the initial State.
+*/
+std::string _cpp_table_main(Program *p) {
+  std::string output("");
+  std::string platform(p->get_platform()->get_variable()->get_name());
+  std::string name(p->get_variable()->get_name());
+
+  int initial = 0;
+  State *s = p->get_states();
+  while ( s && !s->is_empty() && !s->is_initial() ) {
+    s = s->get_next();
+    initial++;
+  }
+
+  output = output + "int main(int argc, char **argv) {\n\n";
+  output = output + "\t" + platform + " *platform = new " + platform + "(argc, argv);\n\n";
+  output = output + "\t" + name + " *machine = new " + name + "(platform);\n";
+  if ( s && !s->is_empty() ) {
+    output = output + "\tmachine->run(" + _int_to_string(initial) + ");\n\n";
+  } else {
+    output = output + "\t// No initial state\n\n";
+  }
+  output = output + "\treturn 0;\n";
+  output = output + "}\n";
+  return output;
+}
+
+/*
+  Adds guard(), action() and run() to the Machine class, in place of the State functions.
+*/
+std::string _header_table_machine(Program *p) {
+  std::string output("");
+  output = output + _header_machine_constructor_deconstructor(p);
+  output = output + _header_machine_decls(p);
+  output = output + "\t\tbool guard(int id);\n";
+  output = output + "\t\tvoid action(int id);\n";
+  output = output + "\t\ttemplate <int chunk> bool guards(int id);\n";
+  output = output + "\t\ttemplate <int chunk> void actions(int id);\n";
+  output = output + "\t\tvoid run(int state);\n";
+  output = output + _header_machine_private(p);
+  return output;
+}
+
+/*
+  Below are the trace generate functions (cffc --trace).
+
+  Every transition records (from, to, transition) with CFFC_TRACE right before
+  platform->next_state(), see cffc/Trace.h. States are numbered in the order they
+  are written in. The calls are empty unless the Machine is compiled with -DCFFC_TRACING.
+*/
+
+/*
+  Adds the number of a State, or -1 if there is no State of that name.
+*/
+int _state_index(Program *p, Variable *v) {
+  int index = 0;
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    if ( s->get_variable()->get_name() == v->get_name() ) return index;
+    s = s->get_next();
+    index++;
+  }
+  return -1;
+}
+
+/*
+  Adds the CFFC_TRACE call of transition `index` of State s, or "" without --trace.
+*/
+std::string _cpp_trace(Program *p, State *s, Transition *t, int index) {
+  if ( ! p->get_options()->trace ) return "";
+
+  std::string to("CFFC_TRACE_EXIT");
+  if ( ! t->is_exit() ) to = _int_to_string(_state_index(p, t->get_variable()));
+
+  return "\t\tCFFC_TRACE(" + _int_to_string(_state_index(p, s->get_variable())) + ", " + to + ", " + _int_to_string(index) + ");\n";
+}
+
+/*
+  Adds the State names the trace file is written with.
+*/
+std::string _cpp_trace_states(Program *p) {
+  if ( ! p->get_options()->trace ) return "";
+
+  std::string output("");
+  output = output + "#ifdef CFFC_TRACING\n";
+  output = output + "static const char *trace_states[] = { ";
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + "\"" + s->get_variable()->get_name() + "\", ";
+    s = s->get_next();
+  }
+  output = output + "\"\" };\n";
+  output = output + "#endif\n";
+  return output;
+}
+
+/*
+  Adds the call that registers the Machine's TraceRing, for the constructor.
+*/
+std::string _cpp_trace_open(Program *p) {
+  if ( ! p->get_options()->trace ) return "";
+  return "\tCFFC_TRACE_OPEN(trace_states, " + _int_to_string(p->getNumStates()) + ");\n";
+}
+
+/*
+  Adds the TraceRing to the Machine class.
+*/
+std::string _header_trace(Program *p) {
+  if ( ! p->get_options()->trace ) return "";
+  return "#ifdef CFFC_TRACING\n\t\tTraceRing trace;\n#endif\n";
+}
+
+/*
+  Below are the profile generate functions (cffc --profile).
+
+  Every State counts its entries, every guard its evaluations and hits, and the
+  actions of every transition how long they took, see cffc/Profile.h. Transitions
+  are numbered across the whole Machine. The probes are empty unless the Machine
+  is compiled with -DCFFC_PROFILING.
+*/
+
+/*
+  Adds the number of transition `index` of State s.
+*/
+int _transition_id(Program *p, State *s, int index) {
+  int id = 0;
+  State *state = p->get_states();
+  while ( state && !state->is_empty() && state != s ) {
+    Transition *t = state->get_transition();
+    while ( t && !t->is_empty() ) {
+      id++;
+      t = t->get_next();
+    }
+    state = state->get_next();
+  }
+  return id + index;
+}
+
+/*
+  True if a transition can be taken: the optimizer marks guards that are never
+  true, and everything after a guard that is always true can not be reached.
+  The optimizer removes the transitions that are not live, and codegen skips them.
+*/
+bool _live_transition(State *s, Transition *t) {
+  if ( t->is_never() ) return false;
+  for ( Transition *before = s->get_transition(); before != t; before = before->get_next() ) {
+    if ( before->is_always() ) return false;
+  }
+  return true;
+}
+
+/*
+  True if a transition is emitted. With --profile every guard is kept, so its
+  counts stay right.
+*/
+bool _cpp_emitted(Program *p, State *s, Transition *t) {
+  return p->get_options()->profile || _live_transition(s, t);
+}
+
+/*
+  Adds the start of the branch of a transition: "if (guard) {" for the first
+  one emitted, "else if (guard) {" after that. A guard that is always true
+  needs no test.
+*/
+std::string _cpp_branch(Program *p, State *s, Transition *t, int index, bool first, std::string indent) {
+  if ( t->is_always() && ! p->get_options()->profile ) {
+    return first ? indent + "{\n" : "else {\n";
+  }
+  return ( first ? indent + "if " : std::string("else if ") ) + "(" + _cpp_guard(p, s, t, index) + ") {\n";
+}
+
+/*
+  Adds the guard of a transition, wrapped in CFFC_PROFILE_GUARD with --profile,
+  or the call of its shared guard.
+*/
+std::string _cpp_guard(Program *p, State *s, Transition *t, int index) {
+  if ( t->get_shared_guard() ) return "shared_guard_" + _int_to_string(t->get_shared_guard()) + "()";
+  if ( ! p->get_options()->profile ) return _cpp_expr(t->get_expr());
+  return "CFFC_PROFILE_GUARD(" + _int_to_string(_transition_id(p, s, index)) + ", " + _cpp_expr(t->get_expr()) + ")";
+}
+
+/*
+  Adds the statements of a transition, timed with --profile, or the call of
+  its shared action, followed by those of the States the optimizer fused into it.
+*/
+std::string _cpp_actions(Program *p, State *s, Transition *t) {
+  if ( t->get_shared_action() ) {
+    return "\t\tshared_action_" + _int_to_string(t->get_shared_action()) + "();\n" + _cpp_fused(p, t);
+  }
+  if ( ! p->get_options()->profile ) return _cpp_stmts( t->get_stmt() ) + _cpp_fused(p, t);
+
+  std::string state(_int_to_string(_state_index(p, s->get_variable())));
+  std::string output("");
+  output = output + "\t\tCFFC_PROFILE_BEGIN;\n";
+  output = output + _cpp_stmts( t->get_stmt() );
+  output = output + "\t\tCFFC_PROFILE_END(" + state + ");\n";
+  return output;
+}
+
+/*
+  Adds the shared guards and actions (see share_bodies), each from the first
+  transition that has it. They are noinline, or g++ would copy them back
+  into every State.
+*/
+std::string _cpp_shared(Program *p) {
+  std::string output("");
+  std::string name(p->get_variable()->get_name());
+  std::set<int> guards, actions;
+  for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+    for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+      int id = t->get_shared_guard();
+      if ( id && guards.insert(id).second ) {
+        output = output + "__attribute__((noinline)) bool " + name + "::shared_guard_" + _int_to_string(id) + "() {\n";
+        output = output + "\treturn " + _cpp_expr(t->get_expr()) + ";\n";
+        output = output + "}\n\n";
+      }
+      id = t->get_shared_action();
+      if ( id && actions.insert(id).second ) {
+        output = output + "__attribute__((noinline)) void " + name + "::shared_action_" + _int_to_string(id) + "() {\n";
+        output = output + _cpp_stmts(t->get_stmt());
+        output = output + "}\n\n";
+      }
+    }
+  }
+  return output;
+}
+
+/*
+  Adds the declarations of the shared guards and actions.
+*/
+std::string _header_shared(Program *p) {
+  std::string output("");
+  std::set<int> guards, actions;
+  for ( State *s = p->get_states(); s && !s->is_empty(); s = s->get_next() ) {
+    for ( Transition *t = s->get_transition(); t && !t->is_empty(); t = t->get_next() ) {
+      if ( t->get_shared_guard() ) guards.insert(t->get_shared_guard());
+      if ( t->get_shared_action() ) actions.insert(t->get_shared_action());
+    }
+  }
+  for ( std::set<int>::iterator id = guards.begin(); id != guards.end(); id++ ) {
+    output = output + "\t\tbool shared_guard_" + _int_to_string(*id) + "();\n";
+  }
+  for ( std::set<int>::iterator id = actions.begin(); id != actions.end(); id++ ) {
+    output = output + "\t\tvoid shared_action_" + _int_to_string(*id) + "();\n";
+  }
+  return output;
+}
+
+/*
+  Adds the actions of the fused States of a transition (see fuse_chains),
+  each one entered and left through the platform as the State was. A stepping
+  Machine stops where the platform halted, as step() would have.
+  Locals only live for one transition, so each State that has some gets a block.
+*/
+std::string _cpp_fused(Program *p, Transition *t) {
+  std::string output("");
+  std::vector<Stmt *> fused = t->get_fused();
+  for ( unsigned int k = 0; k < fused.size(); k++ ) {
+    output = output + "\t\tplatform->next_state();\n";
+    if ( p->get_options()->is_stepping() ) output = output + "\t\tif ( platform->is_halted() ) return state_exit;\n";
+    output = output + "\t\tplatform->enter_state();\n";
+
+    bool block = false;
+    for ( Stmt *st = fused[k]; st && !st->is_empty(); st = st->get_next() ) {
+      if ( st->get_variable()->is_local() ) block = true;
+    }
+    if ( block ) output = output + "\t\t{\n";
+    output = output + _cpp_stmts( fused[k] );
+    if ( block ) output = output + "\t\t}\n";
+  }
+  return output;
+}
+
+/*
+  Adds the entry probe of a State, or "" without --profile.
+*/
+std::string _cpp_profile_enter(Program *p, State *s) {
+  if ( ! p->get_options()->profile ) return "";
+  return "\tCFFC_PROFILE_ENTER(" + _int_to_string(_state_index(p, s->get_variable())) + ");\n";
+}
+
+/*
+  Adds the State and transition names of the profile report,
+  e.g. "MoveNorth -> exit (0)" for the first transition of MoveNorth.
+*/
+std::string _cpp_profile_names(Program *p) {
+  if ( ! p->get_options()->profile ) return "";
+
+  std::string output("");
+  output = output + "#ifdef CFFC_PROFILING\n";
+  output = output + "static const char *profile_states[] = { ";
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    output = output + "\"" + s->get_variable()->get_name() + "\", ";
+    s = s->get_next();
+  }
+  output = output + "\"\" };\n";
+
+  output = output + "static const char *profile_transitions[] = { ";
+  s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    Transition *t = s->get_transition();
+    int index = 0;
+    while ( t && !t->is_empty() ) {
+      std::string to("exit");
+      if ( ! t->is_exit() ) to = t->get_variable()->get_name();
+      output = output + "\"" + s->get_variable()->get_name() + " -> " + to + " (" + _int_to_string(index) + ")\", ";
+      t = t->get_next();
+      index++;
+    }
+    s = s->get_next();
+  }
+  output = output + "\"\" };\n";
+  output = output + "#endif\n";
+  return output;
+}
+
+/*
+  Adds the call that registers the Machine's counters, for the constructor.
+*/
+std::string _cpp_profile_open(Program *p) {
+  if ( ! p->get_options()->profile ) return "";
+
+  int transitions = 0;
+  State *s = p->get_states();
+  while ( s && !s->is_empty() ) {
+    Transition *t = s->get_transition();
+    while ( t && !t->is_empty() ) {
+      transitions++;
+      t = t->get_next();
+    }
+    s = s->get_next();
+  }
+
+  return "\tCFFC_PROFILE_OPEN(profile_states, " + _int_to_string(p->getNumStates()) + ", profile_transitions, " + _int_to_string(transitions) + ");\n";
+}
+
+/*
+  Adds the counters to the Machine class.
+*/
+std::string _header_profile(Program *p) {
+  if ( ! p->get_options()->profile ) return "";
+  return "#ifdef CFFC_PROFILING\n\t\tProfileCounters profile;\n#endif\n";
+}
+
+/*
+  Adds an int as a string.
+*/
+std::string _int_to_string(int i) {
+  std::ostringstream s;
+  s << i;
+  return s.str();
+}
+
+/*
+  Below are generic header generate functions.
+*/
+
+std::string _header_ifndef_open() {
+  return "#ifndef MACHINE_H\n#define MACHINE_H\n";
+}
+std::string _header_ifndef_close() {
+  return "#endif\n";
+}
+std::string _header_machine_class_open(Program *p) {
+  return "class " + p->getName() + " { \n";
+}
+std::string _header_machine_public() {
+  return "\tpublic: \n";
+}
+std::string _header_machine_constructor_deconstructor(Program *p) {
+  std::string output("");
+  output = output + "\t\t" + p->get_variable()->get_name() + "(" + p->get_platform()->get_variable()->get_name() + " *platform);\n";
+  output = output + "\t\t~" + p->get_variable()->get_name() + "();\n";
+  return output;
+}
+std::string _header_machine_private(Program *p) {
+  std::string output("");
+  output = output + "\tprivate:\n";
+  output = output + "\t\t" + p->get_platform()->get_variable()->get_name() + " *platform;\n";
+  output = output + _header_shared(p);
+  return output;
+}
+std::string _header_machine_class_close() {
+  return "};\n\n";
+}
+std::string _header_machine_main() {
+  return "int main(int argc, char **argv);\n\n";
+}
+
+std::string _header_machine_decls(Program *p) {
+  std::string output("");
+
+  DeclList *d = p->get_decls();
+
+  while ( is_node_type<SeqDecl>(d) ) {
+    output = output + ((SeqDecl *)d)->cppCode_h();
+    d = ((SeqDecl *)d)->get_tail();
+  }
+
+  return output;
+}
+std::string _header_machine_states(Program *p) {
+
+  std::string output("");
+
+  State *s = p->get_states();
+
+  if ( s->is_empty() ) {
+    output = "\n\t\t// No states\n";
+    return output;
+  }
+
+  std::string type("void");
+  if ( p->get_options()->is_stepping() ) type = "int";
+
+  while ( s ) {
+    output = output + "\t\t" + type + " " + s->get_variable()->get_name() + "();\n";
     s = s->get_next();
   }
 
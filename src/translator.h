@@ -1,7 +1,28 @@
 #ifndef __TRANSLATOR_DEFINED__
 #define __TRANSLATOR_DEFINED__
 #include <string>
+#include <map>
+#include <vector>
 #include "ast.h"
+
+/*
+  PlatformTraits is what the translator knows about a hand-written platform:
+  the C++ type of each sensor and actuator, whether they are all numbers,
+  and whether there is an asynchronous version in cffc/RunTime.h or a
+  simulated one in cffc/Simulation.h.
+*/
+class PlatformTraits {
+  public:
+    PlatformTraits();
+    std::string name;
+    std::map<std::string, std::string> fields;
+    bool numeric;
+    bool async;
+    bool simulated;
+};
+PlatformTraits _platform_traits(std::string name);
+
+std::string _int_to_string(int i);
 std::string _header_machine_states(Program *p);
 std::string _header_ifndef_open();
 std::string _header_ifndef_close();
@@ -12,12 +33,69 @@ std::string _header_machine_private(Program *p);
 std::string _header_machine_class_close();
 std::string _header_machine_main();
 std::string _header_machine_decls(Program *p);
-std::string _cpp_includes();
+std::string _cpp_includes(Program *p);
 std::string _cpp_constructor_deconstructor(Program *p);
 std::string _cpp_expr(Expr *e);
 std::string _cpp_stmts(Stmt *s);
-std::string _cpp_transitions(Transition *t);
+std::string _cpp_transitions(Program *p, State *s);
 std::string _cpp_states(Program *p);
+std::string _cpp_state(Program *p, State *s);
+std::string _cpp_split_main(Program *p);
+std::vector<std::string> _cpp_split_parts(Program *p, int n);
+std::string _split_makefile(Program *p, int parts);
+bool _loops(Program *p, State *s);
+std::string _cpp_loop_state(Program *p, State *s);
 std::string _cpp_initial_state_call(Program *p);
 std::string _cpp_main(Program *p);
+std::string _cpp_evaluated(Program *p, std::string printed);
+bool _batch_maps(Expr *e);
+bool _batches(Program *p);
+std::string _batch_expr(Expr *e);
+std::string _cpp_batch(Program *p);
+std::string _state_id(Variable *v);
+std::string _cpp_step_constructor_deconstructor(Program *p);
+std::string _cpp_step_transitions(Program *p, State *s);
+std::string _cpp_step_states(Program *p);
+std::string _cpp_step(Program *p);
+std::string _cpp_runner_main(Program *p);
+std::string _simulation_check(Program *p);
+std::string _cpp_simulation_main(Program *p);
+std::string _cpp_swap_abi(Program *p);
+std::string _header_machine_step(Program *p);
+std::string _lanes_check(Program *p);
+std::string _lanes_expr(Expr *e);
+std::string _cpp_lanes_state(Program *p, State *s);
+std::string _cpp_lanes_constructor_deconstructor(Program *p);
+std::string _cpp_lanes_step(Program *p);
+std::string _cpp_lanes_main(Program *p);
+std::string _table_type(int max);
+std::string _table(std::string name, std::vector<int> &values);
+int _table_id(std::map<std::string, int> &ids, std::vector<std::string> &bodies, std::string body);
+std::string _cpp_table(Program *p);
+std::string _cpp_table_main(Program *p);
+std::string _header_table_machine(Program *p);
+std::string _header_lanes_machine(Program *p);
+int _state_index(Program *p, Variable *v);
+std::string _cpp_trace(Program *p, State *s, Transition *t, int index);
+std::string _cpp_trace_states(Program *p);
+std::string _cpp_trace_open(Program *p);
+std::string _header_trace(Program *p);
+int _transition_id(Program *p, State *s, int index);
+std::string _cpp_guard(Program *p, State *s, Transition *t, int index);
+bool _live_transition(State *s, Transition *t);
+bool _cpp_emitted(Program *p, State *s, Transition *t);
+std::string _cpp_branch(Program *p, State *s, Transition *t, int index, bool first, std::string indent);
+std::string _cpp_actions(Program *p, State *s, Transition *t);
+std::string _cpp_shared(Program *p);
+std::string _header_shared(Program *p);
+std::string _cpp_fused(Program *p, Transition *t);
+std::string _cpp_profile_enter(Program *p, State *s);
+std::string _cpp_profile_names(Program *p);
+std::string _cpp_profile_open(Program *p);
+std::string _header_profile(Program *p);
+std::string _coroutine_check(Program *p);
+std::string _cpp_coroutine_constructor_deconstructor(Program *p);
+std::string _cpp_coroutine_run(Program *p);
+std::string _cpp_coroutine_main(Program *p);
+std::string _header_coroutine_machine(Program *p);
 #endif
\ No newline at end of file